@@ -0,0 +1,162 @@
+#include "antagonists.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+const char* antagonist_name(antagonist_kind kind)
+{
+    switch (kind)
+    {
+        case antagonist_kind::none:
+            return "none";
+        case antagonist_kind::stream:
+            return "stream";
+        case antagonist_kind::chase:
+            return "chase";
+        case antagonist_kind::thrash:
+            return "thrash";
+    }
+    return "";
+}
+
+bool antagonist_parse(const char* name, antagonist_kind& kind)
+{
+    for (antagonist_kind candidate :
+         { antagonist_kind::none, antagonist_kind::stream, antagonist_kind::chase, antagonist_kind::thrash })
+    {
+        if (std::strcmp(name, antagonist_name(candidate)) == 0)
+        {
+            kind = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t last_level_cache_bytes()
+{
+    size_t bytes = 32 << 20;
+    std::FILE* file = std::fopen("/sys/devices/system/cpu/cpu0/cache/index3/size", "r");
+    if (file != nullptr)
+    {
+        unsigned long kilobytes;
+        if (std::fscanf(file, "%luK", &kilobytes) == 1)
+        {
+            bytes = kilobytes << 10;
+        }
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+antagonist_set::antagonist_set(antagonist_kind kind, size_t threads)
+    : _kind(kind)
+{
+    if (kind == antagonist_kind::none)
+    {
+        threads = 0;
+    }
+    for (size_t i = 0; i < threads; i++)
+    {
+        auto self = std::make_unique<worker>();
+        switch (kind)
+        {
+            case antagonist_kind::stream:
+                self->buffer.assign(4 * last_level_cache_bytes() / sizeof(uint64_t), 1);
+                self->target.assign(self->buffer.size(), 0);
+                break;
+            case antagonist_kind::chase:
+            {
+                // One random cycle over all cache lines, so the prefetchers can't guess the next one
+                constexpr size_t lineWords = 64 / sizeof(uint64_t);
+                const size_t lines = 4 * last_level_cache_bytes() / 64;
+                std::vector<uint64_t> order(lines);
+                for (size_t line = 0; line < lines; line++)
+                {
+                    order[line] = line;
+                }
+                std::shuffle(order.begin() + 1, order.end(), std::mt19937_64(i + 1));
+                self->buffer.assign(lines * lineWords, 0);
+                for (size_t line = 0; line < lines; line++)
+                {
+                    self->buffer[order[line] * lineWords] = order[(line + 1) % lines] * lineWords;
+                }
+                break;
+            }
+            case antagonist_kind::thrash:
+                self->buffer.assign(2 * last_level_cache_bytes() / sizeof(uint64_t), 0);
+                break;
+            case antagonist_kind::none:
+                break;
+        }
+        _workers.push_back(std::move(self));
+    }
+    _start = std::chrono::steady_clock::now();
+    for (auto& self : _workers)
+    {
+        self->thread = std::thread(&antagonist_set::run, this, std::ref(*self));
+    }
+}
+
+antagonist_set::~antagonist_set()
+{
+    stop();
+}
+
+void antagonist_set::run(worker& self)
+{
+    constexpr size_t chunkWords = (1 << 16) / sizeof(uint64_t);
+    size_t position = 0;
+    uint64_t next = 0;
+    while (!_stopping.load(std::memory_order_relaxed))
+    {
+        switch (_kind)
+        {
+            case antagonist_kind::stream:
+                std::memcpy(&self.target[position], &self.buffer[position], chunkWords * sizeof(uint64_t));
+                position = (position + chunkWords) % self.buffer.size();
+                self.bytes += chunkWords * sizeof(uint64_t);
+                break;
+            case antagonist_kind::chase:
+                for (int hop = 0; hop < 1024; hop++)
+                {
+                    next = self.buffer[next];
+                }
+                self.bytes += 1024 * 64;
+                break;
+            case antagonist_kind::thrash:
+                // One write per cache line
+                for (size_t word = 0; word < chunkWords; word += 64 / sizeof(uint64_t))
+                {
+                    self.buffer[position + word]++;
+                }
+                position = (position + chunkWords) % self.buffer.size();
+                self.bytes += chunkWords * sizeof(uint64_t);
+                break;
+            case antagonist_kind::none:
+                return;
+        }
+    }
+    // Keep the chase from being optimised away
+    self.target.assign(1, next);
+}
+
+double antagonist_set::stop()
+{
+    if (_rate >= 0)
+    {
+        return _rate;
+    }
+    _stopping = true;
+    uint64_t bytes = 0;
+    for (auto& self : _workers)
+    {
+        self->thread.join();
+        bytes += self->bytes;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    _rate = seconds > 0 ? bytes / seconds : 0;
+    return _rate;
+}
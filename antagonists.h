@@ -0,0 +1,59 @@
+/*
+ * Threads competing with arrangement for the memory system, standing in for the blitting and compression running next
+ * to it on a render node:
+ *
+ *  - stream copies between two buffers four times the size of the last level cache, using up memory bandwidth
+ *  - chase follows a random cycle of pointers through a buffer as large, one cache miss after another
+ *  - thrash writes over a buffer twice the size of the last level cache, evicting everyone else's lines
+ *
+ * They run from construction until stop() or destruction, counting the bytes they moved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+enum class antagonist_kind
+{
+    none,
+    stream,
+    chase,
+    thrash,
+};
+
+const char* antagonist_name(antagonist_kind kind);
+bool antagonist_parse(const char* name, antagonist_kind& kind);
+
+class antagonist_set
+{
+public:
+    antagonist_set(antagonist_kind kind, size_t threads);
+    ~antagonist_set();
+    antagonist_set(const antagonist_set&) = delete;
+    antagonist_set& operator=(const antagonist_set&) = delete;
+
+    // Stops the threads and returns the bytes per second they moved together
+    double stop();
+
+private:
+    struct worker
+    {
+        std::vector<uint64_t> buffer;
+        std::vector<uint64_t> target;
+        uint64_t bytes = 0;
+        std::thread thread;
+    };
+
+    void run(worker& self);
+
+    antagonist_kind _kind;
+    std::atomic<bool> _stopping{ false };
+    std::vector<std::unique_ptr<worker>> _workers;
+    std::chrono::steady_clock::time_point _start;
+    double _rate = -1;
+};
@@ -0,0 +1,43 @@
+#include "arrangers.h"
+
+#include "paint_window_skip.h"
+
+#include <cstring>
+#include <iterator>
+
+static const paint_arranger s_arrangers[] = {
+    { "baseline", "paint_session_arrange() as extracted from OpenRCT2", paint_session_arrange },
+    { "window-skip", "baseline skipping quadrant windows whose bounds rule out any reordering",
+        paint_session_arrange_window_skip },
+};
+
+const paint_arranger* paint_arrangers()
+{
+    return s_arrangers;
+}
+
+size_t paint_arranger_count()
+{
+    return std::size(s_arrangers);
+}
+
+const paint_arranger* paint_arranger_find(const char* name)
+{
+    for (const auto& arranger : s_arrangers)
+    {
+        if (std::strcmp(arranger.name, name) == 0)
+        {
+            return &arranger;
+        }
+    }
+    return nullptr;
+}
+
+void paint_session_get_order(const paint_session& session, std::vector<uint16_t>& order)
+{
+    order.clear();
+    for (const paint_struct* ps = session.PaintHead.next_quadrant_ps; ps != nullptr; ps = ps->next_quadrant_ps)
+    {
+        order.push_back((uint16_t)((const paint_entry*)ps - session.PaintStructs));
+    }
+}
@@ -0,0 +1,24 @@
+/*
+ * Table of the session arrangement implementations the benchmark can measure.
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <cstddef>
+#include <vector>
+
+struct paint_arranger
+{
+    const char* name;
+    const char* description;
+    void (*arrange)(paint_session* session);
+};
+
+const paint_arranger* paint_arrangers();
+size_t paint_arranger_count();
+const paint_arranger* paint_arranger_find(const char* name);
+
+// Indices into session.PaintStructs in the drawing order left by arrangement
+void paint_session_get_order(const paint_session& session, std::vector<uint16_t>& order);
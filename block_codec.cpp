@@ -0,0 +1,226 @@
+#include "block_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#ifdef HAVE_LZ4
+#    include <lz4.h>
+#endif
+
+const char* block_codec_name(block_codec codec)
+{
+    return codec == block_codec::lz4 ? "lz4" : "none";
+}
+
+bool block_codec_parse(const char* name, block_codec& codec)
+{
+    if (std::strcmp(name, "none") == 0)
+    {
+        codec = block_codec::none;
+        return true;
+    }
+    if (std::strcmp(name, "lz4") == 0)
+    {
+        codec = block_codec::lz4;
+        return true;
+    }
+    return false;
+}
+
+#ifndef HAVE_LZ4
+
+// The LZ4 block format: sequences of a token (literal length << 4 | match length - 4), literals and a two byte match
+// offset, with lengths of 15 and more continued in bytes of 255 and a remainder. The last five bytes are always
+// literals and no match starts in the last twelve.
+static constexpr size_t MIN_MATCH = 4;
+static constexpr size_t LAST_LITERALS = 5;
+static constexpr size_t MATCH_FREE_END = 12;
+static constexpr size_t MAX_OFFSET = 65535;
+static constexpr size_t HASH_BITS = 12;
+
+static uint32_t load32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void put_length(std::vector<uint8_t>& out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        out.push_back(255);
+    }
+    out.push_back((uint8_t)length);
+}
+
+static void put_sequence(
+    std::vector<uint8_t>& out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+    const size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+    out.push_back((uint8_t)(std::min<size_t>(literalLength, 15) << 4 | std::min<size_t>(matchCode, 15)));
+    if (literalLength >= 15)
+    {
+        put_length(out, literalLength - 15);
+    }
+    out.insert(out.end(), literals, literals + literalLength);
+    if (matchLength == 0)
+    {
+        return;
+    }
+    out.push_back((uint8_t)offset);
+    out.push_back((uint8_t)(offset >> 8));
+    if (matchCode >= 15)
+    {
+        put_length(out, matchCode - 15);
+    }
+}
+
+static void lz4_compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+    uint32_t table[1 << HASH_BITS];
+    std::fill(std::begin(table), std::end(table), UINT32_MAX);
+    size_t anchor = 0;
+    size_t pos = 0;
+    size_t misses = 0;
+    while (size > MATCH_FREE_END && pos < size - MATCH_FREE_END)
+    {
+        const uint32_t sequence = load32(data + pos);
+        const uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        const uint32_t candidate = table[hash];
+        table[hash] = (uint32_t)pos;
+        if (candidate == UINT32_MAX || pos - candidate > MAX_OFFSET || load32(data + candidate) != sequence)
+        {
+            // Incompressible stretches are skipped over faster the longer they get
+            pos += 1 + (misses++ >> 6);
+            continue;
+        }
+        size_t length = MIN_MATCH;
+        while (pos + length < size - LAST_LITERALS && data[candidate + length] == data[pos + length])
+        {
+            length++;
+        }
+        put_sequence(out, data + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+        misses = 0;
+    }
+    put_sequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+static bool get_length(const uint8_t*& in, const uint8_t* end, size_t& length)
+{
+    uint8_t byte;
+    do
+    {
+        if (in == end)
+        {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static bool lz4_decompress(const uint8_t* in, size_t compressedSize, uint8_t* out, size_t size)
+{
+    const uint8_t* const inEnd = in + compressedSize;
+    uint8_t* const outStart = out;
+    uint8_t* const outEnd = out + size;
+    while (in < inEnd)
+    {
+        const uint8_t token = *in++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !get_length(in, inEnd, literalLength))
+        {
+            return false;
+        }
+        if ((size_t)(inEnd - in) < literalLength || (size_t)(outEnd - out) < literalLength)
+        {
+            return false;
+        }
+        std::memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        if (in == inEnd)
+        {
+            break;
+        }
+
+        if (inEnd - in < 2)
+        {
+            return false;
+        }
+        const size_t offset = in[0] | in[1] << 8;
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !get_length(in, inEnd, matchLength))
+        {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(out - outStart) || (size_t)(outEnd - out) < matchLength)
+        {
+            return false;
+        }
+        const uint8_t* match = out - offset;
+        if (offset >= matchLength)
+        {
+            std::memcpy(out, match, matchLength);
+            out += matchLength;
+        }
+        else
+        {
+            // Overlapping, the match repeats bytes it is producing
+            for (size_t i = 0; i < matchLength; i++)
+            {
+                *out++ = *match++;
+            }
+        }
+    }
+    return out == outEnd;
+}
+
+#else
+
+static void lz4_compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+    const size_t start = out.size();
+    out.resize(start + LZ4_compressBound((int)size));
+    const int written
+        = LZ4_compress_default((const char*)data, (char*)out.data() + start, (int)size, (int)(out.size() - start));
+    out.resize(start + written);
+}
+
+static bool lz4_decompress(const uint8_t* in, size_t compressedSize, uint8_t* out, size_t size)
+{
+    return LZ4_decompress_safe((const char*)in, (char*)out, (int)compressedSize, (int)size) == (int)size;
+}
+
+#endif
+
+void block_compress(block_codec codec, const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+    if (codec == block_codec::lz4)
+    {
+        lz4_compress(data, size, out);
+        return;
+    }
+    out.insert(out.end(), data, data + size);
+}
+
+bool block_decompress(block_codec codec, const uint8_t* data, size_t compressedSize, uint8_t* out, size_t size)
+{
+    if (codec == block_codec::lz4)
+    {
+        return lz4_decompress(data, compressedSize, out, size);
+    }
+    if (compressedSize != size)
+    {
+        return false;
+    }
+    std::memcpy(out, data, size);
+    return true;
+}
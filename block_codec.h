@@ -0,0 +1,28 @@
+/*
+ * Compression of independent blocks of corpus data.
+ *
+ * Blocks are compressed in the LZ4 block format, which decompresses at several GB/s per core. With HAVE_LZ4 defined
+ * (the Makefile does so when lz4.h is installed) the library does the work, otherwise a local implementation of the
+ * same format does, so corpora written by either can be read by either.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class block_codec : uint32_t
+{
+    none,
+    lz4,
+};
+
+const char* block_codec_name(block_codec codec);
+bool block_codec_parse(const char* name, block_codec& codec);
+
+// Appends the compressed form of size bytes to out
+void block_compress(block_codec codec, const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+// Decompresses a block into exactly size bytes. Returns false on malformed input.
+bool block_decompress(block_codec codec, const uint8_t* data, size_t compressedSize, uint8_t* out, size_t size);
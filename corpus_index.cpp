@@ -0,0 +1,437 @@
+#include "corpus_index.h"
+
+#include "session_codec.h"
+#include "session_corpus.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <memory>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static constexpr char MAGIC[8] = { 'P', 'S', 'I', 'N', 'D', 'E', 'X', '2' };
+static constexpr uint32_t VERSION = 2;
+
+#pragma pack(push, 1)
+struct block_entry
+{
+    uint64_t offset;
+    uint32_t compressed_size;
+    uint32_t size;
+};
+
+struct index_entry
+{
+    uint32_t block;
+    uint32_t offset;
+    uint32_t size;
+    uint16_t structs;
+    uint16_t quadrant_back;
+    uint16_t quadrant_front;
+    uint8_t zoom;
+    uint8_t reserved;
+};
+
+struct index_trailer
+{
+    uint64_t index_offset;
+    uint32_t blocks;
+    uint32_t sessions;
+    block_codec codec;
+    uint32_t version;
+    char magic[8];
+};
+#pragma pack(pop)
+
+session_stats session_stats_of(const paint_session& session, uint8_t zoom)
+{
+    const size_t structCount = std::size(session.PaintStructs);
+    const size_t quadrantCount = std::size(session.Quadrants);
+
+    session_stats stats;
+    stats.zoom = zoom;
+    std::vector<bool> reached(structCount, false);
+    for (size_t quadrant = 0; quadrant < quadrantCount; quadrant++)
+    {
+        const size_t head = (size_t)session.Quadrants[quadrant];
+        if (head == quadrantCount || head >= structCount)
+        {
+            continue;
+        }
+        stats.quadrant_back = std::min<uint16_t>(stats.quadrant_back, (uint16_t)quadrant);
+        stats.quadrant_front = (uint16_t)quadrant;
+        for (size_t entry = head; entry < structCount && !reached[entry];
+             entry = (size_t)session.PaintStructs[entry].basic.next_quadrant_ps)
+        {
+            reached[entry] = true;
+            stats.structs++;
+        }
+    }
+    return stats;
+}
+
+bool session_filter::parse(const char* text)
+{
+    static const char* const fields[] = { "structs", "back", "front", "quadrants", "zoom" };
+    // Longest first, so "<=" isn't taken for "<"
+    static const char* const comparisons[] = { "<=", ">=", "<", ">", "=" };
+
+    std::string conditions = text;
+    for (size_t start = 0; start <= conditions.size();)
+    {
+        const size_t end = std::min(conditions.find(',', start), conditions.size());
+        const std::string condition = conditions.substr(start, end - start);
+        const size_t split = condition.find_first_of("<=>");
+        if (split == std::string::npos)
+        {
+            return false;
+        }
+        const std::string field = condition.substr(0, split);
+        const char* const* comparison = std::find_if(std::begin(comparisons), std::end(comparisons),
+            [&](const char* op) { return condition.compare(split, std::strlen(op), op) == 0; });
+        if (std::none_of(std::begin(fields), std::end(fields), [&](const char* name) { return field == name; }))
+        {
+            return false;
+        }
+        const char* value = condition.c_str() + split + std::strlen(*comparison);
+        char* valueEnd;
+        const unsigned long number = std::strtoul(value, &valueEnd, 10);
+        if (valueEnd == value || *valueEnd != '\0')
+        {
+            return false;
+        }
+        _conditions.push_back({ field, *comparison, number });
+        start = end + 1;
+    }
+    return true;
+}
+
+bool session_filter::matches(const session_stats& stats) const
+{
+    for (const condition& condition : _conditions)
+    {
+        unsigned long value = stats.zoom;
+        if (condition.field == "structs")
+        {
+            value = stats.structs;
+        }
+        else if (condition.field == "back")
+        {
+            value = stats.quadrant_back;
+        }
+        else if (condition.field == "front")
+        {
+            value = stats.quadrant_front;
+        }
+        else if (condition.field == "quadrants")
+        {
+            value = stats.quadrants();
+        }
+
+        bool holds;
+        if (condition.comparison == "<")
+        {
+            holds = value < condition.value;
+        }
+        else if (condition.comparison == "<=")
+        {
+            holds = value <= condition.value;
+        }
+        else if (condition.comparison == ">")
+        {
+            holds = value > condition.value;
+        }
+        else if (condition.comparison == ">=")
+        {
+            holds = value >= condition.value;
+        }
+        else
+        {
+            holds = value == condition.value;
+        }
+        if (!holds)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool corpus_index_write(const char* path, block_codec codec, size_t blockSessions)
+{
+    std::FILE* file = std::fopen(path, "wb");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "Failed to create %s\n", path);
+        return false;
+    }
+    std::vector<block_entry> blocks;
+    std::vector<index_entry> entries;
+    std::vector<uint8_t> raw;
+    std::vector<uint8_t> compressed;
+    uint64_t offset = 0;
+    bool ok = true;
+    for (size_t first = 0; ok && first < session_corpus_size(); first += blockSessions)
+    {
+        raw.clear();
+        for (size_t i = first; i < std::min(first + blockSessions, session_corpus_size()); i++)
+        {
+            const paint_session& session = session_corpus_get(i);
+            const uint8_t zoom = session_corpus_zoom(i);
+            const size_t start = raw.size();
+            session_encode(session, zoom, raw);
+            const session_stats stats = session_stats_of(session, zoom);
+            entries.push_back({ (uint32_t)blocks.size(), (uint32_t)start, (uint32_t)(raw.size() - start), stats.structs,
+                stats.quadrant_back, stats.quadrant_front, stats.zoom, 0 });
+        }
+        compressed.clear();
+        block_compress(codec, raw.data(), raw.size(), compressed);
+        blocks.push_back({ offset, (uint32_t)compressed.size(), (uint32_t)raw.size() });
+        // Padded so that every block starts 8 byte aligned, in its mapping too
+        compressed.resize((compressed.size() + 7) & ~(size_t)7, 0);
+        ok = std::fwrite(compressed.data(), 1, compressed.size(), file) == compressed.size();
+        offset += compressed.size();
+    }
+
+    index_trailer trailer{ offset, (uint32_t)blocks.size(), (uint32_t)entries.size(), codec, VERSION, {} };
+    std::memcpy(trailer.magic, MAGIC, sizeof(MAGIC));
+    ok = ok && std::fwrite(blocks.data(), sizeof(block_entry), blocks.size(), file) == blocks.size()
+        && std::fwrite(entries.data(), sizeof(index_entry), entries.size(), file) == entries.size()
+        && std::fwrite(&trailer, sizeof(trailer), 1, file) == 1;
+    ok &= std::fclose(file) == 0;
+    if (!ok)
+    {
+        std::fprintf(stderr, "Failed to write %s\n", path);
+    }
+    return ok;
+}
+
+indexed_corpus::~indexed_corpus()
+{
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+    }
+}
+
+static bool read_trailer(int fd, index_trailer& trailer, off_t& fileSize)
+{
+    fileSize = ::lseek(fd, 0, SEEK_END);
+    return fileSize >= (off_t)sizeof(trailer)
+        && ::pread(fd, &trailer, sizeof(trailer), fileSize - sizeof(trailer)) == (ssize_t)sizeof(trailer)
+        && std::memcmp(trailer.magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool indexed_corpus::detect(const char* path)
+{
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    index_trailer trailer;
+    off_t fileSize;
+    const bool indexed = read_trailer(fd, trailer, fileSize);
+    ::close(fd);
+    return indexed;
+}
+
+bool indexed_corpus::open(const char* path)
+{
+    _path = path;
+    _fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (_fd < 0)
+    {
+        std::fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+    index_trailer trailer;
+    off_t fileSize;
+    if (!read_trailer(_fd, trailer, fileSize) || trailer.version != VERSION || trailer.codec > block_codec::lz4
+        || trailer.index_offset + (uint64_t)trailer.blocks * sizeof(block_entry)
+                + (uint64_t)trailer.sessions * sizeof(index_entry) + sizeof(trailer)
+            != (uint64_t)fileSize)
+    {
+        std::fprintf(stderr, "%s is not an indexed corpus\n", path);
+        return false;
+    }
+    _codec = trailer.codec;
+
+    std::vector<block_entry> blocks(trailer.blocks);
+    std::vector<index_entry> entries(trailer.sessions);
+    const size_t blockBytes = blocks.size() * sizeof(block_entry);
+    const size_t entryBytes = entries.size() * sizeof(index_entry);
+    if (::pread(_fd, blocks.data(), blockBytes, trailer.index_offset) != (ssize_t)blockBytes
+        || ::pread(_fd, entries.data(), entryBytes, trailer.index_offset + blockBytes) != (ssize_t)entryBytes)
+    {
+        std::fprintf(stderr, "Failed to read the index of %s\n", path);
+        return false;
+    }
+    for (const block_entry& entry : blocks)
+    {
+        if (entry.offset + entry.compressed_size > trailer.index_offset
+            || (_codec == block_codec::none && entry.compressed_size != entry.size))
+        {
+            std::fprintf(stderr, "%s: block %zu is out of place\n", path, _blocks.size());
+            return false;
+        }
+        _blocks.push_back({ entry.offset, entry.compressed_size, entry.size });
+    }
+    for (const index_entry& entry : entries)
+    {
+        if (entry.block >= _blocks.size() || (uint64_t)entry.offset + entry.size > _blocks[entry.block].size)
+        {
+            std::fprintf(stderr, "%s: index entry %zu points past its block\n", path, _stats.size());
+            return false;
+        }
+        _locations.push_back({ entry.block, entry.offset, entry.size });
+        _stats.push_back({ entry.structs, entry.quadrant_back, entry.quadrant_front, entry.zoom });
+        _sessionBytes += entry.size;
+    }
+    return true;
+}
+
+bool indexed_corpus::read_block(size_t index, const std::vector<std::pair<size_t, paint_session*>>& wanted)
+{
+    const block& source = _blocks[index];
+    uint8_t zoom;
+    if (_codec == block_codec::none)
+    {
+        // Stored as is, only the pages of the wanted sessions are mapped
+        const uint64_t pageSize = (uint64_t)::sysconf(_SC_PAGESIZE);
+        for (const auto& [session, target] : wanted)
+        {
+            const location& at = _locations[session];
+            const uint64_t offset = source.offset + at.offset;
+            const uint64_t start = offset & ~(pageSize - 1);
+            const size_t length = offset + at.size - start;
+            void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, _fd, (off_t)start);
+            if (mapping == MAP_FAILED)
+            {
+                std::fprintf(stderr, "Failed to map session %zu of %s\n", session, _path.c_str());
+                return false;
+            }
+            const bool decoded
+                = session_decode_indices((const uint8_t*)mapping + (offset - start), at.size, *target, zoom);
+            ::munmap(mapping, length);
+            if (!decoded)
+            {
+                std::fprintf(stderr, "Session %zu of %s is malformed\n", session, _path.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static thread_local std::vector<uint8_t> compressed;
+    static thread_local std::vector<uint8_t> raw;
+    compressed.resize(source.compressed_size);
+    raw.resize(source.size);
+    if (::pread(_fd, compressed.data(), compressed.size(), (off_t)source.offset) != (ssize_t)compressed.size()
+        || !block_decompress(_codec, compressed.data(), compressed.size(), raw.data(), raw.size()))
+    {
+        std::fprintf(stderr, "Block %zu of %s is unreadable\n", index, _path.c_str());
+        return false;
+    }
+    for (const auto& [session, target] : wanted)
+    {
+        const location& at = _locations[session];
+        if (!session_decode_indices(raw.data() + at.offset, at.size, *target, zoom))
+        {
+            std::fprintf(stderr, "Session %zu of %s is malformed\n", session, _path.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool indexed_corpus::read(const std::vector<size_t>& selection, paint_session* sessions, job_pool& pool)
+{
+    std::vector<paint_session*> targets(selection.size());
+    for (size_t i = 0; i < selection.size(); i++)
+    {
+        targets[i] = &sessions[i];
+    }
+    return read(selection, targets, pool);
+}
+
+bool indexed_corpus::read(const std::vector<size_t>& selection, const std::vector<paint_session*>& targets, job_pool& pool)
+{
+    // Sessions wanted from each block, with where they go
+    std::vector<size_t> blocks;
+    std::vector<std::vector<std::pair<size_t, paint_session*>>> wanted(_blocks.size());
+    for (size_t i = 0; i < selection.size(); i++)
+    {
+        const uint32_t block = _locations[selection[i]].block;
+        if (wanted[block].empty())
+        {
+            blocks.push_back(block);
+        }
+        wanted[block].emplace_back(selection[i], targets[i]);
+    }
+
+    std::atomic<bool> ok{ true };
+    pool.run(blocks.size(), [&](size_t i) {
+        if (ok && !read_block(blocks[i], wanted[blocks[i]]))
+        {
+            ok = false;
+        }
+    });
+    return ok;
+}
+
+bool indexed_corpus::load(const std::function<bool(size_t, const session_stats&)>& wanted, size_t threads)
+{
+    const size_t base = session_corpus_begin();
+    std::vector<size_t> selection;
+    for (size_t i = 0; i < size(); i++)
+    {
+        if (wanted(base + i, _stats[i]))
+        {
+            selection.push_back(i);
+        }
+    }
+
+    // Consecutive sessions at the same zoom level are registered together, so each is decoded straight into its run
+    struct run
+    {
+        size_t start;
+        size_t count;
+        std::unique_ptr<paint_session[]> sessions;
+    };
+    std::vector<run> runs;
+    std::vector<paint_session*> targets(selection.size());
+    for (size_t runStart = 0, runEnd; runStart < selection.size(); runStart = runEnd)
+    {
+        runEnd = runStart + 1;
+        while (runEnd < selection.size() && selection[runEnd] == selection[runEnd - 1] + 1
+               && _stats[selection[runEnd]].zoom == _stats[selection[runStart]].zoom)
+        {
+            runEnd++;
+        }
+        const size_t count = runEnd - runStart;
+        runs.push_back({ runStart, count, std::unique_ptr<paint_session[]>(new paint_session[count]) });
+        for (size_t i = 0; i < count; i++)
+        {
+            targets[runStart + i] = &runs.back().sessions[i];
+        }
+    }
+    job_pool pool(threads);
+    if (!read(selection, targets, pool))
+    {
+        return false;
+    }
+
+    for (run& decoded : runs)
+    {
+        const size_t first = selection[decoded.start];
+        session_corpus_add(std::move(decoded.sessions), decoded.count, base + first, _stats[first].zoom);
+    }
+    session_corpus_add(nullptr, 0, base + size(), 0);
+    return true;
+}
@@ -0,0 +1,146 @@
+/*
+ * Binary session corpora carrying an index, for picking a few sessions out of a large capture without parsing or
+ * reading the rest of it, and for loading whole captures on all cores.
+ *
+ * An indexed corpus holds the sessions in the binary form of session_codec.h, grouped into blocks of consecutive
+ * sessions which are compressed independently of each other (see block_codec.h). The blocks are followed by a table
+ * of blocks, an index entry per session and a trailer locating them at the very end of the file:
+ *
+ *     blocks   x uint8_t block[compressed_size], each starting on an 8 byte boundary
+ *     blocks   x { uint64_t offset; uint32_t compressed_size, size }
+ *     sessions x { uint32_t block, offset, size; uint16_t structs, quadrant_back, quadrant_front; uint8_t zoom,
+ *                  reserved }
+ *     uint64_t index_offset; uint32_t blocks, sessions, codec, version; char magic[8] = "PSINDEX2"
+ *
+ * where a session's offset is within the decompressed block. The index carries enough about each session to choose
+ * sessions by it. Loading reads the trailer and the index, and then only the blocks holding selected sessions, which
+ * are decompressed in parallel; uncompressed blocks are not read at all beyond the pages of the selected sessions,
+ * which are mapped. Fields are in host byte order.
+ */
+
+#pragma once
+
+#include "block_codec.h"
+#include "job_pool.h"
+#include "paint.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct session_stats
+{
+    uint16_t structs = 0;                // reachable paint structs
+    uint16_t quadrant_back = UINT16_MAX; // first quadrant holding structs, UINT16_MAX if there is none
+    uint16_t quadrant_front = 0;         // last quadrant holding structs
+    uint8_t zoom = 0;
+
+    // Width of the quadrant range
+    uint16_t quadrants() const
+    {
+        return quadrant_back > quadrant_front ? 0 : quadrant_front - quadrant_back + 1;
+    }
+};
+
+// Stats of a session as stored in the corpus, with its pointers encoded as indices
+session_stats session_stats_of(const paint_session& session, uint8_t zoom);
+
+// Conditions on session stats such as "structs>=1000,quadrants<64,zoom=0", all of which have to hold. The fields are
+// structs, back, front, quadrants and zoom, compared with <, <=, =, >= or >.
+class session_filter
+{
+public:
+    bool parse(const char* text);
+    bool matches(const session_stats& stats) const;
+
+    bool empty() const
+    {
+        return _conditions.empty();
+    }
+
+private:
+    struct condition
+    {
+        std::string field;
+        std::string comparison;
+        unsigned long value;
+    };
+    std::vector<condition> _conditions;
+};
+
+// Writes the registered sessions as an indexed corpus, blockSessions to a block
+bool corpus_index_write(const char* path, block_codec codec, size_t blockSessions);
+
+class indexed_corpus
+{
+public:
+    indexed_corpus() = default;
+    indexed_corpus(const indexed_corpus&) = delete;
+    indexed_corpus& operator=(const indexed_corpus&) = delete;
+    ~indexed_corpus();
+
+    // Whether the file ends in the trailer of an indexed corpus
+    static bool detect(const char* path);
+
+    // Reads the index, leaving the sessions where they are
+    bool open(const char* path);
+
+    size_t size() const
+    {
+        return _stats.size();
+    }
+
+    const session_stats& stats(size_t index) const
+    {
+        return _stats[index];
+    }
+
+    block_codec codec() const
+    {
+        return _codec;
+    }
+
+    // Bytes of all sessions in their binary form, before compression
+    uint64_t session_bytes() const
+    {
+        return _sessionBytes;
+    }
+
+    // Decodes the given sessions into sessions[0] onwards, as stored in the corpus, with the blocks holding them
+    // decompressed and decoded on the pool
+    bool read(const std::vector<size_t>& selection, paint_session* sessions, job_pool& pool);
+
+    // Reads the sessions wanted, given their index within the whole corpus and their stats, on the given number of
+    // threads, and registers them with the corpus at that index
+    bool load(const std::function<bool(size_t, const session_stats&)>& wanted, size_t threads);
+
+private:
+    struct block
+    {
+        uint64_t offset;
+        uint32_t compressed_size;
+        uint32_t size;
+    };
+
+    struct location
+    {
+        uint32_t block;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // Decodes each selected session into its own target
+    bool read(const std::vector<size_t>& selection, const std::vector<paint_session*>& targets, job_pool& pool);
+    bool read_block(size_t index, const std::vector<std::pair<size_t, paint_session*>>& wanted);
+
+    std::string _path;
+    int _fd = -1;
+    block_codec _codec = block_codec::none;
+    uint64_t _sessionBytes = 0;
+    std::vector<block> _blocks;
+    std::vector<location> _locations;
+    std::vector<session_stats> _stats;
+};
@@ -0,0 +1,911 @@
+/*
+ * Utilities for working with captured paint session corpora.
+ *
+ *     corpus_tool shard <shards> <output-dir> <capture>
+ *
+ * Splits a capture (as printed by the screenshot command, "-" for stdin) into <shards> translation units named
+ * session_shard_NNN.cpp. Each one holds a contiguous range of sessions and registers them with the benchmark at
+ * static-init time, so a full corpus can be compiled in parallel and without the whole capture in one compiler process:
+ *
+ *     zcat out.gz | ./corpus_tool shard 16 shards -
+ *     make SHARDS=16 -j"$(nproc)"
+ *
+ *     corpus_tool zoom <level> <output> <capture>
+ *
+ * Derives the sessions of a more zoomed out view from a capture: at each zoom level out, a session covers twice the
+ * screen columns, so groups of adjacent sessions are merged (structs painted in both are kept once) and their
+ * quadrant lists rebuilt. Structs smaller than a pixel at the target zoom are culled, and sessions are capped at the
+ * PaintStructs capacity as the game does. The output is tagged with its zoom level:
+ *
+ *     ./corpus_tool zoom 2 out.zoom2 out.gz
+ *     ./paint_struct_bench --corpus=out.gz --corpus=out.zoom2 --zoom-matrix
+ *
+ *     corpus_tool animate <session> <frames> <entities> <speed> <output> <capture> [seed]
+ *
+ * Turns one captured session into a sequence of frames with moving entities added, for measuring what changes from
+ * one frame to the next. Entities start on the captured structs and move along the map axes, bouncing off the edges
+ * of the captured area: guests at <speed> world units per frame, and every fourth entity a ride vehicle, larger and
+ * four times as fast. They are tagged with sprite_type like the game does and added to the quadrant their position
+ * hashes to, so they cross quadrant boundaries as they move. The same seed always gives the same sequence:
+ *
+ *     ./corpus_tool animate 120 60 500 1.5 frames out.gz
+ *     ./paint_struct_bench --corpus=frames --per-session
+ *
+ *     corpus_tool attach <per-struct> <output> <capture> [seed]
+ *
+ * Adds attached structs, the extra sprites the game paints along with a struct such as path railings or a guest's
+ * balloon, to every struct of a capture, <per-struct> of them on average. As in the game they are allocated from
+ * PaintStructs right after the struct they belong to, as long as the session's structs still fit:
+ *
+ *     ./corpus_tool attach 0.5 out.attached out.gz
+ *     ./paint_struct_bench --corpus=out.attached --pools
+ *
+ *     corpus_tool replay <ring> <capture> [rate] [loops]
+ *
+ * Stands in for the game as a live source of sessions: creates a shared memory ring and streams the capture's
+ * sessions through it in the binary form of session_codec.h, <rate> sessions per second (default 0, as fast as the
+ * consumer takes them), <loops> times over (default 1). Run the benchmark on the other end:
+ *
+ *     ./corpus_tool replay /paint-live out.gz 120 4 &
+ *     ./paint_struct_bench --live=/paint-live --arrangers=all
+ *
+ *     corpus_tool record <output> <capture> [fps] [rotation] [encoding]
+ *
+ * Writes the capture's sessions as a frame recording (see frame_recording.h), one frame every 1/<fps> seconds
+ * (default 60) at <rotation> (default 0), each with the viewport its structs cover. <encoding> is session (default)
+ * for every frame on its own, or delta for each frame as the change from the one before (see frame_delta.h), which
+ * suits sequences from animate. Recordings with the cadence of actual gameplay come from the benchmark's --live
+ * --record instead:
+ *
+ *     ./corpus_tool record out.frames out.gz 30
+ *     ./corpus_tool animate 120 600 500 1.5 frames out.gz
+ *     ./corpus_tool record frames.delta frames 60 0 delta
+ *     ./paint_struct_bench --replay=frames.delta --arrangers=all
+ *
+ *     corpus_tool index [--codec=lz4|none] [--block=SESSIONS] <output> <capture>...
+ *
+ * Converts captures into one indexed corpus (see corpus_index.h), from which the benchmark reads only the sessions
+ * it is asked for, by index or by their stats. Sessions are compressed in blocks of 16 with LZ4 unless told otherwise;
+ * uncompressed corpora are mapped rather than read:
+ *
+ *     ./corpus_tool index out.idx out.gz
+ *     ./paint_struct_bench --corpus=out.idx --sessions=173
+ *     ./paint_struct_bench --corpus=out.idx --where='structs>=2000' --per-session
+ */
+
+#include "corpus_index.h"
+#include "frame_delta.h"
+#include "frame_recording.h"
+#include "session_codec.h"
+#include "session_corpus.h"
+#include "shm_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <thread>
+#include <vector>
+
+static const char* const SESSION_MARKER = "{ /* session";
+
+// Reads the capture, split at session boundaries. Each entry holds the full text of one session initialiser.
+static bool read_sessions(const char* path, std::vector<std::string>& sessions, unsigned& zoom)
+{
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (std::strcmp(path, "-") != 0)
+    {
+        file.open(path);
+        if (!file)
+        {
+            std::fprintf(stderr, "Failed to open %s\n", path);
+            return false;
+        }
+        in = &file;
+    }
+
+    std::string line;
+    while (std::getline(*in, line))
+    {
+        if (line.find(SESSION_MARKER) != std::string::npos)
+        {
+            sessions.emplace_back();
+        }
+        else if (sessions.empty())
+        {
+            // Anything before the first session is not part of the initialiser list, apart from the zoom tag
+            std::sscanf(line.c_str(), " /* zoom: %u", &zoom);
+            continue;
+        }
+        sessions.back() += line;
+        sessions.back() += '\n';
+    }
+    return true;
+}
+
+static bool write_shard(
+    const std::string& path, const std::vector<std::string>& sessions, size_t first, size_t last, unsigned zoom)
+{
+    std::FILE* out = std::fopen(path.c_str(), "w");
+    if (out == nullptr)
+    {
+        std::fprintf(stderr, "Failed to create %s\n", path.c_str());
+        return false;
+    }
+    std::fprintf(out, "/* Generated by corpus_tool shard: sessions %zu-%zu */\n\n", first, last);
+    std::fprintf(out, "#include \"session_corpus.h\"\n\n");
+    if (first < last)
+    {
+        std::fprintf(out, "#include <iterator>\n\nstatic const paint_session s[] = {\n");
+        for (size_t i = first; i < last; i++)
+        {
+            std::fputs(sessions[i].c_str(), out);
+        }
+        std::fprintf(out, "};\n\nstatic session_shard_registrar s_registrar(s, std::size(s), %zu, %u);\n", first, zoom);
+    }
+    return std::fclose(out) == 0;
+}
+
+static int cmd_shard(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::fprintf(stderr, "Usage: corpus_tool shard <shards> <output-dir> <capture>\n");
+        return EXIT_FAILURE;
+    }
+    const size_t shardCount = std::strtoul(argv[0], nullptr, 10);
+    if (shardCount == 0)
+    {
+        std::fprintf(stderr, "Invalid shard count: %s\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> sessions;
+    unsigned zoom = 0;
+    if (!read_sessions(argv[2], sessions, zoom))
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Always emit exactly shardCount files so the build knows their names up front
+    for (size_t shard = 0; shard < shardCount; shard++)
+    {
+        const size_t first = sessions.size() * shard / shardCount;
+        const size_t last = sessions.size() * (shard + 1) / shardCount;
+        std::string name = std::to_string(shard);
+        name.insert(0, name.size() < 3 ? 3 - name.size() : 0, '0');
+        if (!write_shard(std::string(argv[1]) + "/session_shard_" + name + ".cpp", sessions, first, last, zoom))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    std::fprintf(stderr, "Split %zu sessions into %zu shards\n", sessions.size(), shardCount);
+    return EXIT_SUCCESS;
+}
+
+// Key identifying the same struct captured by more than one session
+using struct_key = std::tuple<uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t>;
+
+static struct_key make_key(const paint_struct& ps)
+{
+    return { ps.bounds.x, ps.bounds.y, ps.bounds.z, ps.bounds.x_end, ps.bounds.y_end, ps.bounds.z_end, ps.quadrant_index };
+}
+
+// Whether a struct still covers at least a pixel at the given zoom, where a pixel spans 2^zoom world units
+static bool visible_at_zoom(const paint_struct& ps, unsigned zoom)
+{
+    const int extents[] = {
+        std::abs(ps.bounds.x_end - ps.bounds.x),
+        std::abs(ps.bounds.y_end - ps.bounds.y),
+        std::abs(ps.bounds.z_end - ps.bounds.z),
+    };
+    return *std::max_element(std::begin(extents), std::end(extents)) + 1 >= (1 << zoom);
+}
+
+struct zoom_stats
+{
+    size_t duplicates = 0;
+    size_t culled = 0;
+    size_t dropped = 0;
+};
+
+// Merges captured sessions [first, last) into one session in the capture's index encoding
+static void merge_sessions(size_t first, size_t last, unsigned zoom, paint_session& merged, zoom_stats& stats)
+{
+    const size_t structCount = std::size(merged.PaintStructs);
+    const size_t quadrantCount = std::size(merged.Quadrants);
+
+    // A session can paint several structs with the same bounds (a path and its fences, say), so a struct is only a
+    // duplicate when an earlier session already had as many of them
+    std::vector<std::vector<const paint_struct*>> quadrants(quadrantCount);
+    std::map<struct_key, size_t> kept;
+    for (size_t index = first; index < last; index++)
+    {
+        const paint_session& session = session_corpus_get(index);
+        std::map<struct_key, size_t> occurrences;
+        for (size_t q = 0; q < quadrantCount; q++)
+        {
+            const size_t head = (size_t)session.Quadrants[q];
+            for (size_t entry = head == quadrantCount ? structCount : head; entry < structCount;
+                 entry = (size_t)session.PaintStructs[entry].basic.next_quadrant_ps)
+            {
+                const paint_struct& ps = session.PaintStructs[entry].basic;
+                const struct_key key = make_key(ps);
+                const size_t occurrence = ++occurrences[key];
+                if (occurrence <= kept[key])
+                {
+                    stats.duplicates++;
+                    continue;
+                }
+                kept[key] = occurrence;
+                if (!visible_at_zoom(ps, zoom))
+                {
+                    stats.culled++;
+                }
+                else
+                {
+                    quadrants[q].push_back(&ps);
+                }
+            }
+        }
+    }
+
+    for (auto& entry : merged.PaintStructs)
+    {
+        entry.basic = {};
+        entry.basic.next_quadrant_ps = (paint_struct*)structCount;
+    }
+    size_t used = 0;
+    for (size_t q = 0; q < quadrantCount; q++)
+    {
+        // Like the game, structs past the PaintStructs capacity are not painted
+        if (used == quadrantCount && !quadrants[q].empty())
+        {
+            // A head at struct 512 would read back as an empty quadrant
+            used++;
+        }
+        const size_t painted = std::min(quadrants[q].size(), structCount - used);
+        stats.dropped += quadrants[q].size() - painted;
+        merged.Quadrants[q] = painted == 0 ? (paint_struct*)quadrantCount : (paint_struct*)used;
+        for (size_t i = 0; i < painted; i++, used++)
+        {
+            paint_struct& copy = merged.PaintStructs[used].basic;
+            copy = *quadrants[q][i];
+            copy.next_quadrant_ps = i + 1 == painted ? (paint_struct*)structCount : (paint_struct*)(used + 1);
+        }
+    }
+}
+
+static int cmd_zoom(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::fprintf(stderr, "Usage: corpus_tool zoom <level> <output> <capture>\n");
+        return EXIT_FAILURE;
+    }
+    const unsigned zoom = (unsigned)std::strtoul(argv[0], nullptr, 10);
+    if (!session_corpus_load(argv[2]))
+    {
+        return EXIT_FAILURE;
+    }
+    const size_t sessionCount = session_corpus_size();
+    const unsigned sourceZoom = session_corpus_zoom(0);
+    if (zoom < sourceZoom || zoom > 7)
+    {
+        std::fprintf(stderr, "Can't derive zoom %u from a capture at zoom %u\n", zoom, sourceZoom);
+        return EXIT_FAILURE;
+    }
+
+    std::FILE* out = std::fopen(argv[1], "w");
+    if (out == nullptr)
+    {
+        std::fprintf(stderr, "Failed to create %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    session_corpus_write_zoom(out, (uint8_t)zoom);
+
+    const size_t groupSize = (size_t)1 << (zoom - sourceZoom);
+    auto merged = std::make_unique<paint_session>();
+    zoom_stats stats;
+    size_t written = 0;
+    for (size_t first = 0; first < sessionCount; first += groupSize)
+    {
+        merge_sessions(first, std::min(first + groupSize, sessionCount), zoom, *merged, stats);
+        session_corpus_write(out, *merged, written++);
+    }
+    if (std::fclose(out) != 0)
+    {
+        std::fprintf(stderr, "Failed to write %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    std::fprintf(
+        stderr, "Derived %zu sessions at zoom %u from %zu: %zu duplicates merged, %zu culled, %zu over capacity\n",
+        written, zoom, sessionCount, stats.duplicates, stats.culled, stats.dropped);
+    return EXIT_SUCCESS;
+}
+
+// VIEWPORT_INTERACTION_ITEM_SPRITE, which the game tags the structs of all entities with
+static constexpr uint8_t SPRITE_TYPE_ENTITY = 2;
+
+struct entity_kind
+{
+    uint16_t length[3]; // bounding box size, as passed to the game's paint functions
+    double speedScale;
+};
+
+static const entity_kind s_guest = { { 1, 1, 11 }, 1.0 };
+static const entity_kind s_vehicle = { { 16, 16, 12 }, 4.0 };
+
+struct entity
+{
+    const entity_kind* kind;
+    int32_t start[2]; // x and y within the captured area
+    int32_t z;
+    int axis;        // moves along x (0) or y (1)
+    double velocity; // world units per frame
+};
+
+static int32_t world_coordinate(uint16_t value)
+{
+    return (int16_t)value;
+}
+
+// Position after travelling distance from start, bouncing back and forth within [0, length]
+static int32_t bounce(int32_t start, double distance, int32_t length)
+{
+    if (length <= 0)
+    {
+        return 0;
+    }
+    const double period = 2.0 * length;
+    double position = std::fmod(start + distance, period);
+    if (position < 0)
+    {
+        position += period;
+    }
+    return (int32_t)(position <= length ? position : period - position);
+}
+
+// The game hashes a struct to a quadrant by its position along the view direction, 32 world units per quadrant
+static uint16_t quadrant_for(int32_t x, int32_t y, size_t quadrantCount)
+{
+    return (uint16_t)std::clamp<int32_t>((x + y) / 32, 0, (int32_t)quadrantCount - 1);
+}
+
+static int cmd_animate(int argc, char** argv)
+{
+    if (argc != 6 && argc != 7)
+    {
+        std::fprintf(stderr, "Usage: corpus_tool animate <session> <frames> <entities> <speed> <output> <capture> [seed]\n");
+        return EXIT_FAILURE;
+    }
+    const size_t sessionIndex = std::strtoul(argv[0], nullptr, 10);
+    const size_t frameCount = std::strtoul(argv[1], nullptr, 10);
+    const size_t entityCount = std::strtoul(argv[2], nullptr, 10);
+    const double speed = std::strtod(argv[3], nullptr);
+    const uint32_t seed = argc == 7 ? (uint32_t)std::strtoul(argv[6], nullptr, 10) : 1;
+    if (frameCount == 0)
+    {
+        std::fprintf(stderr, "Invalid frame count: %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (!session_corpus_load(argv[5]))
+    {
+        return EXIT_FAILURE;
+    }
+    if (sessionIndex >= session_corpus_size())
+    {
+        std::fprintf(stderr, "Session %zu out of range, the capture has %zu\n", sessionIndex, session_corpus_size());
+        return EXIT_FAILURE;
+    }
+
+    const paint_session& base = session_corpus_get(sessionIndex);
+    const size_t structCount = std::size(base.PaintStructs);
+    const size_t quadrantCount = std::size(base.Quadrants);
+
+    // Entries reachable from the quadrants are the captured structs, with their attached structs, the rest is free for
+    // entities
+    std::vector<bool> used(structCount, false);
+    std::vector<const paint_struct*> captured;
+    int32_t low[2] = { INT32_MAX, INT32_MAX };
+    int32_t high[2] = { INT32_MIN, INT32_MIN };
+    for (const paint_struct* head : base.Quadrants)
+    {
+        for (size_t entry = (size_t)head == quadrantCount ? structCount : (size_t)head; entry < structCount;
+             entry = (size_t)base.PaintStructs[entry].basic.next_quadrant_ps)
+        {
+            const paint_struct& ps = base.PaintStructs[entry].basic;
+            used[entry] = true;
+            captured.push_back(&ps);
+            // As for session_corpus_write(), an index of 0 stands for no attached struct
+            for (size_t child = (size_t)ps.attached_ps; child != 0 && child < structCount && !used[child];
+                 child = (size_t)base.PaintStructs[child].attached.next)
+            {
+                used[child] = true;
+            }
+            low[0] = std::min(low[0], world_coordinate(ps.bounds.x));
+            low[1] = std::min(low[1], world_coordinate(ps.bounds.y));
+            high[0] = std::max(high[0], world_coordinate(ps.bounds.x_end));
+            high[1] = std::max(high[1], world_coordinate(ps.bounds.y_end));
+        }
+    }
+    std::vector<uint16_t> freeEntries;
+    for (size_t entry = 0; entry < structCount; entry++)
+    {
+        // A head at struct 512 would read back as an empty quadrant
+        if (!used[entry] && entry != quadrantCount)
+        {
+            freeEntries.push_back((uint16_t)entry);
+        }
+    }
+    if (captured.empty())
+    {
+        std::fprintf(stderr, "Session %zu has no paint structs to place entities on\n", sessionIndex);
+        return EXIT_FAILURE;
+    }
+    const size_t placed = std::min(entityCount, freeEntries.size());
+
+    // Raw engine output is the same everywhere, unlike the standard distributions
+    std::mt19937 random(seed);
+    std::vector<entity> entities;
+    for (size_t i = 0; i < placed; i++)
+    {
+        const paint_struct& on = *captured[random() % captured.size()];
+        entity e;
+        e.kind = i % 4 == 3 ? &s_vehicle : &s_guest;
+        e.start[0] = world_coordinate(on.bounds.x) - low[0];
+        e.start[1] = world_coordinate(on.bounds.y) - low[1];
+        e.z = world_coordinate(on.bounds.z_end);
+        e.axis = random() % 2;
+        e.velocity = speed * e.kind->speedScale * (random() % 2 == 0 ? 1 : -1);
+        entities.push_back(e);
+    }
+
+    std::FILE* out = std::fopen(argv[4], "w");
+    if (out == nullptr)
+    {
+        std::fprintf(stderr, "Failed to create %s\n", argv[4]);
+        return EXIT_FAILURE;
+    }
+    session_corpus_write_zoom(out, session_corpus_zoom(sessionIndex));
+
+    auto frame = std::make_unique<paint_session>();
+    size_t crossings = 0;
+    std::vector<uint16_t> lastQuadrant(placed);
+    for (size_t frameIndex = 0; frameIndex < frameCount; frameIndex++)
+    {
+        *frame = base;
+        for (size_t i = 0; i < placed; i++)
+        {
+            const entity& e = entities[i];
+            const entity_kind& kind = *e.kind;
+            int32_t position[2] = { e.start[0], e.start[1] };
+            const int32_t length = high[e.axis] - low[e.axis] - kind.length[e.axis];
+            position[e.axis] = bounce(e.start[e.axis], e.velocity * frameIndex, length);
+            const int32_t x = low[0] + position[0];
+            const int32_t y = low[1] + position[1];
+
+            paint_struct& ps = frame->PaintStructs[freeEntries[i]].basic;
+            ps = {};
+            ps.bounds.x = (uint16_t)x;
+            ps.bounds.y = (uint16_t)y;
+            ps.bounds.z = (uint16_t)e.z;
+            ps.bounds.x_end = (uint16_t)(x + kind.length[0] - 1);
+            ps.bounds.y_end = (uint16_t)(y + kind.length[1] - 1);
+            ps.bounds.z_end = (uint16_t)(e.z + kind.length[2] - 1);
+            ps.sprite_type = SPRITE_TYPE_ENTITY;
+            ps.quadrant_index = quadrant_for(x, y, quadrantCount);
+
+            // Like the game, the struct painted last goes to the front of its quadrant
+            paint_struct*& head = frame->Quadrants[ps.quadrant_index];
+            ps.next_quadrant_ps = (size_t)head == quadrantCount ? (paint_struct*)structCount : head;
+            head = (paint_struct*)(uintptr_t)freeEntries[i];
+
+            crossings += frameIndex > 0 && lastQuadrant[i] != ps.quadrant_index;
+            lastQuadrant[i] = ps.quadrant_index;
+        }
+        session_corpus_write(out, *frame, frameIndex);
+    }
+    if (std::fclose(out) != 0)
+    {
+        std::fprintf(stderr, "Failed to write %s\n", argv[4]);
+        return EXIT_FAILURE;
+    }
+    std::fprintf(stderr, "Wrote %zu frames with %zu entities (%zu didn't fit), %zu quadrant crossings\n", frameCount,
+        placed, entityCount - placed, crossings);
+    return EXIT_SUCCESS;
+}
+
+static int cmd_attach(int argc, char** argv)
+{
+    if (argc != 3 && argc != 4)
+    {
+        std::fprintf(stderr, "Usage: corpus_tool attach <per-struct> <output> <capture> [seed]\n");
+        return EXIT_FAILURE;
+    }
+    const double perStruct = std::strtod(argv[0], nullptr);
+    const uint32_t seed = argc == 4 ? (uint32_t)std::strtoul(argv[3], nullptr, 10) : 1;
+    if (!(perStruct >= 0))
+    {
+        std::fprintf(stderr, "Invalid attached structs per struct: %s\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!session_corpus_load(argv[2]))
+    {
+        return EXIT_FAILURE;
+    }
+    std::FILE* out = std::fopen(argv[1], "w");
+    if (out == nullptr)
+    {
+        std::fprintf(stderr, "Failed to create %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    session_corpus_write_zoom(out, session_corpus_zoom(0));
+
+    // Drawn from raw engine output as in cmd_animate: each struct gets another attached one while a draw falls below
+    // the threshold, perStruct of them on average, and offsets are draws modulo 32
+    std::mt19937 random(seed);
+    const uint64_t another = (uint64_t)std::ldexp(perStruct / (1 + perStruct), 32);
+    auto attached = std::make_unique<paint_session>();
+    const size_t structCount = std::size(attached->PaintStructs);
+    const size_t quadrantCount = std::size(attached->Quadrants);
+    size_t structs = 0;
+    size_t added = 0;
+    size_t dropped = 0;
+    for (size_t i = 0; i < session_corpus_size(); i++)
+    {
+        const paint_session& source = session_corpus_get(i);
+        std::vector<size_t> order;
+        std::vector<bool> heads;
+        for (const paint_struct* head : source.Quadrants)
+        {
+            for (size_t entry = (size_t)head == quadrantCount ? structCount : (size_t)head; entry < structCount;
+                 entry = (size_t)source.PaintStructs[entry].basic.next_quadrant_ps)
+            {
+                heads.push_back(entry == (size_t)head);
+                order.push_back(entry);
+            }
+        }
+
+        for (auto& entry : attached->PaintStructs)
+        {
+            entry.basic = {};
+            entry.basic.next_quadrant_ps = (paint_struct*)structCount;
+        }
+        std::vector<size_t> renumbered(structCount, structCount);
+        size_t used = 0;
+        for (size_t j = 0; j < order.size(); j++)
+        {
+            // A quadrant can't start at entry 512 in the capture's encoding, as for session_corpus_write()
+            if (heads[j] && used == quadrantCount && used + order.size() - j < structCount)
+            {
+                used++;
+            }
+            const size_t parent = used++;
+            renumbered[order[j]] = parent;
+            attached->PaintStructs[parent].basic = source.PaintStructs[order[j]].basic;
+            attached->PaintStructs[parent].basic.attached_ps = nullptr;
+            attached_paint_struct* previous = nullptr;
+            while (random() < another)
+            {
+                // Room is kept for the structs still to come, attached ones past it are not painted
+                if (used + order.size() - j > structCount)
+                {
+                    dropped++;
+                    continue;
+                }
+                attached_paint_struct& attachedPs = attached->PaintStructs[used].attached;
+                attachedPs.x = (uint16_t)(random() % 32);
+                attachedPs.y = (uint16_t)(random() % 32);
+                attachedPs.next = nullptr;
+                (previous == nullptr ? attached->PaintStructs[parent].basic.attached_ps : previous->next)
+                    = (attached_paint_struct*)used;
+                previous = &attachedPs;
+                used++;
+                added++;
+            }
+        }
+        for (size_t entry : order)
+        {
+            paint_struct& ps = attached->PaintStructs[renumbered[entry]].basic;
+            const size_t next = (size_t)ps.next_quadrant_ps;
+            ps.next_quadrant_ps = (paint_struct*)(next < structCount ? renumbered[next] : structCount);
+        }
+        for (size_t quadrant = 0; quadrant < quadrantCount; quadrant++)
+        {
+            const size_t head = (size_t)source.Quadrants[quadrant];
+            attached->Quadrants[quadrant] = (paint_struct*)(head == quadrantCount ? quadrantCount : renumbered[head]);
+        }
+        session_corpus_write(out, *attached, i);
+        structs += order.size();
+    }
+    if (std::fclose(out) != 0)
+    {
+        std::fprintf(stderr, "Failed to write %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    std::fprintf(stderr, "Attached %zu structs to %zu in %zu sessions, %zu over capacity\n", added, structs,
+        session_corpus_size(), dropped);
+    return EXIT_SUCCESS;
+}
+
+static int cmd_replay(int argc, char** argv)
+{
+    if (argc < 2 || argc > 4)
+    {
+        std::fprintf(stderr, "Usage: corpus_tool replay <ring> <capture> [rate] [loops]\n");
+        return EXIT_FAILURE;
+    }
+    const double rate = argc >= 3 ? std::strtod(argv[2], nullptr) : 0;
+    const size_t loops = argc >= 4 ? std::strtoul(argv[3], nullptr, 10) : 1;
+    if (rate < 0 || loops == 0)
+    {
+        std::fprintf(stderr, "Invalid rate or loop count\n");
+        return EXIT_FAILURE;
+    }
+    if (!session_corpus_load(argv[1]))
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Encoded up front, the game would have its sessions in memory too
+    std::vector<std::vector<uint8_t>> encoded(session_corpus_size());
+    size_t largest = 0;
+    for (size_t i = 0; i < encoded.size(); i++)
+    {
+        session_encode(session_corpus_get(i), session_corpus_zoom(i), encoded[i]);
+        largest = std::max(largest, encoded[i].size());
+    }
+
+    shm_ring ring;
+    if (!ring.create(argv[0], std::max<size_t>(16 << 20, largest * 4)))
+    {
+        return EXIT_FAILURE;
+    }
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    size_t sent = 0;
+    size_t bytes = 0;
+    for (size_t loop = 0; loop < loops; loop++)
+    {
+        for (const auto& message : encoded)
+        {
+            if (rate > 0)
+            {
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(
+                                                          std::chrono::duration<double>(sent / rate)));
+            }
+            if (!ring.write(message.data(), message.size()))
+            {
+                return EXIT_FAILURE;
+            }
+            sent++;
+            bytes += message.size();
+        }
+    }
+    ring.close();
+    const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    if (!ring.drain(30))
+    {
+        std::fprintf(stderr, "The consumer didn't take all sessions within 30 s\n");
+        return EXIT_FAILURE;
+    }
+    std::fprintf(stderr, "Sent %zu sessions (%.2f MiB) in %.3f s, blocked on a full ring for %.3f s\n", sent,
+        bytes / (double)(1 << 20), elapsed, ring.blocked_seconds());
+    return EXIT_SUCCESS;
+}
+
+// Whether both sessions hold the same structs in the same quadrant lists, wherever their slots are
+static bool same_lists(const paint_session& a, const paint_session& b)
+{
+    for (size_t quadrant = 0; quadrant < std::size(a.Quadrants); quadrant++)
+    {
+        const paint_struct* left = a.Quadrants[quadrant];
+        const paint_struct* right = b.Quadrants[quadrant];
+        for (; left != nullptr && right != nullptr; left = left->next_quadrant_ps, right = right->next_quadrant_ps)
+        {
+            if (std::memcmp(&left->bounds, &right->bounds, sizeof(left->bounds)) != 0
+                || left->quadrant_index != right->quadrant_index || left->quadrant_flags != right->quadrant_flags
+                || left->sprite_type != right->sprite_type)
+            {
+                return false;
+            }
+        }
+        if (left != right)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int cmd_record(int argc, char** argv)
+{
+    if (argc < 2 || argc > 5)
+    {
+        std::fprintf(stderr, "Usage: corpus_tool record <output> <capture> [fps] [rotation] [encoding]\n");
+        return EXIT_FAILURE;
+    }
+    const double fps = argc >= 3 ? std::strtod(argv[2], nullptr) : 60;
+    const unsigned long rotation = argc >= 4 ? std::strtoul(argv[3], nullptr, 10) : 0;
+    const std::string encodingName = argc >= 5 ? argv[4] : "session";
+    if (fps <= 0 || rotation > 3 || (encodingName != "session" && encodingName != "delta"))
+    {
+        std::fprintf(stderr, "Invalid frame rate, rotation or encoding\n");
+        return EXIT_FAILURE;
+    }
+    const frame_encoding encoding = encodingName == "delta" ? frame_encoding::delta : frame_encoding::session;
+    if (!session_corpus_load(argv[1]))
+    {
+        return EXIT_FAILURE;
+    }
+
+    frame_recorder recorder;
+    if (!recorder.open(argv[0], encoding))
+    {
+        return EXIT_FAILURE;
+    }
+    // The viewport is measured on the decoded session, which has its pointers fixed up
+    auto session = std::make_unique<paint_session>();
+    frame_delta_encoder deltas;
+    // Every delta is decoded again and checked against the session encoding before it's written
+    frame_delta_decoder check;
+    auto checked = std::make_unique<paint_session>();
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> delta;
+    size_t sessionBytes = 0;
+    size_t written = 0;
+    for (size_t i = 0; i < session_corpus_size(); i++)
+    {
+        encoded.clear();
+        session_encode(session_corpus_get(i), session_corpus_zoom(i), encoded);
+        sessionBytes += encoded.size();
+        uint8_t zoom;
+        session_decode(encoded.data(), encoded.size(), *session, zoom);
+        const recorded_viewport viewport = recorded_viewport_of(*session, zoom, (uint8_t)rotation);
+        if (encoding == frame_encoding::delta)
+        {
+            delta.clear();
+            deltas.encode(session_corpus_get(i), session_corpus_zoom(i), delta);
+            if (!check.decode(delta.data(), delta.size()))
+            {
+                std::fprintf(stderr, "Frame %zu: the delta doesn't decode\n", i);
+                return EXIT_FAILURE;
+            }
+            check.get(*checked);
+            if (check.zoom() != zoom || !same_lists(*session, *checked))
+            {
+                std::fprintf(stderr, "Frame %zu: the delta decodes to a different session than the session encoding\n", i);
+                return EXIT_FAILURE;
+            }
+        }
+        const std::vector<uint8_t>& frame = encoding == frame_encoding::delta ? delta : encoded;
+        written += frame.size();
+        if (!recorder.write((uint64_t)std::llround(i * 1e9 / fps), viewport, frame.data(), frame.size()))
+        {
+            break;
+        }
+    }
+    if (!recorder.close())
+    {
+        std::fprintf(stderr, "Failed to write %s\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const size_t frames = recorder.frames();
+    std::fprintf(stderr,
+        "Recorded %zu frames over %.3f s, %.0f bytes per frame: %.0f:1 against full sessions, %.1f:1 against the "
+        "session encoding\n",
+        frames, frames / fps, frames == 0 ? 0.0 : (double)written / frames,
+        written == 0 ? 0.0 : (double)sizeof(paint_session) * frames / written,
+        written == 0 ? 0.0 : (double)sessionBytes / written);
+    return EXIT_SUCCESS;
+}
+
+static int cmd_index(int argc, char** argv)
+{
+    block_codec codec = block_codec::lz4;
+    unsigned long blockSessions = 16;
+    bool ok = true;
+    for (; argc > 0 && std::strncmp(argv[0], "--", 2) == 0; argc--, argv++)
+    {
+        char* end = nullptr;
+        if (std::strncmp(argv[0], "--codec=", 8) == 0)
+        {
+            ok = ok && block_codec_parse(argv[0] + 8, codec);
+        }
+        else if (std::strncmp(argv[0], "--block=", 8) == 0)
+        {
+            blockSessions = std::strtoul(argv[0] + 8, &end, 10);
+            ok = ok && *end == '\0' && blockSessions > 0;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+    if (!ok || argc < 2)
+    {
+        std::fprintf(stderr, "Usage: corpus_tool index [--codec=lz4|none] [--block=SESSIONS] <output> <capture>...\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        if (!session_corpus_load(argv[i]))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    if (!corpus_index_write(argv[0], codec, blockSessions))
+    {
+        return EXIT_FAILURE;
+    }
+    indexed_corpus index;
+    if (!index.open(argv[0]))
+    {
+        return EXIT_FAILURE;
+    }
+    std::FILE* file = std::fopen(argv[0], "rb");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "Failed to open %s\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::fseek(file, 0, SEEK_END);
+    const long fileBytes = std::ftell(file);
+    std::fclose(file);
+    std::fprintf(stderr, "Indexed %zu sessions, %.1f MB of session encoding in %.1f MB (%.1f:1, %s)\n",
+        session_corpus_size(), index.session_bytes() / 1e6, fileBytes / 1e6, (double)index.session_bytes() / fileBytes,
+        block_codec_name(codec));
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 2 && std::strcmp(argv[1], "shard") == 0)
+    {
+        return cmd_shard(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "zoom") == 0)
+    {
+        return cmd_zoom(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "animate") == 0)
+    {
+        return cmd_animate(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "attach") == 0)
+    {
+        return cmd_attach(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "replay") == 0)
+    {
+        return cmd_replay(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "record") == 0)
+    {
+        return cmd_record(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "index") == 0)
+    {
+        return cmd_index(argc - 2, argv + 2);
+    }
+    std::fprintf(stderr, "Usage: corpus_tool shard <shards> <output-dir> <capture>\n");
+    std::fprintf(stderr, "       corpus_tool zoom <level> <output> <capture>\n");
+    std::fprintf(stderr, "       corpus_tool animate <session> <frames> <entities> <speed> <output> <capture> [seed]\n");
+    std::fprintf(stderr, "       corpus_tool attach <per-struct> <output> <capture> [seed]\n");
+    std::fprintf(stderr, "       corpus_tool replay <ring> <capture> [rate] [loops]\n");
+    std::fprintf(stderr, "       corpus_tool record <output> <capture> [fps] [rotation] [encoding]\n");
+    std::fprintf(stderr, "       corpus_tool index [--codec=lz4|none] [--block=SESSIONS] <output> <capture>...\n");
+    return EXIT_FAILURE;
+}
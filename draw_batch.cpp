@@ -0,0 +1,160 @@
+#include "draw_batch.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+static constexpr int32_t CELL_SIZE = 64;
+
+static bool intersects(const screen_rect& a, const screen_rect& b)
+{
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+static bool empty(const screen_rect& rect)
+{
+    return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+
+size_t draw_command_runs(const std::vector<draw_command>& commands)
+{
+    size_t runs = 0;
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        runs += i == 0 || commands[i].image_id != commands[i - 1].image_id;
+    }
+    return runs;
+}
+
+void draw_commands_batch(std::vector<draw_command>& commands, draw_batch_stats* stats)
+{
+    const size_t count = commands.size();
+    screen_rect area = { INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+    for (const draw_command& command : commands)
+    {
+        if (!empty(command.rect))
+        {
+            area = { std::min(area.left, command.rect.left), std::min(area.top, command.rect.top),
+                std::max(area.right, command.rect.right), std::max(area.bottom, command.rect.bottom) };
+        }
+    }
+
+    // Every command depends on the earlier ones it intersects, which share a cell with it
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    if (area.left < area.right)
+    {
+        const int32_t columns = (area.right - area.left + CELL_SIZE - 1) / CELL_SIZE;
+        const int32_t rows = (area.bottom - area.top + CELL_SIZE - 1) / CELL_SIZE;
+        std::vector<std::vector<uint32_t>> cells((size_t)columns * rows);
+        std::vector<uint32_t> seen(count, UINT32_MAX); // last command an earlier one was checked against
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const screen_rect& rect = commands[i].rect;
+            if (empty(rect))
+            {
+                continue;
+            }
+            for (int32_t row = (rect.top - area.top) / CELL_SIZE; row <= (rect.bottom - 1 - area.top) / CELL_SIZE; row++)
+            {
+                for (int32_t column = (rect.left - area.left) / CELL_SIZE;
+                     column <= (rect.right - 1 - area.left) / CELL_SIZE; column++)
+                {
+                    std::vector<uint32_t>& cell = cells[(size_t)row * columns + column];
+                    for (uint32_t earlier : cell)
+                    {
+                        if (seen[earlier] != i && intersects(commands[earlier].rect, rect))
+                        {
+                            edges.emplace_back(earlier, i);
+                        }
+                        seen[earlier] = i;
+                    }
+                    cell.push_back(i);
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> firstSuccessor(count + 1, 0);
+    std::vector<uint32_t> pending(count, 0);
+    for (const auto& [from, to] : edges)
+    {
+        firstSuccessor[from + 1]++;
+        pending[to]++;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        firstSuccessor[i + 1] += firstSuccessor[i];
+    }
+    std::vector<uint32_t> successors(edges.size());
+    std::vector<uint32_t> filled(firstSuccessor.begin(), firstSuccessor.end() - 1);
+    for (const auto& [from, to] : edges)
+    {
+        successors[filled[from]++] = to;
+    }
+
+    // Ready commands by position, overall and per image id. A command sits in both heaps until taken from either.
+    std::vector<uint32_t> ready;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> readyById;
+    std::vector<bool> taken(count, false);
+    auto push = [&](uint32_t i) {
+        ready.push_back(i);
+        std::push_heap(ready.begin(), ready.end(), std::greater<uint32_t>());
+        std::vector<uint32_t>& sameId = readyById[commands[i].image_id];
+        sameId.push_back(i);
+        std::push_heap(sameId.begin(), sameId.end(), std::greater<uint32_t>());
+    };
+    auto pop = [&](std::vector<uint32_t>& heap) {
+        while (!heap.empty())
+        {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<uint32_t>());
+            const uint32_t i = heap.back();
+            heap.pop_back();
+            if (!taken[i])
+            {
+                return i;
+            }
+        }
+        return UINT32_MAX;
+    };
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (pending[i] == 0)
+        {
+            push(i);
+        }
+    }
+
+    std::vector<draw_command> batched;
+    batched.reserve(count);
+    while (batched.size() < count)
+    {
+        uint32_t next = UINT32_MAX;
+        if (!batched.empty())
+        {
+            next = pop(readyById[batched.back().image_id]);
+        }
+        if (next == UINT32_MAX)
+        {
+            next = pop(ready);
+        }
+        taken[next] = true;
+        batched.push_back(commands[next]);
+        for (uint32_t j = firstSuccessor[next]; j < firstSuccessor[next + 1]; j++)
+        {
+            if (--pending[successors[j]] == 0)
+            {
+                push(successors[j]);
+            }
+        }
+    }
+
+    if (stats != nullptr)
+    {
+        stats->commands += count;
+        stats->edges += edges.size();
+        stats->runs_before += draw_command_runs(commands);
+        stats->runs_after += draw_command_runs(batched);
+    }
+    commands = std::move(batched);
+}
@@ -0,0 +1,29 @@
+/*
+ * Reordering of draw commands into runs of the same sprite, without changing a single pixel.
+ *
+ * Arranged order bounces between unrelated sprites, and every change of sprite is a trip to the sprite cache. Two
+ * commands whose rectangles don't intersect commute, as neither draws where the other does. Only the relative order of
+ * intersecting commands is therefore kept: they make up a graph of which command has to precede which, found through a
+ * grid of screen cells, and the commands are emitted in an order that respects it, always continuing with the sprite
+ * last drawn while a command of it is ready, and otherwise with the earliest ready command.
+ */
+
+#pragma once
+
+#include "paint_draw.h"
+
+#include <cstddef>
+#include <vector>
+
+struct draw_batch_stats
+{
+    size_t commands = 0;
+    size_t edges = 0;       // pairs of intersecting commands
+    size_t runs_before = 0; // maximal runs of the same image id
+    size_t runs_after = 0;
+};
+
+// Count of maximal runs of commands with the same image id
+size_t draw_command_runs(const std::vector<draw_command>& commands);
+
+void draw_commands_batch(std::vector<draw_command>& commands, draw_batch_stats* stats = nullptr);
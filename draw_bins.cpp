@@ -0,0 +1,106 @@
+#include "draw_bins.h"
+
+#include <algorithm>
+#include <atomic>
+
+static constexpr size_t LOOKUP_BATCH = 256; // commands whose sprites a job looks up
+
+// Bins overlapped by the command's visible area, as an exclusive range of columns and rows
+static bool bin_range(const draw_command& command, const compressed_sprite& sprite, const paint_framebuffer& framebuffer,
+    int32_t binSize, screen_rect& range)
+{
+    const int32_t left = std::max(command.rect.left - framebuffer.x, 0);
+    const int32_t top = std::max(command.rect.top - framebuffer.y, 0);
+    const int32_t right = std::min(
+        { command.rect.left + sprite.width, command.rect.right, framebuffer.x + framebuffer.width }) - framebuffer.x;
+    const int32_t bottom = std::min(
+        { command.rect.top + sprite.height, command.rect.bottom, framebuffer.y + framebuffer.height }) - framebuffer.y;
+    if (left >= right || top >= bottom)
+    {
+        return false;
+    }
+    range = { left / binSize, top / binSize, (right - 1) / binSize + 1, (bottom - 1) / binSize + 1 };
+    return true;
+}
+
+void draw_bins_assign(const std::vector<draw_command>& commands, const sprite_set& sprites,
+    const paint_framebuffer& framebuffer, int32_t binSize, draw_bins& bins)
+{
+    bins.size = binSize;
+    bins.columns = (framebuffer.width + binSize - 1) / binSize;
+    bins.rows = (framebuffer.height + binSize - 1) / binSize;
+    bins.first.assign(bins.count() + 1, 0);
+
+    // Counted first, then filled in command order, which keeps drawing order within every bin
+    std::vector<screen_rect> ranges(commands.size());
+    std::vector<bool> visible(commands.size(), false);
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        const compressed_sprite* sprite = sprites.find(commands[i].image_id);
+        visible[i] = sprite != nullptr && bin_range(commands[i], *sprite, framebuffer, binSize, ranges[i]);
+        if (!visible[i])
+        {
+            continue;
+        }
+        for (int32_t row = ranges[i].top; row < ranges[i].bottom; row++)
+        {
+            for (int32_t column = ranges[i].left; column < ranges[i].right; column++)
+            {
+                bins.first[(size_t)row * bins.columns + column + 1]++;
+            }
+        }
+    }
+    for (size_t bin = 0; bin < bins.count(); bin++)
+    {
+        bins.first[bin + 1] += bins.first[bin];
+    }
+    bins.commands.resize(bins.first.back());
+    std::vector<uint32_t> filled(bins.first.begin(), bins.first.end() - 1);
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        if (!visible[i])
+        {
+            continue;
+        }
+        for (int32_t row = ranges[i].top; row < ranges[i].bottom; row++)
+        {
+            for (int32_t column = ranges[i].left; column < ranges[i].right; column++)
+            {
+                bins.commands[filled[(size_t)row * bins.columns + column]++] = (uint32_t)i;
+            }
+        }
+    }
+}
+
+uint64_t draw_bins_draw(const std::vector<draw_command>& commands, draw_bins& bins, sprite_cache& cache,
+    paint_framebuffer& framebuffer, job_pool& pool, palette_remap_cache* remaps)
+{
+    bins.sprites.resize(commands.size());
+    pool.run((commands.size() + LOOKUP_BATCH - 1) / LOOKUP_BATCH, [&](size_t batch) {
+        const size_t end = std::min(commands.size(), (batch + 1) * LOOKUP_BATCH);
+        for (size_t i = batch * LOOKUP_BATCH; i < end; i++)
+        {
+            bins.sprites[i] = cache.get(commands[i].image_id);
+        }
+    });
+
+    std::atomic<uint64_t> written{ 0 };
+    pool.run(bins.count(), [&](size_t bin) {
+        const int32_t left = framebuffer.x + (int32_t)(bin % bins.columns) * bins.size;
+        const int32_t top = framebuffer.y + (int32_t)(bin / bins.columns) * bins.size;
+        const screen_rect clip = { left, top, left + bins.size, top + bins.size };
+        uint64_t binWritten = 0;
+        for (uint32_t i = bins.first[bin]; i < bins.first[bin + 1]; i++)
+        {
+            const decoded_sprite* sprite = bins.sprites[bins.commands[i]].get();
+            if (sprite != nullptr)
+            {
+                binWritten += paint_draw_command(commands[bins.commands[i]], *sprite, clip, framebuffer, remaps);
+            }
+        }
+        written += binWritten;
+    });
+    // Evicted sprites are freed once drawn
+    bins.sprites.clear();
+    return written;
+}
@@ -0,0 +1,41 @@
+/*
+ * Parallel drawing of a single session by splitting its framebuffer into square bins.
+ *
+ * Each draw command goes to every bin its visible area overlaps, that is its rectangle cut down to the size of its
+ * sprite, and keeps its place in drawing order within each. A bin only ever writes its own pixels, so bins can be
+ * drawn concurrently, in any order, and still leave the picture serial drawing does. The commands' sprites are looked up
+ * in the sprite cache in a parallel pass of their own before, so that commands crossing bin edges are looked up once.
+ */
+
+#pragma once
+
+#include "job_pool.h"
+#include "paint_draw.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct draw_bins
+{
+    int32_t size = 0; // width and height of a bin in pixels
+    int32_t columns = 0;
+    int32_t rows = 0;
+    std::vector<uint32_t> first;    // start of each bin's commands, row by row, and the end of the last
+    std::vector<uint32_t> commands; // indices of the commands drawn in each bin, in drawing order
+    std::vector<std::shared_ptr<const decoded_sprite>> sprites; // of every command, while drawing
+
+    size_t count() const
+    {
+        return (size_t)columns * rows;
+    }
+};
+
+// Commands whose image id the set doesn't have are left out
+void draw_bins_assign(const std::vector<draw_command>& commands, const sprite_set& sprites,
+    const paint_framebuffer& framebuffer, int32_t binSize, draw_bins& bins);
+
+// Draws the bins as jobs of the pool, returns the number of pixels written
+uint64_t draw_bins_draw(const std::vector<draw_command>& commands, draw_bins& bins, sprite_cache& cache,
+    paint_framebuffer& framebuffer, job_pool& pool, palette_remap_cache* remaps = nullptr);
@@ -0,0 +1,105 @@
+#include "frame_budget.h"
+
+#include "job_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+struct frame_stats
+{
+    size_t misses = 0;
+    size_t worstConsecutive = 0;
+};
+
+static frame_stats count_misses(const std::vector<double>& frameTimes, double budget)
+{
+    frame_stats stats;
+    size_t consecutive = 0;
+    for (double time : frameTimes)
+    {
+        if (time > budget)
+        {
+            stats.misses++;
+            stats.worstConsecutive = std::max(stats.worstConsecutive, ++consecutive);
+        }
+        else
+        {
+            consecutive = 0;
+        }
+    }
+    return stats;
+}
+
+// Arrange time of every frame in nanoseconds, over all loops
+static std::vector<double> time_frames(const frame_budget_options& options, session_set& set,
+    const paint_arranger& arranger, job_pool& pool, uint8_t rotation)
+{
+    using clock = std::chrono::steady_clock;
+    const size_t frameCount = (set.size() + options.frameSessions - 1) / options.frameSessions;
+    std::vector<double> frameTimes;
+    frameTimes.reserve(frameCount * options.loops);
+    for (size_t loop = 0; loop < options.loops; loop++)
+    {
+        set.reset(rotation);
+        for (size_t frame = 0; frame < frameCount; frame++)
+        {
+            paint_session* first = &set.data()[frame * options.frameSessions];
+            const size_t sessions = std::min(options.frameSessions, set.size() - frame * options.frameSessions);
+            const auto start = clock::now();
+            pool.run(sessions, [&](size_t i) { arranger.arrange(&first[i]); });
+            const auto end = clock::now();
+            frameTimes.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+    }
+    return frameTimes;
+}
+
+void frame_budget_run(const frame_budget_options& options, const std::vector<size_t>& sessions,
+    const std::vector<const paint_arranger*>& arrangers, const std::vector<int>& threads, uint8_t rotation,
+    session_reset reset)
+{
+    session_set set(sessions, reset);
+    const size_t frameCount = (set.size() + options.frameSessions - 1) / options.frameSessions;
+    std::printf("Replaying %zu frames of %zu session(s) %zu times (%zu frames measured) at rotation %u, arrangement "
+                "gets %.0f%% of the frame\n\n",
+        frameCount, options.frameSessions, options.loops, frameCount * options.loops, rotation,
+        options.arrangeFraction * 100);
+    std::printf("%-20s %7s %6s %12s %10s %10s %10s %10s %9s %8s\n", "arranger", "threads", "Hz", "budget us", "mean us",
+        "p99 us", "max us", "jitter us", "misses", "worst");
+
+    for (const paint_arranger* arranger : arrangers)
+    {
+        for (int threadCount : threads)
+        {
+            job_pool pool((size_t)threadCount);
+            // Warm up caches and the pool's threads before the frames that count
+            set.reset(rotation);
+            pool.run(set.size(), [&](size_t i) { arranger->arrange(&set.data()[i]); });
+
+            const std::vector<double> frameTimes = time_frames(options, set, *arranger, pool, rotation);
+            std::vector<double> sorted = frameTimes;
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0;
+            double jitter = 0;
+            for (size_t i = 0; i < frameTimes.size(); i++)
+            {
+                total += frameTimes[i];
+                jitter += i == 0 ? 0 : std::fabs(frameTimes[i] - frameTimes[i - 1]);
+            }
+            const double mean = total / frameTimes.size();
+            const double p99 = sorted[std::min(sorted.size() - 1, (size_t)std::ceil(sorted.size() * 0.99) - 1)];
+            jitter /= std::max<size_t>(frameTimes.size() - 1, 1);
+
+            for (double rate : options.rates)
+            {
+                const double budget = 1e9 / rate * options.arrangeFraction;
+                const frame_stats stats = count_misses(frameTimes, budget);
+                std::printf("%-20s %7d %6g %12.1f %10.1f %10.1f %10.1f %10.1f %9zu %8zu\n", arranger->name, threadCount,
+                    rate, budget / 1e3, mean / 1e3, p99 / 1e3, sorted.back() / 1e3, jitter / 1e3, stats.misses,
+                    stats.worstConsecutive);
+            }
+        }
+    }
+}
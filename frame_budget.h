@@ -0,0 +1,29 @@
+/*
+ * Frame budget simulation: replays the selected sessions as a sequence of frames and checks whether arranging each
+ * frame fits within the share of the frame time given to arrangement.
+ *
+ * A frame is made of one or more consecutive sessions, like the columns a viewport is painted in, which the parallel
+ * configurations arrange concurrently on a job_pool. Every frame is timed separately and judged against the budget of
+ * each refresh rate: the number of frames missing it, the longest run of consecutive misses (what shows as a stutter)
+ * and the jitter, the mean change in arrange time from one frame to the next.
+ */
+
+#pragma once
+
+#include "arrangers.h"
+#include "session_corpus.h"
+
+#include <vector>
+
+struct frame_budget_options
+{
+    std::vector<double> rates{ 60, 144 }; // refresh rates in Hz
+    double arrangeFraction = 0.25;        // share of the frame time arrangement may take
+    size_t frameSessions = 1;             // sessions making up one frame
+    size_t loops = 3;                     // times the sequence is replayed
+};
+
+// Runs the simulation for every arranger and thread count, printing a table of the results
+void frame_budget_run(const frame_budget_options& options, const std::vector<size_t>& sessions,
+    const std::vector<const paint_arranger*>& arrangers, const std::vector<int>& threads, uint8_t rotation,
+    session_reset reset);
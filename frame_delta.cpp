@@ -0,0 +1,443 @@
+#include "frame_delta.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <unordered_map>
+
+static constexpr uint16_t NONE = UINT16_MAX;
+static constexpr uint8_t KEY_FRAME = 1;
+static constexpr size_t NEXT_FIELD = 7;
+static constexpr size_t TAGS_FIELD = 8;
+
+#pragma pack(push, 1)
+struct delta_header
+{
+    uint8_t flags;
+    uint8_t zoom;
+    uint16_t removed;
+    uint16_t added;
+    uint16_t changed;
+    uint16_t heads;
+};
+#pragma pack(pop)
+
+template<typename T> static void append(std::vector<uint8_t>& out, const T& value)
+{
+    const uint8_t* bytes = (const uint8_t*)&value;
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Fields of an entry of a session as stored in the corpus, with the next link left as the entry index
+static void entry_fields(const paint_struct& ps, uint16_t* fields)
+{
+    fields[0] = ps.bounds.x;
+    fields[1] = ps.bounds.y;
+    fields[2] = ps.bounds.z;
+    fields[3] = ps.bounds.x_end;
+    fields[4] = ps.bounds.y_end;
+    fields[5] = ps.bounds.z_end;
+    fields[6] = ps.quadrant_index;
+    fields[NEXT_FIELD] = NONE;
+    fields[TAGS_FIELD] = (uint16_t)(ps.quadrant_flags | ps.sprite_type << 8);
+}
+
+// Everything but the link, which depends on the slots around it
+static uint64_t contents_hash(const uint16_t* fields)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < FRAME_DELTA_FIELDS; i++)
+    {
+        if (i != NEXT_FIELD)
+        {
+            hash = (hash ^ fields[i]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+static bool same_contents(const uint16_t* a, const uint16_t* b)
+{
+    for (size_t i = 0; i < FRAME_DELTA_FIELDS; i++)
+    {
+        if (i != NEXT_FIELD && a[i] != b[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Structs that may be the same one moved: equal extents and sprite type
+static uint64_t shape_key(const uint16_t* fields)
+{
+    return (uint64_t)(uint16_t)(fields[3] - fields[0]) | (uint64_t)(uint16_t)(fields[4] - fields[1]) << 16
+        | (uint64_t)(uint16_t)(fields[5] - fields[2]) << 32 | (uint64_t)(fields[TAGS_FIELD] >> 8) << 48;
+}
+
+static uint32_t distance(const uint16_t* a, const uint16_t* b)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < 3; i++)
+    {
+        sum += (uint32_t)std::abs((int32_t)(int16_t)a[i] - (int32_t)(int16_t)b[i]);
+    }
+    return sum;
+}
+
+void frame_delta_encoder::encode(const paint_session& session, uint8_t zoom, std::vector<uint8_t>& out, bool keyFrame)
+{
+    const size_t structCount = std::size(session.PaintStructs);
+    const size_t quadrantCount = std::size(session.Quadrants);
+
+    keyFrame |= _heads.empty();
+    if (keyFrame)
+    {
+        _slots.clear();
+        _free.clear();
+        _heads.assign(quadrantCount, NONE);
+    }
+
+    // Reachable entries in list order, as session_encode() finds them
+    std::vector<uint16_t> entries;
+    std::vector<uint16_t> slotOf(structCount, NONE);
+    std::vector<bool> reached(structCount, false);
+    for (size_t quadrant = 0; quadrant < quadrantCount; quadrant++)
+    {
+        const size_t head = (size_t)session.Quadrants[quadrant];
+        if (head == quadrantCount || head >= structCount)
+        {
+            continue;
+        }
+        for (size_t entry = head; entry < structCount && !reached[entry];
+             entry = (size_t)session.PaintStructs[entry].basic.next_quadrant_ps)
+        {
+            reached[entry] = true;
+            entries.push_back((uint16_t)entry);
+        }
+    }
+    std::vector<frame_delta_slot> fields(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        entry_fields(session.PaintStructs[entries[i]].basic, fields[i].fields);
+    }
+
+    // Structs which didn't change keep their slot
+    std::vector<bool> matched(_slots.size(), false);
+    std::unordered_multimap<uint64_t, uint16_t> byContents;
+    for (size_t slot = 0; slot < _slots.size(); slot++)
+    {
+        if (_slots[slot].live)
+        {
+            byContents.emplace(contents_hash(_slots[slot].fields), (uint16_t)slot);
+        }
+    }
+    std::vector<size_t> unmatched;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        auto range = byContents.equal_range(contents_hash(fields[i].fields));
+        auto found = std::find_if(range.first, range.second,
+            [&](const auto& candidate) { return same_contents(_slots[candidate.second].fields, fields[i].fields); });
+        if (found == range.second)
+        {
+            unmatched.push_back(i);
+            continue;
+        }
+        slotOf[entries[i]] = found->second;
+        matched[found->second] = true;
+        byContents.erase(found);
+    }
+
+    // Those that moved take the nearest slot of the same shape left over
+    std::unordered_map<uint64_t, std::vector<uint16_t>> byShape;
+    for (const auto& [hash, slot] : byContents)
+    {
+        byShape[shape_key(_slots[slot].fields)].push_back(slot);
+    }
+    std::vector<size_t> added;
+    for (size_t i : unmatched)
+    {
+        auto group = byShape.find(shape_key(fields[i].fields));
+        if (group == byShape.end() || group->second.empty())
+        {
+            added.push_back(i);
+            continue;
+        }
+        std::vector<uint16_t>& candidates = group->second;
+        auto nearest = std::min_element(candidates.begin(), candidates.end(), [&](uint16_t a, uint16_t b) {
+            return distance(_slots[a].fields, fields[i].fields) < distance(_slots[b].fields, fields[i].fields);
+        });
+        slotOf[entries[i]] = *nearest;
+        matched[*nearest] = true;
+        *nearest = candidates.back();
+        candidates.pop_back();
+    }
+
+    std::vector<uint16_t> removed;
+    for (size_t slot = 0; slot < _slots.size(); slot++)
+    {
+        if (_slots[slot].live && !matched[slot])
+        {
+            _slots[slot].live = false;
+            _free.push_back((uint16_t)slot);
+            removed.push_back((uint16_t)slot);
+        }
+    }
+    for (size_t i : added)
+    {
+        uint16_t slot;
+        if (_free.empty())
+        {
+            slot = (uint16_t)_slots.size();
+            _slots.push_back({});
+        }
+        else
+        {
+            slot = _free.back();
+            _free.pop_back();
+        }
+        slotOf[entries[i]] = slot;
+    }
+
+    // Links go by slot, so they are only known once every struct has one
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const size_t next = (size_t)session.PaintStructs[entries[i]].basic.next_quadrant_ps;
+        fields[i].fields[NEXT_FIELD] = next < structCount ? slotOf[next] : NONE;
+    }
+
+    std::vector<uint8_t> addedBytes;
+    std::vector<uint8_t> changedBytes;
+    size_t changed = 0;
+    for (size_t i : added)
+    {
+        const uint16_t slot = slotOf[entries[i]];
+        append(addedBytes, slot);
+        for (uint16_t field : fields[i].fields)
+        {
+            append(addedBytes, field);
+        }
+        std::copy(std::begin(fields[i].fields), std::end(fields[i].fields), _slots[slot].fields);
+        _slots[slot].live = true;
+    }
+    // Slots added above compare equal, leaving those which kept their struct
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        frame_delta_slot& slot = _slots[slotOf[entries[i]]];
+        uint16_t mask = 0;
+        for (size_t field = 0; field < FRAME_DELTA_FIELDS; field++)
+        {
+            mask |= (uint16_t)((slot.fields[field] != fields[i].fields[field]) << field);
+        }
+        if (mask == 0)
+        {
+            continue;
+        }
+        append(changedBytes, slotOf[entries[i]]);
+        append(changedBytes, mask);
+        for (size_t field = 0; field < FRAME_DELTA_FIELDS; field++)
+        {
+            if (mask & (1 << field))
+            {
+                append(changedBytes, fields[i].fields[field]);
+                slot.fields[field] = fields[i].fields[field];
+            }
+        }
+        changed++;
+    }
+
+    std::vector<uint8_t> headBytes;
+    size_t heads = 0;
+    for (size_t quadrant = 0; quadrant < quadrantCount; quadrant++)
+    {
+        const size_t head = (size_t)session.Quadrants[quadrant];
+        const uint16_t slot = head < structCount && head != quadrantCount ? slotOf[head] : NONE;
+        if (slot != _heads[quadrant])
+        {
+            append(headBytes, (uint16_t)quadrant);
+            append(headBytes, slot);
+            _heads[quadrant] = slot;
+            heads++;
+        }
+    }
+
+    append(out,
+        delta_header{ (uint8_t)(keyFrame ? KEY_FRAME : 0), zoom, (uint16_t)removed.size(), (uint16_t)added.size(),
+            (uint16_t)changed, (uint16_t)heads });
+    for (uint16_t slot : removed)
+    {
+        append(out, slot);
+    }
+    out.insert(out.end(), addedBytes.begin(), addedBytes.end());
+    out.insert(out.end(), changedBytes.begin(), changedBytes.end());
+    out.insert(out.end(), headBytes.begin(), headBytes.end());
+}
+
+namespace
+{
+    // Bounds checked reads from an encoded frame
+    class delta_reader
+    {
+    public:
+        delta_reader(const uint8_t* data, size_t size)
+            : _pos(data)
+            , _end(data + size)
+        {
+        }
+
+        template<typename T> bool take(T& value)
+        {
+            if ((size_t)(_end - _pos) < sizeof(T))
+            {
+                return false;
+            }
+            std::memcpy(&value, _pos, sizeof(T));
+            _pos += sizeof(T);
+            return true;
+        }
+
+        bool done() const
+        {
+            return _pos == _end;
+        }
+
+    private:
+        const uint8_t* _pos;
+        const uint8_t* _end;
+    };
+} // namespace
+
+bool frame_delta_decoder::decode(const uint8_t* data, size_t size)
+{
+    const size_t structCount = std::extent_v<decltype(paint_session::PaintStructs)>;
+    const size_t quadrantCount = std::extent_v<decltype(paint_session::Quadrants)>;
+
+    delta_reader reader(data, size);
+    delta_header header;
+    if (!reader.take(header) || (!(header.flags & KEY_FRAME) && !_started))
+    {
+        return false;
+    }
+    // Whatever happens below, the slots only make sense again from the next key frame
+    _started = false;
+    if (header.flags & KEY_FRAME)
+    {
+        _slots.clear();
+        _heads.assign(quadrantCount, NONE);
+    }
+
+    for (size_t i = 0; i < header.removed; i++)
+    {
+        uint16_t slot;
+        if (!reader.take(slot) || slot >= _slots.size() || !_slots[slot].live)
+        {
+            return false;
+        }
+        _slots[slot].live = false;
+    }
+    for (size_t i = 0; i < header.added; i++)
+    {
+        uint16_t slot;
+        if (!reader.take(slot) || slot >= structCount)
+        {
+            return false;
+        }
+        if (slot >= _slots.size())
+        {
+            _slots.resize(slot + 1, frame_delta_slot{});
+        }
+        frame_delta_slot& added = _slots[slot];
+        if (added.live)
+        {
+            return false;
+        }
+        for (uint16_t& field : added.fields)
+        {
+            if (!reader.take(field))
+            {
+                return false;
+            }
+        }
+        added.live = true;
+    }
+    for (size_t i = 0; i < header.changed; i++)
+    {
+        uint16_t slot;
+        uint16_t mask;
+        if (!reader.take(slot) || !reader.take(mask) || slot >= _slots.size() || !_slots[slot].live
+            || mask >> FRAME_DELTA_FIELDS != 0)
+        {
+            return false;
+        }
+        for (size_t field = 0; field < FRAME_DELTA_FIELDS; field++)
+        {
+            if ((mask & (1 << field)) && !reader.take(_slots[slot].fields[field]))
+            {
+                return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < header.heads; i++)
+    {
+        uint16_t quadrant;
+        uint16_t slot;
+        if (!reader.take(quadrant) || !reader.take(slot) || quadrant >= quadrantCount)
+        {
+            return false;
+        }
+        _heads[quadrant] = slot;
+    }
+    if (!reader.done())
+    {
+        return false;
+    }
+
+    // Every list has to end, on live slots, without joining another
+    std::vector<bool> reached(_slots.size(), false);
+    for (uint16_t head : _heads)
+    {
+        for (uint16_t slot = head; slot != NONE; slot = _slots[slot].fields[NEXT_FIELD])
+        {
+            if (slot >= _slots.size() || !_slots[slot].live || reached[slot])
+            {
+                return false;
+            }
+            reached[slot] = true;
+        }
+    }
+    _zoom = header.zoom;
+    _started = true;
+    return true;
+}
+
+void frame_delta_decoder::get(paint_session& session) const
+{
+    std::fill(std::begin(session.Quadrants), std::end(session.Quadrants), nullptr);
+    session.QuadrantBackIndex = UINT32_MAX;
+    session.QuadrantFrontIndex = 0;
+    for (size_t quadrant = 0; quadrant < _heads.size(); quadrant++)
+    {
+        if (_heads[quadrant] == NONE)
+        {
+            continue;
+        }
+        session.Quadrants[quadrant] = &session.PaintStructs[_heads[quadrant]].basic;
+        session.QuadrantBackIndex = std::min<uint32_t>(session.QuadrantBackIndex, quadrant);
+        session.QuadrantFrontIndex = std::max<uint32_t>(session.QuadrantFrontIndex, quadrant);
+        for (uint16_t slot = _heads[quadrant]; slot != NONE; slot = _slots[slot].fields[NEXT_FIELD])
+        {
+            const uint16_t* fields = _slots[slot].fields;
+            paint_struct& ps = session.PaintStructs[slot].basic;
+            ps = {};
+            ps.bounds = { fields[0], fields[1], fields[2], fields[3], fields[4], fields[5] };
+            ps.quadrant_index = fields[6];
+            ps.quadrant_flags = (uint8_t)fields[TAGS_FIELD];
+            ps.sprite_type = (uint8_t)(fields[TAGS_FIELD] >> 8);
+            ps.next_quadrant_ps = fields[NEXT_FIELD] == NONE ? nullptr : &session.PaintStructs[fields[NEXT_FIELD]].basic;
+        }
+    }
+    session.PaintHead = {};
+    session.CurrentRotation = 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Temporal delta encoding of consecutive frames, for recordings of minutes of gameplay where most structs stay put
+ * from one frame to the next.
+ *
+ * Structs are kept in slots which persist across frames. The encoder matches each struct of a new frame to a slot of
+ * the previous one, first by identical contents and then, for structs that moved, to the nearest unmatched struct of
+ * the same size and sprite type. A frame is then encoded as the slots removed, the slots added with their contents,
+ * the fields of the remaining slots which changed (bounds when moving, the link to the next struct when the lists
+ * change around it) and the quadrant heads which changed:
+ *
+ *     uint8_t  flags, zoom
+ *     uint16_t removed, added, changed, heads
+ *     removed x uint16_t slot
+ *     added   x { uint16_t slot; uint16_t fields[9] }
+ *     changed x { uint16_t slot, mask; uint16_t fields[popcount(mask)] }
+ *     heads   x { uint16_t quadrant, slot }
+ *
+ * where the fields are x, y, z, x_end, y_end, z_end, quadrant_index, the next slot (UINT16_MAX at the end of a list)
+ * and quadrant_flags | sprite_type << 8, and a head slot of UINT16_MAX is an empty quadrant. A key frame starts from
+ * no slots at all. Fields are in host byte order.
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+static constexpr size_t FRAME_DELTA_FIELDS = 9;
+
+struct frame_delta_slot
+{
+    uint16_t fields[FRAME_DELTA_FIELDS];
+    bool live;
+};
+
+class frame_delta_encoder
+{
+public:
+    // Appends the encoding of a session as stored in the corpus, with its pointers still encoded as indices, against
+    // the previous frame, or as a key frame when asked to or when it is the first
+    void encode(const paint_session& session, uint8_t zoom, std::vector<uint8_t>& out, bool keyFrame = false);
+
+private:
+    std::vector<frame_delta_slot> _slots;
+    std::vector<uint16_t> _heads; // slot per quadrant
+    std::vector<uint16_t> _free;  // unused slots below _slots.size()
+};
+
+class frame_delta_decoder
+{
+public:
+    // Applies the encoding of the next frame. Returns false on malformed input, or a delta with no frame before it.
+    bool decode(const uint8_t* data, size_t size);
+
+    // Writes the current frame into a session with its pointers fixed up and quadrant range set, ready to be arranged.
+    // Only the structs of the frame are written.
+    void get(paint_session& session) const;
+
+    uint8_t zoom() const
+    {
+        return _zoom;
+    }
+
+private:
+    std::vector<frame_delta_slot> _slots;
+    std::vector<uint16_t> _heads;
+    uint8_t _zoom = 0;
+    bool _started = false;
+};
@@ -0,0 +1,117 @@
+#include "frame_pipeline.h"
+
+#include "paint_draw.h"
+#include "session_corpus.h"
+
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <thread>
+
+using pipeline_clock = std::chrono::steady_clock;
+
+// Holds at most one value on its way from a single producer to a single consumer
+class single_slot
+{
+public:
+    static constexpr int EMPTY = -1;
+
+    void put(int value)
+    {
+        while (_slot.load(std::memory_order_acquire) != EMPTY)
+        {
+            std::this_thread::yield();
+        }
+        _slot.store(value, std::memory_order_release);
+    }
+
+    int take()
+    {
+        int value;
+        while ((value = _slot.exchange(EMPTY, std::memory_order_acq_rel)) == EMPTY)
+        {
+            std::this_thread::yield();
+        }
+        return value;
+    }
+
+private:
+    std::atomic<int> _slot{ EMPTY };
+};
+
+// What the game does to get a frame's session: fill it in, then arrange it
+static void prepare_frame(paint_session& session, size_t index, const paint_arranger& arranger, uint8_t rotation)
+{
+    session_corpus_copy(&session, index, 1);
+    fixup_pointers(&session, 1, std::size(session.PaintStructs), std::size(session.Quadrants));
+    session.CurrentRotation = rotation;
+    arranger.arrange(&session);
+}
+
+static uint64_t draw_frame(const paint_session& session, paint_framebuffer& framebuffer)
+{
+    paint_framebuffer_fit(framebuffer, session);
+    return paint_session_draw(session, framebuffer);
+}
+
+static double elapsed_ns(pipeline_clock::time_point start, pipeline_clock::time_point end)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+void frame_pipeline_sequential(
+    const std::vector<size_t>& frames, const paint_arranger& arranger, uint8_t rotation, frame_pipeline_result& result)
+{
+    auto session = std::make_unique<paint_session>();
+    paint_framebuffer framebuffer;
+    result.latencies.assign(frames.size(), 0);
+    result.pixels = 0;
+
+    const auto start = pipeline_clock::now();
+    for (size_t frame = 0; frame < frames.size(); frame++)
+    {
+        const auto frameStart = pipeline_clock::now();
+        prepare_frame(*session, frames[frame], arranger, rotation);
+        result.pixels += draw_frame(*session, framebuffer);
+        result.latencies[frame] = elapsed_ns(frameStart, pipeline_clock::now());
+    }
+    result.seconds = elapsed_ns(start, pipeline_clock::now()) / 1e9;
+}
+
+void frame_pipeline_double_buffered(
+    const std::vector<size_t>& frames, const paint_arranger& arranger, uint8_t rotation, frame_pipeline_result& result)
+{
+    std::unique_ptr<paint_session> buffers[2] = { std::make_unique<paint_session>(), std::make_unique<paint_session>() };
+    std::vector<pipeline_clock::time_point> starts(frames.size());
+    single_slot arranged;
+    std::atomic<size_t> drawn{ 0 };
+    result.latencies.assign(frames.size(), 0);
+    result.pixels = 0;
+
+    const auto start = pipeline_clock::now();
+    std::thread arranging([&] {
+        for (size_t frame = 0; frame < frames.size(); frame++)
+        {
+            // The buffer last held frame - 2, which has to be drawn before it can be reused
+            while (frame >= 2 && drawn.load(std::memory_order_acquire) < frame - 1)
+            {
+                std::this_thread::yield();
+            }
+            starts[frame] = pipeline_clock::now();
+            prepare_frame(*buffers[frame % 2], frames[frame], arranger, rotation);
+            arranged.put((int)(frame % 2));
+        }
+    });
+
+    paint_framebuffer framebuffer;
+    for (size_t frame = 0; frame < frames.size(); frame++)
+    {
+        const int buffer = arranged.take();
+        result.pixels += draw_frame(*buffers[buffer], framebuffer);
+        result.latencies[frame] = elapsed_ns(starts[frame], pipeline_clock::now());
+        drawn.store(frame + 1, std::memory_order_release);
+    }
+    arranging.join();
+    result.seconds = elapsed_ns(start, pipeline_clock::now()) / 1e9;
+}
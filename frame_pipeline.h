@@ -0,0 +1,27 @@
+/*
+ * Runs a sequence of frames through arrangement and drawing, either one after the other as the game does, or as a
+ * two stage pipeline: one thread prepares and arranges frame N in one of two paint_session buffers while another
+ * draws frame N - 1 from the other. Arranged buffers are handed to the drawing thread through a lock-free single slot.
+ *
+ * The pipeline raises throughput at the cost of latency, measured per frame from the start of its arrangement to the
+ * end of its drawing.
+ */
+
+#pragma once
+
+#include "arrangers.h"
+
+#include <vector>
+
+struct frame_pipeline_result
+{
+    double seconds = 0;
+    std::vector<double> latencies; // nanoseconds, per frame
+    uint64_t pixels = 0;
+};
+
+// Each frame is a session of the corpus
+void frame_pipeline_sequential(
+    const std::vector<size_t>& frames, const paint_arranger& arranger, uint8_t rotation, frame_pipeline_result& result);
+void frame_pipeline_double_buffered(
+    const std::vector<size_t>& frames, const paint_arranger& arranger, uint8_t rotation, frame_pipeline_result& result);
@@ -0,0 +1,136 @@
+#include "frame_recording.h"
+
+#include "paint_draw.h"
+
+#include <cstring>
+
+static constexpr char MAGIC[8] = { 'P', 'S', 'F', 'R', 'A', 'M', 'E', 'S' };
+static constexpr uint32_t VERSION = 1;
+
+#pragma pack(push, 1)
+struct file_header
+{
+    char magic[8];
+    uint32_t version;
+    frame_encoding encoding;
+};
+
+struct frame_header
+{
+    uint64_t timestamp;
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    uint8_t zoom;
+    uint8_t rotation;
+    uint16_t reserved;
+    uint32_t size;
+};
+#pragma pack(pop)
+
+frame_recorder::~frame_recorder()
+{
+    close();
+}
+
+bool frame_recorder::open(const char* path, frame_encoding encoding)
+{
+    close();
+    _file = std::fopen(path, "wb");
+    if (_file == nullptr)
+    {
+        std::fprintf(stderr, "Failed to create %s\n", path);
+        return false;
+    }
+    file_header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.encoding = encoding;
+    _frames = 0;
+    _failed = std::fwrite(&header, sizeof(header), 1, _file) != 1;
+    return !_failed;
+}
+
+bool frame_recorder::write(uint64_t timestamp, const recorded_viewport& viewport, const uint8_t* session, size_t size)
+{
+    if (_file == nullptr || _failed)
+    {
+        return false;
+    }
+    const frame_header header{ timestamp, viewport.x, viewport.y, viewport.width, viewport.height, viewport.zoom,
+        viewport.rotation, 0, (uint32_t)size };
+    _failed = std::fwrite(&header, sizeof(header), 1, _file) != 1 || std::fwrite(session, 1, size, _file) != size;
+    _frames++;
+    return !_failed;
+}
+
+bool frame_recorder::close()
+{
+    if (_file == nullptr)
+    {
+        return !_failed;
+    }
+    _failed |= std::fclose(_file) != 0;
+    _file = nullptr;
+    return !_failed;
+}
+
+bool frame_recording_load(const char* path, std::vector<recorded_frame>& frames, frame_encoding& encoding)
+{
+    std::FILE* file = std::fopen(path, "rb");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+    file_header header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+        && header.version == VERSION && header.encoding <= frame_encoding::delta;
+    if (!ok)
+    {
+        std::fprintf(stderr, "%s is not a frame recording\n", path);
+    }
+    encoding = header.encoding;
+    frame_header frameHeader;
+    while (ok)
+    {
+        const size_t headerBytes = std::fread(&frameHeader, 1, sizeof(frameHeader), file);
+        if (headerBytes == 0 && std::feof(file))
+        {
+            break;
+        }
+        if (headerBytes != sizeof(frameHeader))
+        {
+            std::fprintf(stderr, "%s is truncated after frame %zu\n", path, frames.size());
+            ok = false;
+            break;
+        }
+        recorded_frame frame;
+        frame.timestamp = frameHeader.timestamp;
+        frame.viewport = { frameHeader.x, frameHeader.y, frameHeader.width, frameHeader.height, frameHeader.zoom,
+            frameHeader.rotation };
+        frame.session.resize(frameHeader.size);
+        if (std::fread(frame.session.data(), 1, frame.session.size(), file) != frame.session.size())
+        {
+            std::fprintf(stderr, "%s is truncated in frame %zu\n", path, frames.size());
+            ok = false;
+            break;
+        }
+        if (!frames.empty() && frame.timestamp < frames.back().timestamp)
+        {
+            std::fprintf(stderr, "%s goes back in time at frame %zu\n", path, frames.size());
+            ok = false;
+            break;
+        }
+        frames.push_back(std::move(frame));
+    }
+    std::fclose(file);
+    return ok;
+}
+
+recorded_viewport recorded_viewport_of(const paint_session& session, uint8_t zoom, uint8_t rotation)
+{
+    const screen_rect area = paint_session_screen_rect(session);
+    return { area.left, area.top, area.right - area.left, area.bottom - area.top, zoom, rotation };
+}
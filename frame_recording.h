@@ -0,0 +1,77 @@
+/*
+ * Recordings of gameplay as a sequence of frames, each a session with the time it was produced and the viewport it
+ * was painted for, so replays can keep the cadence of the game with its idle gaps and bursts.
+ *
+ * A recording is a file of
+ *
+ *     char     magic[8] = "PSFRAMES"
+ *     uint32_t version, encoding
+ *     frames x { uint64_t timestamp; int32_t x, y, width, height; uint8_t zoom, rotation; uint16_t reserved;
+ *                uint32_t size; uint8_t session[size] }
+ *
+ * where the timestamp is in nanoseconds since the start of the recording and the viewport is the screen area of the
+ * frame. Depending on the encoding, each session is either in the binary form of session_codec.h or a delta against
+ * the frame before it as encoded by frame_delta.h. Fields are in host byte order.
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+enum class frame_encoding : uint32_t
+{
+    session, // session_codec.h
+    delta,   // frame_delta.h
+};
+
+struct recorded_viewport
+{
+    int32_t x = 0; // screen position of the top left pixel
+    int32_t y = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    uint8_t zoom = 0;
+    uint8_t rotation = 0;
+};
+
+struct recorded_frame
+{
+    uint64_t timestamp = 0; // nanoseconds since the start of the recording
+    recorded_viewport viewport;
+    std::vector<uint8_t> session; // in the recording's encoding
+};
+
+class frame_recorder
+{
+public:
+    frame_recorder() = default;
+    frame_recorder(const frame_recorder&) = delete;
+    frame_recorder& operator=(const frame_recorder&) = delete;
+    ~frame_recorder();
+
+    // Creates the file, replacing an existing one
+    bool open(const char* path, frame_encoding encoding = frame_encoding::session);
+    bool write(uint64_t timestamp, const recorded_viewport& viewport, const uint8_t* session, size_t size);
+    // Returns false if anything written since open() didn't make it to the file
+    bool close();
+
+    size_t frames() const
+    {
+        return _frames;
+    }
+
+private:
+    std::FILE* _file = nullptr;
+    size_t _frames = 0;
+    bool _failed = false;
+};
+
+bool frame_recording_load(const char* path, std::vector<recorded_frame>& frames, frame_encoding& encoding);
+
+// Screen area covered by everything a session (with its pointers fixed up) can draw
+recorded_viewport recorded_viewport_of(const paint_session& session, uint8_t zoom, uint8_t rotation);
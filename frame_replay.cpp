@@ -0,0 +1,183 @@
+#include "frame_replay.h"
+
+#include "frame_delta.h"
+#include "frame_recording.h"
+#include "session_codec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+static const char* pace_name(replay_pace pace)
+{
+    return pace == replay_pace::fast ? "fast" : "recorded";
+}
+
+static double percentile(std::vector<double> values, double fraction)
+{
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)std::ceil(values.size() * fraction) - 1)];
+}
+
+// Decodes the next frame of a pass over the recording, deltas apply to the frame the decoder holds
+static bool decode_frame(
+    const recorded_frame& frame, frame_encoding encoding, frame_delta_decoder& decoder, paint_session& session)
+{
+    if (encoding == frame_encoding::session)
+    {
+        uint8_t zoom;
+        return session_decode(frame.session.data(), frame.session.size(), session, zoom);
+    }
+    if (!decoder.decode(frame.session.data(), frame.session.size()))
+    {
+        return false;
+    }
+    decoder.get(session);
+    return true;
+}
+
+// Sleeps until shortly before the deadline and spins for the rest, so that oversleeping past it, often tens of
+// microseconds, doesn't count as latency of the frame released then
+static void wait_until(std::chrono::steady_clock::time_point deadline)
+{
+    const auto slack = std::chrono::microseconds(500);
+    if (std::chrono::steady_clock::now() < deadline - slack)
+    {
+        std::this_thread::sleep_until(deadline - slack);
+    }
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+}
+
+static void print_cadence(const char* path, const std::vector<recorded_frame>& frames)
+{
+    const double span = (frames.back().timestamp - frames.front().timestamp) / 1e9;
+    std::vector<double> intervals;
+    int32_t width = 0;
+    int32_t height = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        if (i > 0)
+        {
+            intervals.push_back((frames[i].timestamp - frames[i - 1].timestamp) / 1e9);
+        }
+        width = std::max(width, frames[i].viewport.width);
+        height = std::max(height, frames[i].viewport.height);
+        bytes += frames[i].session.size();
+    }
+    std::printf("%s: %zu frames over %.3f s, %.0f bytes per frame (%.0f:1 against full sessions), viewports up to "
+                "%dx%d\n",
+        path, frames.size(), span, (double)bytes / frames.size(), (double)sizeof(paint_session) * frames.size() / bytes,
+        width, height);
+    if (intervals.empty())
+    {
+        return;
+    }
+    // Bursts are frames coming in well ahead of the usual interval
+    const double median = percentile(intervals, 0.5);
+    const size_t bursts
+        = std::count_if(intervals.begin(), intervals.end(), [&](double interval) { return interval < median / 4; });
+    std::printf("Frame interval median %.2f ms, p99 %.2f ms, largest gap %.2f ms, %zu frames in bursts\n",
+        median * 1e3, percentile(intervals, 0.99) * 1e3, *std::max_element(intervals.begin(), intervals.end()) * 1e3,
+        bursts);
+}
+
+bool frame_replay_run(
+    const char* path, const std::vector<const paint_arranger*>& arrangers, const std::vector<replay_pace>& paces)
+{
+    using clock = std::chrono::steady_clock;
+    std::vector<recorded_frame> frames;
+    frame_encoding encoding;
+    if (!frame_recording_load(path, frames, encoding))
+    {
+        return false;
+    }
+    if (frames.empty())
+    {
+        std::printf("%s holds no frames\n", path);
+        return true;
+    }
+    print_cadence(path, frames);
+
+    auto session = std::make_unique<paint_session>();
+    frame_delta_decoder decoder;
+    const auto decodeStart = clock::now();
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        if (!decode_frame(frames[i], encoding, decoder, *session))
+        {
+            std::fprintf(stderr, "Malformed session in frame %zu of %s\n", i, path);
+            return false;
+        }
+    }
+    const double decoding = std::chrono::duration<double>(clock::now() - decodeStart).count();
+    const double span = (frames.back().timestamp - frames.front().timestamp) / 1e9;
+    std::printf("Decoded %s frames at %.0f frames/s", encoding == frame_encoding::delta ? "delta" : "session",
+        frames.size() / decoding);
+    if (span > 0)
+    {
+        std::printf(", %.0fx the recorded rate", span / decoding);
+    }
+    std::printf("\n\n");
+
+    std::printf("%-16s %-9s %10s %10s %10s %10s %10s %8s %7s\n", "arranger", "pace", "seconds", "frames/s", "mean us",
+        "p99 us", "max us", "late", "busy %");
+    for (const paint_arranger* arranger : arrangers)
+    {
+        for (replay_pace pace : paces)
+        {
+            std::vector<double> latencies;
+            latencies.reserve(frames.size());
+            size_t late = 0; // not done by the time the next frame was due
+            double busy = 0;
+            const auto start = clock::now();
+            for (size_t i = 0; i < frames.size(); i++)
+            {
+                const recorded_frame& frame = frames[i];
+                if (!decode_frame(frame, encoding, decoder, *session))
+                {
+                    std::fprintf(stderr, "Malformed session in frame %zu of %s\n", i, path);
+                    return false;
+                }
+                session->CurrentRotation = frame.viewport.rotation;
+
+                auto release = clock::now();
+                if (pace == replay_pace::recorded)
+                {
+                    release = start
+                        + std::chrono::duration_cast<clock::duration>(
+                            std::chrono::nanoseconds(frame.timestamp - frames.front().timestamp));
+                    wait_until(release);
+                }
+                const auto arrangeStart = clock::now();
+                arranger->arrange(session.get());
+                const auto done = clock::now();
+
+                busy += std::chrono::duration<double>(done - arrangeStart).count();
+                const double latency = std::chrono::duration<double>(done - release).count();
+                latencies.push_back(latency);
+                if (i + 1 < frames.size() && latency > (frames[i + 1].timestamp - frame.timestamp) / 1e9)
+                {
+                    late++;
+                }
+            }
+            const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+            double total = 0;
+            for (double latency : latencies)
+            {
+                total += latency;
+            }
+            std::printf("%-16s %-9s %10.3f %10.0f %10.1f %10.1f %10.1f %8zu %7.1f\n", arranger->name, pace_name(pace),
+                elapsed, frames.size() / elapsed, total / frames.size() * 1e6, percentile(latencies, 0.99) * 1e6,
+                *std::max_element(latencies.begin(), latencies.end()) * 1e6, late, busy / elapsed * 100);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+/*
+ * Replay of a frame recording (see frame_recording.h) through the arrangers.
+ *
+ * At the recorded pace each frame is released at its recorded time, so a frame arriving while the previous one is
+ * still being arranged waits for it, as it would in the game; at the fast pace each frame is released as soon as the
+ * previous one is done, which measures throughput. Latency runs from a frame's release until its arrangement is done.
+ * Each session is decoded once the previous frame is done, which only adds to the latency when it runs past the
+ * frame's release. The replay sleeps for most of the wait for a release and spins for the end of it, so that its own
+ * wake-up doesn't add to the latency. Frames are arranged at their recorded rotation.
+ */
+
+#pragma once
+
+#include "arrangers.h"
+
+#include <vector>
+
+enum class replay_pace
+{
+    fast,
+    recorded,
+};
+
+// Prints a summary of the recording's cadence and the replay of each arranger at each pace. Returns false if the
+// recording can't be loaded or holds a malformed session.
+bool frame_replay_run(
+    const char* path, const std::vector<const paint_arranger*>& arrangers, const std::vector<replay_pace>& paces);
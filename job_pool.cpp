@@ -0,0 +1,78 @@
+#include "job_pool.h"
+
+job_pool::job_pool(size_t threads)
+{
+    for (size_t i = 1; i < threads; i++)
+    {
+        _workers.emplace_back(&job_pool::work, this);
+    }
+}
+
+job_pool::~job_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _ready.notify_all();
+    for (auto& worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+void job_pool::run(size_t count, const std::function<void(size_t)>& job)
+{
+    if (_workers.empty())
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            job(i);
+        }
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _job = &job;
+    _count = count;
+    _next = 0;
+    _batch++;
+    _ready.notify_all();
+    run_jobs(lock);
+    _finished.wait(lock, [this] { return _next == _count && _running == 0; });
+    _job = nullptr;
+}
+
+// Takes jobs off the current batch until none are left, with the lock held in between
+void job_pool::run_jobs(std::unique_lock<std::mutex>& lock)
+{
+    while (_next < _count)
+    {
+        const size_t index = _next++;
+        _running++;
+        lock.unlock();
+        (*_job)(index);
+        lock.lock();
+        _running--;
+    }
+    if (_running == 0)
+    {
+        _finished.notify_all();
+    }
+}
+
+void job_pool::work()
+{
+    size_t seenBatch = 0;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _ready.wait(lock, [&] { return _stopping || _batch != seenBatch; });
+        if (_stopping)
+        {
+            return;
+        }
+        seenBatch = _batch;
+        run_jobs(lock);
+    }
+}
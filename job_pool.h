@@ -0,0 +1,46 @@
+/*
+ * Fixed set of worker threads running batches of independent jobs, in the spirit of OpenRCT2's JobPool which paints
+ * the columns of a viewport concurrently.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class job_pool
+{
+public:
+    // The calling thread takes part in every batch, so a pool of one thread starts no workers
+    explicit job_pool(size_t threads);
+    ~job_pool();
+    job_pool(const job_pool&) = delete;
+    job_pool& operator=(const job_pool&) = delete;
+
+    size_t threads() const
+    {
+        return _workers.size() + 1;
+    }
+
+    // Calls job(i) for every i in [0, count) and returns once all calls have finished
+    void run(size_t count, const std::function<void(size_t)>& job);
+
+private:
+    void work();
+    void run_jobs(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::condition_variable _finished;
+    const std::function<void(size_t)>* _job = nullptr;
+    size_t _count = 0;
+    size_t _next = 0;
+    size_t _running = 0;
+    size_t _batch = 0;
+    bool _stopping = false;
+};
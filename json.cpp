@@ -0,0 +1,270 @@
+#include "json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+class json_parser
+{
+public:
+    explicit json_parser(const std::string& text)
+        : _text(text)
+    {
+    }
+
+    bool parse(json_value& value, std::string& error)
+    {
+        if (!parse_value(value, 0))
+        {
+            error = _error + " at offset " + std::to_string(_pos);
+            return false;
+        }
+        skip_whitespace();
+        if (_pos != _text.size())
+        {
+            error = "trailing characters at offset " + std::to_string(_pos);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr int MAX_DEPTH = 64;
+
+    const std::string& _text;
+    size_t _pos = 0;
+    std::string _error;
+
+    bool fail(const char* message)
+    {
+        _error = message;
+        return false;
+    }
+
+    void skip_whitespace()
+    {
+        while (_pos < _text.size() && std::strchr(" \t\r\n", _text[_pos]) != nullptr)
+        {
+            _pos++;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skip_whitespace();
+        if (_pos < _text.size() && _text[_pos] == c)
+        {
+            _pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool consume_literal(const char* literal)
+    {
+        const size_t length = std::strlen(literal);
+        if (_text.compare(_pos, length, literal) == 0)
+        {
+            _pos += length;
+            return true;
+        }
+        return false;
+    }
+
+    bool parse_string(std::string& out)
+    {
+        if (!consume('"'))
+        {
+            return fail("expected string");
+        }
+        out.clear();
+        while (_pos < _text.size() && _text[_pos] != '"')
+        {
+            char c = _text[_pos++];
+            if (c == '\\')
+            {
+                if (_pos >= _text.size())
+                {
+                    break;
+                }
+                c = _text[_pos++];
+                switch (c)
+                {
+                    case 'n':
+                        c = '\n';
+                        break;
+                    case 't':
+                        c = '\t';
+                        break;
+                    case 'r':
+                        c = '\r';
+                        break;
+                    case 'b':
+                        c = '\b';
+                        break;
+                    case 'f':
+                        c = '\f';
+                        break;
+                    case 'u':
+                    {
+                        // Only the ASCII range is produced by our writers
+                        if (_pos + 4 > _text.size())
+                        {
+                            return fail("truncated escape");
+                        }
+                        c = (char)std::strtoul(_text.substr(_pos, 4).c_str(), nullptr, 16);
+                        _pos += 4;
+                        break;
+                    }
+                }
+            }
+            out += c;
+        }
+        if (_pos >= _text.size())
+        {
+            return fail("unterminated string");
+        }
+        _pos++;
+        return true;
+    }
+
+    bool parse_value(json_value& value, int depth)
+    {
+        if (depth > MAX_DEPTH)
+        {
+            return fail("nested too deeply");
+        }
+        skip_whitespace();
+        if (_pos >= _text.size())
+        {
+            return fail("unexpected end of input");
+        }
+        const char c = _text[_pos];
+        if (c == '{')
+        {
+            _pos++;
+            value._kind = json_value::kind::object;
+            if (consume('}'))
+            {
+                return true;
+            }
+            do
+            {
+                std::string key;
+                if (!parse_string(key))
+                {
+                    return false;
+                }
+                if (!consume(':'))
+                {
+                    return fail("expected ':'");
+                }
+                if (!parse_value(value._object[key], depth + 1))
+                {
+                    return false;
+                }
+            } while (consume(','));
+            return consume('}') || fail("expected '}'");
+        }
+        if (c == '[')
+        {
+            _pos++;
+            value._kind = json_value::kind::array;
+            if (consume(']'))
+            {
+                return true;
+            }
+            do
+            {
+                value._array.emplace_back();
+                if (!parse_value(value._array.back(), depth + 1))
+                {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(']') || fail("expected ']'");
+        }
+        if (c == '"')
+        {
+            value._kind = json_value::kind::string;
+            return parse_string(value._string);
+        }
+        if (consume_literal("true"))
+        {
+            value._kind = json_value::kind::boolean;
+            value._number = 1;
+            return true;
+        }
+        if (consume_literal("false"))
+        {
+            value._kind = json_value::kind::boolean;
+            return true;
+        }
+        if (consume_literal("null"))
+        {
+            value._kind = json_value::kind::null;
+            return true;
+        }
+        const char* start = _text.c_str() + _pos;
+        char* end;
+        value._number = std::strtod(start, &end);
+        if (end == start)
+        {
+            return fail("unexpected character");
+        }
+        value._kind = json_value::kind::number;
+        _pos += end - start;
+        return true;
+    }
+};
+
+const json_value* json_value::find(const char* key) const
+{
+    auto it = _object.find(key);
+    return it == _object.end() ? nullptr : &it->second;
+}
+
+bool json_value::parse(const std::string& text, json_value& value, std::string& error)
+{
+    value = json_value();
+    return json_parser(text).parse(value, error);
+}
+
+bool json_value::parse_file(const char* path, json_value& value, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        error = std::string("failed to open ") + path;
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return parse(contents.str(), value, error);
+}
+
+std::string json_quote(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        }
+        else
+        {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
@@ -0,0 +1,66 @@
+/*
+ * Minimal JSON reader, enough for the files the benchmark writes itself (e.g. regression baselines).
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+class json_value
+{
+public:
+    enum class kind
+    {
+        null,
+        boolean,
+        number,
+        string,
+        array,
+        object,
+    };
+
+    kind type() const
+    {
+        return _kind;
+    }
+    bool is_number() const
+    {
+        return _kind == kind::number;
+    }
+    double number() const
+    {
+        return _number;
+    }
+    const std::string& string() const
+    {
+        return _string;
+    }
+    const std::vector<json_value>& array() const
+    {
+        return _array;
+    }
+    const std::map<std::string, json_value>& object() const
+    {
+        return _object;
+    }
+    // Member of an object, nullptr when missing or not an object
+    const json_value* find(const char* key) const;
+
+    // Returns false and describes the problem in error on malformed input
+    static bool parse(const std::string& text, json_value& value, std::string& error);
+    static bool parse_file(const char* path, json_value& value, std::string& error);
+
+private:
+    friend class json_parser;
+
+    kind _kind = kind::null;
+    double _number = 0;
+    std::string _string;
+    std::vector<json_value> _array;
+    std::map<std::string, json_value> _object;
+};
+
+// Escapes a string for embedding in JSON output, including the surrounding quotes
+std::string json_quote(const std::string& text);
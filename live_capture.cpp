@@ -0,0 +1,130 @@
+#include "live_capture.h"
+
+#include "frame_recording.h"
+#include "session_codec.h"
+#include "shm_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+static void print_stage(const std::string& stage, std::vector<double>& times)
+{
+    if (times.empty())
+    {
+        return;
+    }
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for (double time : times)
+    {
+        total += time;
+    }
+    const double p99 = times[std::min(times.size() - 1, (size_t)std::ceil(times.size() * 0.99) - 1)];
+    std::printf("%-28s %10.1f %10.1f %10.1f %12.1f\n", stage.c_str(), total / times.size() * 1e6, p99 * 1e6,
+        times.back() * 1e6, total * 1e3);
+}
+
+bool live_capture_run(const char* ring, double attachTimeout, const std::vector<const paint_arranger*>& arrangers,
+    uint8_t rotation, const char* record)
+{
+    using clock = std::chrono::steady_clock;
+    shm_ring channel;
+    if (!channel.attach(ring, attachTimeout))
+    {
+        return false;
+    }
+    frame_recorder recorder;
+    if (record != nullptr && !recorder.open(record))
+    {
+        return false;
+    }
+
+    auto session = std::make_unique<paint_session>();
+    std::vector<uint8_t> message;
+    std::vector<double> waits;
+    std::vector<double> decodes;
+    std::vector<std::vector<double>> arranges(arrangers.size());
+    size_t bytes = 0;
+    size_t structs = 0;
+    const auto start = clock::now();
+    while (true)
+    {
+        const double blocked = channel.blocked_seconds();
+        if (!channel.read(message))
+        {
+            break;
+        }
+        const auto arrival = clock::now();
+        waits.push_back(channel.blocked_seconds() - blocked);
+        bytes += message.size();
+
+        uint8_t zoom;
+        for (size_t i = 0; i < arrangers.size(); i++)
+        {
+            // Arranging consumes the decoded lists, so every arranger gets its own decode and only the first is timed
+            const auto decodeStart = clock::now();
+            if (!session_decode(message.data(), message.size(), *session, zoom))
+            {
+                std::fprintf(stderr, "Malformed session %zu on %s\n", decodes.size(), ring);
+                return false;
+            }
+            const auto decodeEnd = clock::now();
+            if (i == 0)
+            {
+                decodes.push_back(std::chrono::duration<double>(decodeEnd - decodeStart).count());
+            }
+            if (i == 0 && record != nullptr)
+            {
+                const uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(arrival - start).count();
+                if (!recorder.write(timestamp, recorded_viewport_of(*session, zoom, rotation), message.data(),
+                        message.size()))
+                {
+                    std::fprintf(stderr, "Failed to write %s\n", record);
+                    return false;
+                }
+            }
+            session->CurrentRotation = rotation;
+            const auto arrangeStart = clock::now();
+            arrangers[i]->arrange(session.get());
+            arranges[i].push_back(std::chrono::duration<double>(clock::now() - arrangeStart).count());
+        }
+        std::vector<uint16_t> order;
+        paint_session_get_order(*session, order);
+        structs += order.size();
+    }
+    if (channel.malformed())
+    {
+        return false;
+    }
+    const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    if (record != nullptr && !recorder.close())
+    {
+        std::fprintf(stderr, "Failed to write %s\n", record);
+        return false;
+    }
+
+    const size_t sessions = decodes.size();
+    std::printf("Received %zu sessions (%zu paint structs) on %s in %.3f s: %.0f sessions/s, %.2f MiB/s, %.0f bytes per "
+                "session against %zu in memory\n",
+        sessions, structs, ring, elapsed, sessions / elapsed, bytes / elapsed / (1 << 20),
+        sessions == 0 ? 0.0 : (double)bytes / sessions, sizeof(paint_session));
+    std::printf("Blocked waiting for the producer %.1f%% of the time, arranged at rotation %u\n",
+        elapsed > 0 ? channel.blocked_seconds() / elapsed * 100 : 0.0, rotation);
+    if (record != nullptr)
+    {
+        std::printf("Recorded %zu frames to %s\n", recorder.frames(), record);
+    }
+    std::printf("\n");
+    std::printf("%-28s %10s %10s %10s %12s\n", "stage", "mean us", "p99 us", "max us", "total ms");
+    print_stage("wait", waits);
+    print_stage("decode", decodes);
+    for (size_t i = 0; i < arrangers.size(); i++)
+    {
+        print_stage(std::string("arrange ") + arrangers[i]->name, arranges[i]);
+    }
+    return true;
+}
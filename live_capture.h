@@ -0,0 +1,17 @@
+/*
+ * Arrangement of sessions streamed in by another process over a shm_ring, as the game would produce them, instead of
+ * read from a capture. Sessions arrive in the binary form of session_codec.h, `corpus_tool replay` stands in for the
+ * game by streaming an existing capture at a chosen rate.
+ */
+
+#pragma once
+
+#include "arrangers.h"
+
+#include <vector>
+
+// Consumes sessions until the producer closes the ring, arranging each one with every arranger, and prints where the
+// time went. With record set, the sessions are also written to a frame recording (see frame_recording.h), timestamped
+// as they arrived. Returns false if the ring can't be attached to, a message is malformed or recording fails.
+bool live_capture_run(const char* ring, double attachTimeout, const std::vector<const paint_arranger*>& arrangers,
+    uint8_t rotation, const char* record = nullptr);
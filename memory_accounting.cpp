@@ -0,0 +1,189 @@
+#include "memory_accounting.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#    include <malloc.h>
+#    include <sys/resource.h>
+#    include <unistd.h>
+#endif
+
+static std::atomic<bool> s_enabled{ false };
+static std::atomic<uint64_t> s_allocations{ 0 };
+static std::atomic<uint64_t> s_allocatedBytes{ 0 };
+static std::atomic<int64_t> s_liveBytes{ 0 };
+static std::atomic<int64_t> s_peakBytes{ 0 };
+
+static size_t allocation_size(void* pointer)
+{
+#ifdef __linux__
+    return malloc_usable_size(pointer);
+#else
+    (void)pointer;
+    return 0;
+#endif
+}
+
+static void* counted_allocate(size_t size, size_t alignment)
+{
+    if (size == 0)
+    {
+        size = 1;
+    }
+    void* pointer;
+    while ((pointer = alignment <= alignof(std::max_align_t)
+                   ? std::malloc(size)
+                   : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+        == nullptr)
+    {
+        // As the standard operator new does, the new handler gets to free some memory before giving up
+        const std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+    if (!s_enabled.load(std::memory_order_relaxed))
+    {
+        return pointer;
+    }
+    const int64_t bytes = (int64_t)allocation_size(pointer);
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    s_allocatedBytes.fetch_add((uint64_t)bytes, std::memory_order_relaxed);
+    const int64_t live = s_liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t peak = s_peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !s_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+    return pointer;
+}
+
+static void counted_free(void* pointer)
+{
+    if (pointer != nullptr)
+    {
+        if (s_enabled.load(std::memory_order_relaxed))
+        {
+            s_liveBytes.fetch_sub((int64_t)allocation_size(pointer), std::memory_order_relaxed);
+        }
+        std::free(pointer);
+    }
+}
+
+void* operator new(size_t size)
+{
+    return counted_allocate(size, 0);
+}
+
+void* operator new[](size_t size)
+{
+    return counted_allocate(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return counted_allocate(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return counted_allocate(size, (size_t)alignment);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept
+{
+    counted_free(pointer);
+}
+
+void memory_accounting_enable()
+{
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+memory_snapshot memory_sample()
+{
+    memory_snapshot snapshot{};
+    snapshot.allocations = s_allocations.load(std::memory_order_relaxed);
+    snapshot.allocatedBytes = s_allocatedBytes.load(std::memory_order_relaxed);
+    snapshot.liveBytes = s_liveBytes.load(std::memory_order_relaxed);
+    snapshot.peakBytes = s_peakBytes.load(std::memory_order_relaxed);
+#ifdef __linux__
+    std::FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm != nullptr)
+    {
+        unsigned long size;
+        unsigned long resident;
+        if (std::fscanf(statm, "%lu %lu", &size, &resident) == 2)
+        {
+            snapshot.residentBytes = (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE);
+        }
+        std::fclose(statm);
+    }
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        snapshot.minorFaults = (uint64_t)usage.ru_minflt;
+        snapshot.majorFaults = (uint64_t)usage.ru_majflt;
+    }
+#endif
+    return snapshot;
+}
+
+void memory_reset_peak()
+{
+    s_peakBytes.store(s_liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void heap_memory_manager::Start()
+{
+    memory_reset_peak();
+    _start = memory_sample();
+}
+
+void heap_memory_manager::Stop(Result& result)
+{
+    const memory_snapshot end = memory_sample();
+    result.num_allocs = (int64_t)(end.allocations - _start.allocations);
+    result.max_bytes_used = (int64_t)(end.peakBytes - _start.liveBytes);
+    result.total_allocated_bytes = (int64_t)(end.allocatedBytes - _start.allocatedBytes);
+    result.net_heap_growth = (int64_t)end.liveBytes - (int64_t)_start.liveBytes;
+}
@@ -0,0 +1,44 @@
+/*
+ * Heap and footprint accounting. Linking memory_accounting.cpp replaces the global operator new and delete with
+ * versions counting every allocation once memory_accounting_enable() was called, and passing straight on to malloc
+ * before, so that runs without accounting don't pay for it. The process' resident set size and page faults come from
+ * the system.
+ */
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+
+struct memory_snapshot
+{
+    uint64_t allocations;
+    uint64_t allocatedBytes; // in total, freed or not
+    int64_t liveBytes; // allocated less freed since accounting started, freeing earlier allocations can take it below 0
+    int64_t peakBytes; // most live at once since the last memory_reset_peak()
+    uint64_t residentBytes;
+    uint64_t minorFaults;
+    uint64_t majorFaults;
+};
+
+void memory_accounting_enable();
+memory_snapshot memory_sample();
+void memory_reset_peak();
+
+/**
+ * Reports the heap use of a benchmark run to Google Benchmark, which shows it in the JSON output. The run with memory
+ * accounting is an extra one, so it doesn't affect the timings.
+ */
+class heap_memory_manager : public benchmark::MemoryManager
+{
+public:
+    void Start() override;
+    void Stop(Result& result) override;
+    void Stop(Result* result) override
+    {
+        Stop(*result);
+    }
+
+private:
+    memory_snapshot _start{};
+};
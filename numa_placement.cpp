@@ -0,0 +1,290 @@
+#include "numa_placement.h"
+
+#include "session_corpus.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <new>
+#include <string>
+
+#ifdef __linux__
+#    include <sched.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+// From <numaif.h>, which needs libnuma
+static constexpr int MPOL_BIND_POLICY = 2;
+
+const char* numa_placement_name(numa_placement placement)
+{
+    switch (placement)
+    {
+        case numa_placement::naive:
+            return "naive";
+        case numa_placement::first_touch:
+            return "first-touch";
+        case numa_placement::bind:
+            return "bind";
+    }
+    return "";
+}
+
+// A list such as "0-3,8,10-11" as sysfs writes them for CPUs and nodes, empty when the file can't be read
+static std::vector<int> read_list(const std::string& path)
+{
+    std::vector<int> values;
+    std::FILE* file = std::fopen(path.c_str(), "r");
+    if (file == nullptr)
+    {
+        return values;
+    }
+    int first;
+    while (std::fscanf(file, "%d", &first) == 1)
+    {
+        int last = first;
+        if (std::fscanf(file, "-%d", &last) != 1)
+        {
+            last = first;
+        }
+        for (int value = first; value <= last; value++)
+        {
+            values.push_back(value);
+        }
+        std::fscanf(file, ",");
+    }
+    std::fclose(file);
+    return values;
+}
+
+struct numa_node
+{
+    int id; // node ids can have gaps, such as with nodes offline or without memory
+    std::vector<int> cpus;
+};
+
+// Nodes with any CPUs, as listed in sysfs
+static const std::vector<numa_node>& numa_nodes()
+{
+    static const std::vector<numa_node> nodes = [] {
+        std::vector<numa_node> result;
+        for (int id : read_list("/sys/devices/system/node/online"))
+        {
+            std::vector<int> cpus = read_list("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            if (!cpus.empty())
+            {
+                result.push_back({ id, std::move(cpus) });
+            }
+        }
+        return result;
+    }();
+    return nodes;
+}
+
+size_t numa_node_count()
+{
+    return std::max<size_t>(numa_nodes().size(), 1);
+}
+
+#ifdef __linux__
+
+static size_t session_bytes()
+{
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (sizeof(paint_session) + page - 1) / page * page;
+}
+
+static constexpr size_t NOT_PINNED = SIZE_MAX;
+static thread_local size_t s_pinnedNode = NOT_PINNED;
+
+// Nodes are passed by their position in numa_nodes() up to here, and by id to the system calls
+static void pin_to_node(size_t node)
+{
+    if (node >= numa_nodes().size() || node == s_pinnedNode)
+    {
+        return;
+    }
+    s_pinnedNode = node;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : numa_nodes()[node].cpus)
+    {
+        CPU_SET(cpu, &set);
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+static int node_id(size_t node)
+{
+    return node < numa_nodes().size() ? numa_nodes()[node].id : 0;
+}
+
+static bool bind_to_node(void* address, size_t length, size_t node)
+{
+    constexpr size_t bits = sizeof(unsigned long) * 8;
+    const size_t id = (size_t)node_id(node);
+    std::vector<unsigned long> mask(id / bits + 1, 0);
+    mask[id / bits] = 1ul << (id % bits);
+    return syscall(SYS_mbind, address, length, MPOL_BIND_POLICY, mask.data(), mask.size() * bits + 1, 0) == 0;
+}
+
+numa_session_batch::numa_session_batch(const std::vector<size_t>& sessions, job_pool& pool, numa_placement placement)
+    : _indices(sessions)
+    , _pool(pool)
+    , _placement(placement)
+    , _nodes(numa_node_count())
+{
+    cpu_set_t affinity;
+    if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0)
+    {
+        _originalAffinity.assign((unsigned char*)&affinity, (unsigned char*)&affinity + sizeof(affinity));
+    }
+    for (size_t i = 0; i < _indices.size(); i++)
+    {
+        void* memory = mmap(nullptr, session_bytes(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+        if (_placement == numa_placement::bind && !bind_to_node(memory, session_bytes(), worker_node(i % _pool.threads())))
+        {
+            _bindFailed = true;
+        }
+        _sessions.push_back((paint_session*)memory);
+    }
+    reset(0);
+}
+
+numa_session_batch::~numa_session_batch()
+{
+    for (paint_session* session : _sessions)
+    {
+        munmap(session, session_bytes());
+    }
+    // The calling thread takes part in the pool's jobs and got pinned along the way
+    if (!_originalAffinity.empty())
+    {
+        sched_setaffinity(0, _originalAffinity.size(), (cpu_set_t*)_originalAffinity.data());
+        s_pinnedNode = NOT_PINNED;
+    }
+}
+
+double numa_session_batch::remote_page_fraction() const
+{
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t pagesPerSession = session_bytes() / pageSize;
+    size_t remote = 0;
+    size_t total = 0;
+    for (size_t i = 0; i < _sessions.size(); i++)
+    {
+        std::vector<void*> pages(pagesPerSession);
+        std::vector<int> status(pagesPerSession, -1);
+        for (size_t page = 0; page < pagesPerSession; page++)
+        {
+            pages[page] = (char*)_sessions[i] + page * pageSize;
+        }
+        if (syscall(SYS_move_pages, 0, pagesPerSession, pages.data(), nullptr, status.data(), 0) != 0)
+        {
+            return -1;
+        }
+        const int node = node_id(worker_node(i % _pool.threads()));
+        for (int pageNode : status)
+        {
+            if (pageNode >= 0)
+            {
+                remote += pageNode != node;
+                total++;
+            }
+        }
+    }
+    return total == 0 ? -1 : (double)remote / total;
+}
+
+#else
+
+static void pin_to_node(size_t)
+{
+}
+
+numa_session_batch::numa_session_batch(const std::vector<size_t>& sessions, job_pool& pool, numa_placement placement)
+    : _indices(sessions)
+    , _pool(pool)
+    , _placement(placement)
+    , _nodes(1)
+    , _bindFailed(placement == numa_placement::bind)
+{
+    for (size_t i = 0; i < _indices.size(); i++)
+    {
+        _sessions.push_back(new paint_session);
+    }
+    reset(0);
+}
+
+numa_session_batch::~numa_session_batch()
+{
+    for (paint_session* session : _sessions)
+    {
+        delete session;
+    }
+}
+
+double numa_session_batch::remote_page_fraction() const
+{
+    return -1;
+}
+
+#endif
+
+size_t numa_session_batch::worker_node(size_t worker) const
+{
+    return worker % _nodes;
+}
+
+void numa_session_batch::for_each_worker(void (numa_session_batch::*job)(size_t worker, uint8_t rotation), uint8_t rotation)
+{
+    _pool.run(_pool.threads(), [&](size_t worker) {
+        // Which pool thread runs which worker can change from one batch to the next
+        pin_to_node(worker_node(worker));
+        (this->*job)(worker, rotation);
+    });
+}
+
+void numa_session_batch::fill(size_t worker, uint8_t rotation)
+{
+    for (size_t i = worker; i < _sessions.size(); i += _pool.threads())
+    {
+        paint_session* session = _sessions[i];
+        session_corpus_copy(session, _indices[i], 1);
+        fixup_pointers(session, 1, std::size(session->PaintStructs), std::size(session->Quadrants));
+        session->CurrentRotation = rotation;
+    }
+}
+
+void numa_session_batch::arrange_worker(size_t worker, uint8_t)
+{
+    for (size_t i = worker; i < _sessions.size(); i += _pool.threads())
+    {
+        _arranger->arrange(_sessions[i]);
+    }
+}
+
+void numa_session_batch::reset(uint8_t rotation)
+{
+    if (_placement == numa_placement::naive)
+    {
+        for (size_t worker = 0; worker < _pool.threads(); worker++)
+        {
+            fill(worker, rotation);
+        }
+        return;
+    }
+    for_each_worker(&numa_session_batch::fill, rotation);
+}
+
+void numa_session_batch::arrange(const paint_arranger& arranger)
+{
+    _arranger = &arranger;
+    for_each_worker(&numa_session_batch::arrange_worker, 0);
+}
@@ -0,0 +1,67 @@
+/*
+ * NUMA aware placement of the sessions a batch of workers arranges.
+ *
+ * Each session is assigned to a worker, and each worker to a NUMA node, round robin. With naive placement the thread
+ * setting up the batch writes every session and so, by the kernel's first touch policy, places them all on its own
+ * node. First touch placement has each worker, pinned to its node, write its own sessions instead, and bind placement
+ * asks for the node explicitly with mbind(2) before the sessions are written.
+ *
+ * The node memory actually ended up on is read back with move_pages(2), so the share of remote pages each placement
+ * leaves is reported rather than assumed. On machines with a single node, or without the system calls, everything
+ * still runs with all memory local.
+ */
+
+#pragma once
+
+#include "arrangers.h"
+#include "job_pool.h"
+
+#include <vector>
+
+enum class numa_placement
+{
+    naive,
+    first_touch,
+    bind,
+};
+
+const char* numa_placement_name(numa_placement placement);
+
+// Number of nodes with CPUs, 1 when the topology can't be read
+size_t numa_node_count();
+
+class numa_session_batch
+{
+public:
+    numa_session_batch(const std::vector<size_t>& sessions, job_pool& pool, numa_placement placement);
+    ~numa_session_batch();
+    numa_session_batch(const numa_session_batch&) = delete;
+    numa_session_batch& operator=(const numa_session_batch&) = delete;
+
+    // Copies the captured sessions in again, each by the worker it belongs to
+    void reset(uint8_t rotation);
+    void arrange(const paint_arranger& arranger);
+
+    // Share of the session pages not on the node of the worker arranging them, -1 when unknown
+    double remote_page_fraction() const;
+    // Whether bind placement fell back to first touch, because mbind(2) isn't available
+    bool bind_failed() const
+    {
+        return _bindFailed;
+    }
+
+private:
+    size_t worker_node(size_t worker) const;
+    void for_each_worker(void (numa_session_batch::*job)(size_t worker, uint8_t rotation), uint8_t rotation);
+    void fill(size_t worker, uint8_t rotation);
+    void arrange_worker(size_t worker, uint8_t rotation);
+
+    std::vector<size_t> _indices;
+    std::vector<paint_session*> _sessions;
+    job_pool& _pool;
+    numa_placement _placement;
+    size_t _nodes;
+    bool _bindFailed = false;
+    const paint_arranger* _arranger = nullptr;
+    std::vector<unsigned char> _originalAffinity;
+};
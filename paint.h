@@ -0,0 +1,219 @@
+/*
+ * Paint structures and session arrangement, extracted from OpenRCT2 as of cf44ea7e2.
+ * See paint_struct_benchmark.cpp for how the corpus is captured and how to build the benchmark.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#define MAX_PAINT_QUADRANTS 512
+#define assert_struct_size(x, y) static_assert(sizeof(x) == (y), "Improper struct size")
+
+struct SurfaceElement;
+struct PathElement;
+struct TrackElement;
+struct SmallSceneryElement;
+struct LargeSceneryElement;
+struct WallElement;
+struct EntranceElement;
+struct BannerElement;
+struct CorruptElement;
+
+struct TileElementBase
+{
+    uint8_t type;             // 0
+    uint8_t flags;            // 1
+    uint8_t base_height;      // 2
+    uint8_t clearance_height; // 3
+
+    uint8_t GetType() const;
+    void SetType(uint8_t newType);
+    uint8_t GetDirection() const;
+    void SetDirection(uint8_t direction);
+    uint8_t GetDirectionWithOffset(uint8_t offset) const;
+    bool IsLastForTile() const;
+    bool IsGhost() const;
+    void Remove();
+};
+
+enum class TileElementType : uint8_t
+{
+    Surface = (0 << 2),
+    Path = (1 << 2),
+    Track = (2 << 2),
+    SmallScenery = (3 << 2),
+    Entrance = (4 << 2),
+    Wall = (5 << 2),
+    LargeScenery = (6 << 2),
+    Banner = (7 << 2),
+    Corrupt = (8 << 2),
+};
+
+/**
+ * Map element structure
+ * size: 0x08
+ */
+struct TileElement : public TileElementBase
+{
+    uint8_t pad_04[4];
+
+    template<typename TType, TileElementType TClass> TType* as() const
+    {
+        return (TileElementType)GetType() == TClass ? (TType*)this : nullptr;
+    }
+
+public:
+    SurfaceElement* AsSurface() const
+    {
+        return as<SurfaceElement, TileElementType::Surface>();
+    }
+    PathElement* AsPath() const
+    {
+        return as<PathElement, TileElementType::Path>();
+    }
+    TrackElement* AsTrack() const
+    {
+        return as<TrackElement, TileElementType::Track>();
+    }
+    SmallSceneryElement* AsSmallScenery() const
+    {
+        return as<SmallSceneryElement, TileElementType::SmallScenery>();
+    }
+    LargeSceneryElement* AsLargeScenery() const
+    {
+        return as<LargeSceneryElement, TileElementType::LargeScenery>();
+    }
+    WallElement* AsWall() const
+    {
+        return as<WallElement, TileElementType::Wall>();
+    }
+    EntranceElement* AsEntrance() const
+    {
+        return as<EntranceElement, TileElementType::Entrance>();
+    }
+    BannerElement* AsBanner() const
+    {
+        return as<BannerElement, TileElementType::Banner>();
+    }
+    CorruptElement* AsCorrupt() const
+    {
+        return as<CorruptElement, TileElementType::Corrupt>();
+    }
+
+    void ClearAs(uint8_t newType);
+};
+assert_struct_size(TileElement, 8);
+
+#pragma pack(push, 1)
+struct paint_struct_bound_box
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t z;
+    uint16_t x_end;
+    uint16_t y_end;
+    uint16_t z_end;
+};
+
+struct attached_paint_struct
+{
+    uint32_t image_id; // 0x00
+    union
+    {
+        uint32_t tertiary_colour;
+        // If masked image_id is masked_id
+        uint32_t colour_image_id;
+    };
+    uint16_t x;    // 0x08
+    uint16_t y;    // 0x0A
+    uint8_t flags; // 0x0C
+    uint8_t pad_0D;
+    attached_paint_struct* next; // 0x0E
+};
+
+/* size 0x34 */
+struct paint_struct
+{
+    uint32_t image_id; // 0x00
+    union
+    {
+        uint32_t tertiary_colour; // 0x04
+        // If masked image_id is masked_id
+        uint32_t colour_image_id; // 0x04
+    };
+    paint_struct_bound_box bounds; // 0x08
+    uint16_t x;                    // 0x14
+    uint16_t y;                    // 0x16
+    uint16_t quadrant_index;
+    uint8_t flags;
+    uint8_t quadrant_flags;
+    attached_paint_struct* attached_ps; // 0x1C
+    paint_struct* children;
+    paint_struct* next_quadrant_ps; // 0x24
+    uint8_t sprite_type;            // 0x28
+    uint8_t var_29;
+    uint16_t pad_2A;
+    uint16_t map_x;           // 0x2C
+    uint16_t map_y;           // 0x2E
+    TileElement* tileElement; // 0x30 (or sprite pointer)
+};
+
+using rct_string_id = uint16_t;
+
+struct paint_string_struct
+{
+    rct_string_id string_id;   // 0x00
+    paint_string_struct* next; // 0x02
+    uint16_t x;                // 0x06
+    uint16_t y;                // 0x08
+    uint32_t args[4];          // 0x0A
+    uint8_t* y_offsets;        // 0x1A
+};
+#pragma pack(pop)
+
+union paint_entry
+{
+    paint_struct basic;
+    attached_paint_struct attached;
+    paint_string_struct string;
+};
+static_assert(sizeof(paint_entry) == sizeof(paint_struct), "Invalid size");
+
+struct paint_session
+{
+    paint_entry PaintStructs[4000];
+    paint_struct* Quadrants[MAX_PAINT_QUADRANTS]; // needed
+    paint_struct PaintHead;                       // needed
+    uint32_t QuadrantBackIndex;                   // needed
+    uint32_t QuadrantFrontIndex;                  // needed
+    uint8_t CurrentRotation;
+};
+
+// A paint_session with a pool per type of entry in place of the PaintStructs union, so that attached sprites and strings
+// don't take up paint_struct sized slots in between the structs arrangement walks. The pools are sized per session.
+struct paint_session_pools
+{
+    paint_struct* PaintStructs;
+    attached_paint_struct* AttachedStructs;
+    paint_string_struct* Strings;
+    uint16_t PaintStructCapacity;
+    uint16_t AttachedStructCapacity;
+    uint16_t StringCapacity;
+    paint_struct* Quadrants[MAX_PAINT_QUADRANTS];
+    paint_struct PaintHead;
+    uint32_t QuadrantBackIndex;
+    uint32_t QuadrantFrontIndex;
+    uint8_t CurrentRotation;
+};
+
+enum PAINT_QUADRANT_FLAGS
+{
+    PAINT_QUADRANT_FLAG_IDENTICAL = (1 << 0),
+    PAINT_QUADRANT_FLAG_BIGGER = (1 << 7),
+    PAINT_QUADRANT_FLAG_NEXT = (1 << 1),
+};
+
+paint_struct* paint_arrange_structs_helper(paint_struct* ps_next, uint16_t quadrantIndex, uint8_t flag, uint8_t rotation);
+void paint_session_arrange(paint_session* session);
+void paint_session_arrange(paint_session_pools* session);
@@ -0,0 +1,173 @@
+#include "paint_draw.h"
+
+#include <algorithm>
+#include <cstring>
+
+static int32_t world_coordinate(uint16_t value)
+{
+    return (int16_t)value;
+}
+
+screen_rect paint_struct_screen_rect(const paint_struct& ps)
+{
+    // translate_3d_to_2d_with_z() at rotation 0: x' = y - x, y' = (x + y) / 2 - z, taken at the box's extreme corners
+    const int32_t x = world_coordinate(ps.bounds.x);
+    const int32_t y = world_coordinate(ps.bounds.y);
+    const int32_t xEnd = std::max(x, world_coordinate(ps.bounds.x_end));
+    const int32_t yEnd = std::max(y, world_coordinate(ps.bounds.y_end));
+    const int32_t z = std::min(world_coordinate(ps.bounds.z), world_coordinate(ps.bounds.z_end));
+    const int32_t zEnd = std::max(world_coordinate(ps.bounds.z), world_coordinate(ps.bounds.z_end));
+    return { y - xEnd, (x + y) / 2 - zEnd, yEnd - x + 1, (xEnd + yEnd) / 2 - z + 1 };
+}
+
+uint8_t paint_struct_colour(const paint_struct& ps)
+{
+    if (ps.image_id != 0)
+    {
+        return (uint8_t)ps.image_id;
+    }
+    // Palette index 0 is transparent
+    const uint32_t hash = ps.bounds.x * 7u + ps.bounds.y * 13u + ps.bounds.z * 3u + ps.sprite_type;
+    return (uint8_t)(1 + hash % 255);
+}
+
+screen_rect paint_session_screen_rect(const paint_session& session)
+{
+    screen_rect area = { INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+    for (const paint_struct* head : session.Quadrants)
+    {
+        for (const paint_struct* ps = head; ps != nullptr; ps = ps->next_quadrant_ps)
+        {
+            const screen_rect rect = paint_struct_screen_rect(*ps);
+            area.left = std::min(area.left, rect.left);
+            area.top = std::min(area.top, rect.top);
+            area.right = std::max(area.right, rect.right);
+            area.bottom = std::max(area.bottom, rect.bottom);
+        }
+    }
+    if (area.left >= area.right)
+    {
+        area = {};
+    }
+    return area;
+}
+
+void paint_framebuffer_fit(paint_framebuffer& framebuffer, const paint_session& session)
+{
+    const screen_rect area = paint_session_screen_rect(session);
+    framebuffer.x = area.left;
+    framebuffer.y = area.top;
+    framebuffer.width = area.right - area.left;
+    framebuffer.height = area.bottom - area.top;
+    framebuffer.pixels.assign((size_t)framebuffer.width * framebuffer.height, 0);
+}
+
+uint64_t paint_session_draw(const paint_session& session, paint_framebuffer& framebuffer)
+{
+    uint64_t written = 0;
+    for (const paint_struct* ps = session.PaintHead.next_quadrant_ps; ps != nullptr; ps = ps->next_quadrant_ps)
+    {
+        const screen_rect rect = paint_struct_screen_rect(*ps);
+        const int32_t left = std::max(rect.left - framebuffer.x, 0);
+        const int32_t top = std::max(rect.top - framebuffer.y, 0);
+        const int32_t right = std::min(rect.right - framebuffer.x, framebuffer.width);
+        const int32_t bottom = std::min(rect.bottom - framebuffer.y, framebuffer.height);
+        if (left >= right || top >= bottom)
+        {
+            continue;
+        }
+        const uint8_t colour = paint_struct_colour(*ps);
+        for (int32_t row = top; row < bottom; row++)
+        {
+            std::memset(&framebuffer.pixels[(size_t)row * framebuffer.width + left], colour, right - left);
+        }
+        written += (uint64_t)(right - left) * (bottom - top);
+    }
+    return written;
+}
+
+void paint_session_draw_commands(const paint_session& session, std::vector<draw_command>& commands)
+{
+    commands.clear();
+    for (const paint_struct* ps = session.PaintHead.next_quadrant_ps; ps != nullptr; ps = ps->next_quadrant_ps)
+    {
+        const screen_rect rect = paint_struct_screen_rect(*ps);
+        const uint32_t imageId = paint_struct_image_id(*ps);
+        const uint32_t colours = paint_struct_colours(*ps, imageId);
+        commands.push_back({ rect, imageId, colours });
+        size_t index = 0;
+        for (const attached_paint_struct* attached = ps->attached_ps; attached != nullptr; attached = attached->next)
+        {
+            // Attached sprites are drawn at an offset from the struct's, sized by their image
+            const uint32_t attachedId = attached_paint_struct_image_id(*attached, imageId, index++);
+            const int32_t left = rect.left + (int16_t)attached->x;
+            const int32_t top = rect.top + (int16_t)attached->y;
+            commands.push_back(
+                { { left, top, left + 8 + (int32_t)(attachedId % 25), top + 8 + (int32_t)(attachedId / 25 % 25) },
+                    attachedId, attached_paint_struct_colours(*attached, colours) });
+        }
+    }
+}
+
+void sprite_set_generate(sprite_set& sprites, const std::vector<draw_command>& commands)
+{
+    for (const draw_command& command : commands)
+    {
+        sprites.generate(command.image_id, command.rect.right - command.rect.left, command.rect.bottom - command.rect.top);
+    }
+}
+
+uint64_t paint_draw_command(const draw_command& command, const decoded_sprite& sprite, const screen_rect& clip,
+    paint_framebuffer& framebuffer, palette_remap_cache* remaps)
+{
+    const int32_t x = command.rect.left - framebuffer.x;
+    const int32_t y = command.rect.top - framebuffer.y;
+    const int32_t left = std::max({ x, clip.left - framebuffer.x, 0 });
+    const int32_t top = std::max({ y, clip.top - framebuffer.y, 0 });
+    const int32_t right = std::min(
+        { x + sprite.width, command.rect.right - framebuffer.x, clip.right - framebuffer.x, framebuffer.width });
+    const int32_t bottom = std::min(
+        { y + sprite.height, command.rect.bottom - framebuffer.y, clip.bottom - framebuffer.y, framebuffer.height });
+    uint64_t written = 0;
+    if (remaps != nullptr && command.colours != 0 && left < right)
+    {
+        const palette_remap& remap = remaps->get(command.colours);
+        for (int32_t row = top; row < bottom; row++)
+        {
+            written += palette_remap_row(remap, &sprite.pixels[(size_t)(row - y) * sprite.width + (left - x)],
+                &framebuffer.pixels[(size_t)row * framebuffer.width + left], right - left, remaps->isa());
+        }
+        return written;
+    }
+    for (int32_t row = top; row < bottom; row++)
+    {
+        const uint8_t* source = &sprite.pixels[(size_t)(row - y) * sprite.width + (left - x)];
+        uint8_t* target = &framebuffer.pixels[(size_t)row * framebuffer.width + left];
+        for (int32_t column = 0; column < right - left; column++)
+        {
+            if (source[column] != 0)
+            {
+                target[column] = source[column];
+                written++;
+            }
+        }
+    }
+    return written;
+}
+
+uint64_t paint_draw_commands(const std::vector<draw_command>& commands, sprite_cache& cache, paint_framebuffer& framebuffer,
+    palette_remap_cache* remaps)
+{
+    const screen_rect area = { framebuffer.x, framebuffer.y, framebuffer.x + framebuffer.width,
+        framebuffer.y + framebuffer.height };
+    uint64_t written = 0;
+    for (const draw_command& command : commands)
+    {
+        const std::shared_ptr<const decoded_sprite> sprite = cache.get(command.image_id);
+        if (sprite != nullptr)
+        {
+            written += paint_draw_command(command, *sprite, area, framebuffer, remaps);
+        }
+    }
+    return written;
+}
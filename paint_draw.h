@@ -0,0 +1,70 @@
+/*
+ * Stand-in for the drawing stage which follows arrangement: walks the arranged list and fills the screen area of every
+ * paint struct in order, so later structs cover earlier ones as sprites would.
+ *
+ * The capture has no image data, so each struct is drawn as the screen bounding rectangle of its bounding box
+ * projected the way the game does at rotation 0, in a colour derived from its bounds.
+ *
+ * Alternatively the arranged list is turned into draw commands, one per struct and per attached struct, which blit a
+ * sprite of the locally generated set (see sprite_set.h) clipped to the command's rectangle. Given a
+ * palette_remap_cache, the sprites of recoloured commands are remapped to their colours as they are blitted.
+ */
+
+#pragma once
+
+#include "paint.h"
+#include "palette_remap.h"
+#include "sprite_cache.h"
+
+#include <cstdint>
+#include <vector>
+
+struct screen_rect
+{
+    int32_t left;
+    int32_t top;
+    int32_t right; // exclusive
+    int32_t bottom; // exclusive
+};
+
+struct paint_framebuffer
+{
+    int32_t x = 0; // screen position of the top left pixel
+    int32_t y = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+screen_rect paint_struct_screen_rect(const paint_struct& ps);
+uint8_t paint_struct_colour(const paint_struct& ps);
+
+// Screen area covering everything the session's structs can draw, empty for an empty session
+screen_rect paint_session_screen_rect(const paint_session& session);
+
+// Resizes the framebuffer to the session's screen area, and clears it
+void paint_framebuffer_fit(paint_framebuffer& framebuffer, const paint_session& session);
+
+// Draws an arranged session, returns the number of pixels written
+uint64_t paint_session_draw(const paint_session& session, paint_framebuffer& framebuffer);
+
+struct draw_command
+{
+    screen_rect rect; // the sprite is drawn from the top left corner and clipped to the rectangle
+    uint32_t image_id;
+    uint32_t colours = 0; // see palette_remap_colours()
+};
+
+// Draw commands of an arranged session in drawing order, each struct followed by its attached structs
+void paint_session_draw_commands(const paint_session& session, std::vector<draw_command>& commands);
+
+// Generates a sprite of each command's size for the image ids the set doesn't have yet
+void sprite_set_generate(sprite_set& sprites, const std::vector<draw_command>& commands);
+
+// Blits the command's sprite, clipped to the screen rectangle as well, returns the number of pixels written
+uint64_t paint_draw_command(const draw_command& command, const decoded_sprite& sprite, const screen_rect& clip,
+    paint_framebuffer& framebuffer, palette_remap_cache* remaps = nullptr);
+
+// Blits the commands' sprites in order, returns the number of pixels written
+uint64_t paint_draw_commands(const std::vector<draw_command>& commands, sprite_cache& cache, paint_framebuffer& framebuffer,
+    palette_remap_cache* remaps = nullptr);
@@ -0,0 +1,124 @@
+#include "paint_pools.h"
+
+#include "session_corpus.h"
+
+#include <iterator>
+#include <memory>
+
+static constexpr uint16_t NO_STRUCT = UINT16_MAX;
+
+pooled_session_set::pooled_session_set(const std::vector<size_t>& indices)
+    : _sessions(indices.size())
+    , _pools(indices.size())
+{
+    auto session = std::make_unique<paint_session>();
+    const size_t structCount = std::size(session->PaintStructs);
+    auto entry_of = [&](const paint_struct* ps) { return (size_t)((const paint_entry*)ps - session->PaintStructs); };
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        *session = session_corpus_get(indices[i]);
+        fixup_pointers(session.get(), 1, structCount, std::size(session->Quadrants));
+
+        // The structs reachable from the quadrants, in the order they were allocated
+        std::vector<uint16_t> renumbered(structCount, NO_STRUCT);
+        for (const paint_struct* head : session->Quadrants)
+        {
+            for (const paint_struct* ps = head; ps != nullptr; ps = ps->next_quadrant_ps)
+            {
+                renumbered[entry_of(ps)] = 0;
+            }
+        }
+        pools& pool = _pools[i];
+        for (size_t entry = 0; entry < structCount; entry++)
+        {
+            if (renumbered[entry] != NO_STRUCT)
+            {
+                renumbered[entry] = (uint16_t)pool.entries.size();
+                pool.entries.push_back((uint16_t)entry);
+            }
+        }
+
+        // Attached structs are pooled in the order of the structs they belong to, each struct's contiguously
+        std::vector<size_t> attachedCounts;
+        for (uint16_t entry : pool.entries)
+        {
+            const paint_struct& ps = session->PaintStructs[entry].basic;
+            pool.structs.push_back(ps);
+            pool.next.push_back(ps.next_quadrant_ps == nullptr ? NO_STRUCT : renumbered[entry_of(ps.next_quadrant_ps)]);
+            pool.flags.push_back(ps.quadrant_flags);
+            attachedCounts.push_back(0);
+            for (const attached_paint_struct* attached = ps.attached_ps; attached != nullptr; attached = attached->next)
+            {
+                pool.attached.push_back(*attached);
+                attachedCounts.back()++;
+            }
+        }
+        for (size_t j = 0, first = 0; j < pool.structs.size(); first += attachedCounts[j++])
+        {
+            pool.structs[j].attached_ps = attachedCounts[j] == 0 ? nullptr : &pool.attached[first];
+            for (size_t k = first; k < first + attachedCounts[j]; k++)
+            {
+                pool.attached[k].next = k + 1 < first + attachedCounts[j] ? &pool.attached[k + 1] : nullptr;
+            }
+        }
+        for (const paint_struct* head : session->Quadrants)
+        {
+            pool.quadrants.push_back(head == nullptr ? NO_STRUCT : renumbered[entry_of(head)]);
+        }
+
+        paint_session_pools& pooled = _sessions[i];
+        pooled.PaintStructs = pool.structs.data();
+        pooled.AttachedStructs = pool.attached.data();
+        pooled.Strings = pool.strings.data();
+        pooled.PaintStructCapacity = (uint16_t)pool.structs.size();
+        pooled.AttachedStructCapacity = (uint16_t)pool.attached.size();
+        pooled.StringCapacity = (uint16_t)pool.strings.size();
+        pooled.PaintHead = {};
+        pooled.QuadrantBackIndex = session->QuadrantBackIndex;
+        pooled.QuadrantFrontIndex = session->QuadrantFrontIndex;
+        _liveStructs += pool.structs.size();
+        _attachedStructs += pool.attached.size();
+    }
+}
+
+size_t pooled_session_set::bytes() const
+{
+    size_t bytes = 0;
+    for (const paint_session_pools& session : _sessions)
+    {
+        bytes += sizeof(session) + session.PaintStructCapacity * sizeof(paint_struct)
+            + session.AttachedStructCapacity * sizeof(attached_paint_struct)
+            + session.StringCapacity * sizeof(paint_string_struct);
+    }
+    return bytes;
+}
+
+void pooled_session_set::reset(uint8_t rotation)
+{
+    for (size_t i = 0; i < _sessions.size(); i++)
+    {
+        paint_session_pools& session = _sessions[i];
+        const pools& pool = _pools[i];
+        auto pointer = [&](uint16_t index) { return index == NO_STRUCT ? nullptr : &session.PaintStructs[index]; };
+        for (size_t j = 0; j < pool.next.size(); j++)
+        {
+            session.PaintStructs[j].next_quadrant_ps = pointer(pool.next[j]);
+            session.PaintStructs[j].quadrant_flags = pool.flags[j];
+        }
+        for (size_t j = 0; j < pool.quadrants.size(); j++)
+        {
+            session.Quadrants[j] = pointer(pool.quadrants[j]);
+        }
+        session.CurrentRotation = rotation;
+    }
+}
+
+void pooled_session_set::get_order(size_t session, std::vector<uint16_t>& order) const
+{
+    order.clear();
+    const paint_session_pools& pooled = _sessions[session];
+    for (const paint_struct* ps = pooled.PaintHead.next_quadrant_ps; ps != nullptr; ps = ps->next_quadrant_ps)
+    {
+        order.push_back(_pools[session].entries[ps - pooled.PaintStructs]);
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Working copies of corpus sessions in typed pools (paint_session_pools, see paint.h) rather than in PaintStructs.
+ *
+ * The game allocates attached structs from PaintStructs right after the struct they belong to, so in a paint_session
+ * every attached sprite puts a 68 byte slot between the structs arrangement walks. Here each session gets a pool of
+ * paint structs, kept in the order the game allocated them, and a pool of attached structs, both sized to what the
+ * session holds. Captures don't record painted strings, their pool stays empty.
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class pooled_session_set
+{
+public:
+    explicit pooled_session_set(const std::vector<size_t>& indices);
+    pooled_session_set(const pooled_session_set&) = delete;
+    pooled_session_set& operator=(const pooled_session_set&) = delete;
+
+    paint_session_pools* data()
+    {
+        return _sessions.data();
+    }
+    size_t size() const
+    {
+        return _sessions.size();
+    }
+    size_t live_structs() const
+    {
+        return _liveStructs;
+    }
+    size_t attached_structs() const
+    {
+        return _attachedStructs;
+    }
+    // Memory taken by the sessions and their pools
+    size_t bytes() const;
+
+    // Restores the links arrangement modifies, to be arranged again at the given rotation
+    void reset(uint8_t rotation);
+
+    // Drawing order left by arrangement as indices into the captured session's PaintStructs, to compare against
+    // paint_session_get_order()
+    void get_order(size_t session, std::vector<uint16_t>& order) const;
+
+private:
+    struct pools
+    {
+        std::vector<paint_struct> structs;
+        std::vector<attached_paint_struct> attached;
+        std::vector<paint_string_struct> strings;
+        std::vector<uint16_t> entries;   // captured entry of each struct
+        std::vector<uint16_t> next;      // captured list links, as struct indices
+        std::vector<uint8_t> flags;      // captured quadrant flags
+        std::vector<uint16_t> quadrants; // captured heads, as struct indices
+    };
+
+    std::vector<paint_session_pools> _sessions;
+    std::vector<pools> _pools;
+    size_t _liveStructs = 0;
+    size_t _attachedStructs = 0;
+};
@@ -0,0 +1,315 @@
+#include "paint_rotation_batch.h"
+
+#include <algorithm>
+#include <iterator>
+
+static constexpr uint16_t NO_NODE = UINT16_MAX;
+
+// check_bounding_box<0..3> for one pair, sharing the comparisons between rotations. Bit R is set when rotation R would
+// move current in front of initial.
+static uint8_t compare_all_rotations(const paint_struct_bound_box& initial, const paint_struct_bound_box& current)
+{
+    const bool zOverlap = initial.z_end >= current.z;
+    const bool zInside = initial.z < current.z_end;
+    const bool yEnd = initial.y_end >= current.y;
+    const bool xEnd = initial.x_end >= current.x;
+    const bool yStart = initial.y < current.y_end;
+    const bool xStart = initial.x < current.x_end;
+
+    const uint8_t r0 = zOverlap & yEnd & xEnd & !(zInside & yStart & xStart);
+    const uint8_t r1 = zOverlap & yEnd & !xEnd & !(zInside & yStart & !xStart);
+    const uint8_t r2 = zOverlap & !yEnd & !xEnd & !(zInside & !yStart & !xStart);
+    const uint8_t r3 = zOverlap & !yEnd & xEnd & !(zInside & !yStart & xStart);
+    return r0 | (r1 << 1) | (r2 << 2) | (r3 << 3);
+}
+
+void paint_rotation_batch::prepare_window(uint32_t quadrantIndex, bool first)
+{
+    // Every struct of the window can become the initial one, only the next quadrant's structs carry the NEXT flag,
+    // except in the first window where all of them do
+    const uint32_t relative = quadrantIndex - _backIndex;
+    _rowBase = _quadrantStart[relative];
+    _rows = _quadrantStart[relative + 2] - _rowBase;
+    _columnBase = first ? _rowBase : _quadrantStart[relative + 1];
+    _columns = _quadrantStart[relative + 2] - _columnBase;
+
+    _masks.resize(_rows * _columns);
+    _rowAny.resize(_rows);
+    if (_rows == 0)
+    {
+        return;
+    }
+    _windows++;
+    if (_quantize && prepare_window_quantized())
+    {
+        _quantizedWindows++;
+        return;
+    }
+
+    const uint16_t* x = &_x[_columnBase];
+    const uint16_t* y = &_y[_columnBase];
+    const uint16_t* z = &_z[_columnBase];
+    const uint16_t* xEnd = &_xEnd[_columnBase];
+    const uint16_t* yEnd = &_yEnd[_columnBase];
+    const uint16_t* zEnd = &_zEnd[_columnBase];
+    for (uint32_t row = 0; row < _rows; row++)
+    {
+        const paint_struct_bound_box& initial = _bounds[_rowBase + row];
+        uint8_t* masks = &_masks[row * _columns];
+        // Same as compare_all_rotations(), written over the columns so that it vectorises
+        for (uint32_t column = 0; column < _columns; column++)
+        {
+            const uint8_t zOverlap = initial.z_end >= z[column];
+            const uint8_t zInside = initial.z < zEnd[column];
+            const uint8_t yEndAfter = initial.y_end >= y[column];
+            const uint8_t xEndAfter = initial.x_end >= x[column];
+            const uint8_t yStart = initial.y < yEnd[column];
+            const uint8_t xStart = initial.x < xEnd[column];
+            const uint8_t r0 = zOverlap & yEndAfter & xEndAfter & ((zInside & yStart & xStart) ^ 1);
+            const uint8_t r1 = zOverlap & yEndAfter & (xEndAfter ^ 1) & ((zInside & yStart & (xStart ^ 1)) ^ 1);
+            const uint8_t r2 = zOverlap & (yEndAfter ^ 1) & (xEndAfter ^ 1) & ((zInside & (yStart ^ 1) & (xStart ^ 1)) ^ 1);
+            const uint8_t r3 = zOverlap & (yEndAfter ^ 1) & xEndAfter & ((zInside & (yStart ^ 1) & xStart) ^ 1);
+            masks[column] = r0 | (r1 << 1) | (r2 << 2) | (r3 << 3);
+        }
+        uint8_t any = 0;
+        for (uint32_t column = 0; column < _columns; column++)
+        {
+            any |= masks[column];
+        }
+        _rowAny[row] = any;
+    }
+}
+
+// Fills the window's masks from its bounds quantized to 8 bits, if they fit
+bool paint_rotation_batch::prepare_window_quantized()
+{
+    const uint16_t* coordinates[6] = { &_x[_rowBase], &_y[_rowBase], &_z[_rowBase], &_xEnd[_rowBase], &_yEnd[_rowBase],
+        &_zEnd[_rowBase] };
+    // Starts and ends along an axis are compared with each other, so they share the offset
+    uint16_t offset[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const auto [startMin, startMax] = std::minmax_element(coordinates[axis], coordinates[axis] + _rows);
+        const auto [endMin, endMax] = std::minmax_element(coordinates[axis + 3], coordinates[axis + 3] + _rows);
+        offset[axis] = std::min(*startMin, *endMin);
+        if (std::max(*startMax, *endMax) - offset[axis] > UINT8_MAX)
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        _quantized[i].resize(_rows);
+        for (uint32_t row = 0; row < _rows; row++)
+        {
+            _quantized[i][row] = (uint8_t)(coordinates[i][row] - offset[i % 3]);
+        }
+    }
+
+    const uint32_t column = _columnBase - _rowBase;
+    const quantized_columns columns{ &_quantized[0][column], &_quantized[1][column], &_quantized[2][column],
+        &_quantized[3][column], &_quantized[4][column], &_quantized[5][column] };
+    for (uint32_t row = 0; row < _rows; row++)
+    {
+        const quantized_box initial{ _quantized[0][row], _quantized[1][row], _quantized[2][row], _quantized[3][row],
+            _quantized[4][row], _quantized[5][row] };
+        uint8_t* masks = &_masks[row * _columns];
+        window_compare_u8(initial, columns, _columns, masks);
+        uint8_t any = 0;
+        for (uint32_t i = 0; i < _columns; i++)
+        {
+            any |= masks[i];
+        }
+        _rowAny[row] = any;
+    }
+    return true;
+}
+
+// Mirrors paint_arrange_structs_helper_rotation() on the index based lists
+template<uint8_t TRotation>
+uint16_t paint_rotation_batch::arrange_window(uint16_t psNext, uint16_t quadrantIndex, uint8_t flag)
+{
+    uint16_t* next = _lists[TRotation].next.data();
+    uint8_t* flags = _lists[TRotation].flags.data();
+    const uint16_t* quadrant = _quadrant.data();
+
+    uint16_t ps;
+    uint16_t psTemp;
+    do
+    {
+        ps = psNext;
+        psNext = next[psNext];
+        if (psNext == NO_NODE)
+            return ps;
+    } while (quadrantIndex > quadrant[psNext]);
+
+    const uint16_t psCache = ps;
+
+    // The structs visited here are the only ones the comparisons below can reach. When all of them that can be compared
+    // belong to the window, a row without any match for this rotation can't move anything and its scan is skipped.
+    bool regular = true;
+    psTemp = ps;
+    do
+    {
+        ps = next[ps];
+        if (ps == NO_NODE)
+            break;
+
+        regular &= quadrant[ps] > quadrantIndex + 1 || (uint32_t)(ps - _rowBase) < _rows
+            || !(flags[ps] & PAINT_QUADRANT_FLAG_NEXT);
+        if (quadrant[ps] > quadrantIndex + 1)
+        {
+            flags[ps] = PAINT_QUADRANT_FLAG_BIGGER;
+        }
+        else if (quadrant[ps] == quadrantIndex + 1)
+        {
+            flags[ps] = PAINT_QUADRANT_FLAG_NEXT | PAINT_QUADRANT_FLAG_IDENTICAL;
+        }
+        else if (quadrant[ps] == quadrantIndex)
+        {
+            flags[ps] = flag | PAINT_QUADRANT_FLAG_IDENTICAL;
+        }
+    } while (quadrant[ps] <= quadrantIndex + 1);
+    ps = psTemp;
+
+    while (true)
+    {
+        while (true)
+        {
+            psNext = next[ps];
+            if (psNext == NO_NODE)
+                return psCache;
+            if (flags[psNext] & PAINT_QUADRANT_FLAG_BIGGER)
+                return psCache;
+            if (flags[psNext] & PAINT_QUADRANT_FLAG_IDENTICAL)
+                break;
+            ps = psNext;
+        }
+
+        flags[psNext] &= ~PAINT_QUADRANT_FLAG_IDENTICAL;
+        psTemp = ps;
+
+        const uint16_t initial = psNext;
+        const uint32_t row = initial - _rowBase;
+        const uint8_t* masks = row < _rows ? &_masks[row * _columns] : nullptr;
+        if (regular && masks != nullptr && !(_rowAny[row] & (1 << TRotation)))
+        {
+            ps = psTemp;
+            continue;
+        }
+
+        while (true)
+        {
+            ps = psNext;
+            psNext = next[psNext];
+            if (psNext == NO_NODE)
+                break;
+            if (flags[psNext] & PAINT_QUADRANT_FLAG_BIGGER)
+                break;
+            if (!(flags[psNext] & PAINT_QUADRANT_FLAG_NEXT))
+                continue;
+
+            const uint32_t column = psNext - _columnBase;
+            const uint8_t mask = masks != nullptr && column < _columns
+                ? masks[column]
+                : compare_all_rotations(_bounds[initial], _bounds[psNext]);
+            if (mask & (1 << TRotation))
+            {
+                next[ps] = next[psNext];
+                const uint16_t psTemp2 = next[psTemp];
+                next[psTemp] = psNext;
+                next[psNext] = psTemp2;
+                psNext = ps;
+            }
+        }
+
+        ps = psTemp;
+    }
+}
+
+void paint_rotation_batch::arrange(const paint_session& session)
+{
+    _entries.assign(1, NO_NODE);
+    _quadrant.assign(1, 0);
+    _bounds.assign(1, session.PaintHead.bounds);
+    _x.assign(1, session.PaintHead.bounds.x);
+    _y.assign(1, session.PaintHead.bounds.y);
+    _z.assign(1, session.PaintHead.bounds.z);
+    _xEnd.assign(1, session.PaintHead.bounds.x_end);
+    _yEnd.assign(1, session.PaintHead.bounds.y_end);
+    _zEnd.assign(1, session.PaintHead.bounds.z_end);
+    _quadrantStart.clear();
+    _windows = 0;
+    _quantizedWindows = 0;
+    for (auto& order : _orders)
+    {
+        order.clear();
+    }
+    if (session.QuadrantBackIndex == UINT32_MAX)
+    {
+        return;
+    }
+
+    _backIndex = session.QuadrantBackIndex;
+    _initialFlags.assign(1, session.PaintHead.quadrant_flags);
+    for (uint32_t quadrantIndex = session.QuadrantBackIndex; quadrantIndex <= session.QuadrantFrontIndex; quadrantIndex++)
+    {
+        _quadrantStart.push_back((uint32_t)_entries.size());
+        for (const paint_struct* ps = session.Quadrants[quadrantIndex]; ps != nullptr; ps = ps->next_quadrant_ps)
+        {
+            _entries.push_back((uint16_t)((const paint_entry*)ps - session.PaintStructs));
+            _quadrant.push_back(ps->quadrant_index);
+            _bounds.push_back(ps->bounds);
+            _x.push_back(ps->bounds.x);
+            _y.push_back(ps->bounds.y);
+            _z.push_back(ps->bounds.z);
+            _xEnd.push_back(ps->bounds.x_end);
+            _yEnd.push_back(ps->bounds.y_end);
+            _zEnd.push_back(ps->bounds.z_end);
+            _initialFlags.push_back(ps->quadrant_flags);
+        }
+    }
+    // Sentinels so that the window of the last quadrant has a next quadrant
+    _quadrantStart.push_back((uint32_t)_entries.size());
+    _quadrantStart.push_back((uint32_t)_entries.size());
+
+    const uint16_t nodeCount = (uint16_t)_entries.size();
+    for (auto& list : _lists)
+    {
+        list.next.resize(nodeCount);
+        for (uint16_t node = 0; node + 1 < nodeCount; node++)
+        {
+            list.next[node] = node + 1;
+        }
+        list.next[nodeCount - 1] = NO_NODE;
+        list.flags = _initialFlags;
+    }
+
+    uint16_t cache[4];
+    prepare_window(session.QuadrantBackIndex, true);
+    const uint16_t backIndex = session.QuadrantBackIndex & 0xFFFF;
+    cache[0] = arrange_window<0>(0, backIndex, PAINT_QUADRANT_FLAG_NEXT);
+    cache[1] = arrange_window<1>(0, backIndex, PAINT_QUADRANT_FLAG_NEXT);
+    cache[2] = arrange_window<2>(0, backIndex, PAINT_QUADRANT_FLAG_NEXT);
+    cache[3] = arrange_window<3>(0, backIndex, PAINT_QUADRANT_FLAG_NEXT);
+
+    uint32_t quadrantIndex = session.QuadrantBackIndex;
+    while (++quadrantIndex < session.QuadrantFrontIndex)
+    {
+        prepare_window(quadrantIndex, false);
+        cache[0] = arrange_window<0>(cache[0], quadrantIndex & 0xFFFF, 0);
+        cache[1] = arrange_window<1>(cache[1], quadrantIndex & 0xFFFF, 0);
+        cache[2] = arrange_window<2>(cache[2], quadrantIndex & 0xFFFF, 0);
+        cache[3] = arrange_window<3>(cache[3], quadrantIndex & 0xFFFF, 0);
+    }
+
+    for (uint8_t rotation = 0; rotation < 4; rotation++)
+    {
+        const uint16_t* next = _lists[rotation].next.data();
+        for (uint16_t node = next[0]; node != NO_NODE; node = next[node])
+        {
+            _orders[rotation].push_back(_entries[node]);
+        }
+    }
+}
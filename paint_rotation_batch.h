@@ -0,0 +1,93 @@
+/*
+ * Arranges one captured session for all four rotations in a single pass.
+ *
+ * The four arrangements run in lockstep, one quadrant window at a time, on index based copies of the session's list.
+ * Before a window is processed, check_bounding_box<R> is evaluated for every pair of structs the window can compare,
+ * for all four rotations at once from a single load of both bounding boxes. The per-rotation list walks then only look
+ * the results up, and skip scanning the window entirely for structs which can't be moved in front of at that rotation.
+ * The resulting orderings are identical to four separate paint_session_arrange() calls.
+ *
+ * Windows whose bounds span at most 256 units along each axis are evaluated on 8 bit offsets, see
+ * paint_window_compare.h, the others on the full 16 bit values.
+ */
+
+#pragma once
+
+#include "paint.h"
+#include "paint_window_compare.h"
+
+#include <vector>
+
+class paint_rotation_batch
+{
+public:
+    // Session must have its pointers fixed up and not be arranged yet. It is not modified.
+    void arrange(const paint_session& session);
+
+    // Whether windows may be evaluated on quantized bounds, on by default
+    void set_quantize(bool quantize)
+    {
+        _quantize = quantize;
+    }
+
+    // Windows holding structs in the last arrange(), and how many of them were evaluated on quantized bounds
+    size_t windows() const
+    {
+        return _windows;
+    }
+    size_t quantized_windows() const
+    {
+        return _quantizedWindows;
+    }
+
+    // Indices into session.PaintStructs in drawing order, as the last arrange() left them
+    const std::vector<uint16_t>& order(uint8_t rotation) const
+    {
+        return _orders[rotation & 3];
+    }
+
+private:
+    struct rotation_list
+    {
+        std::vector<uint16_t> next;
+        std::vector<uint8_t> flags;
+    };
+
+    void prepare_window(uint32_t quadrantIndex, bool first);
+    bool prepare_window_quantized();
+    template<uint8_t TRotation> uint16_t arrange_window(uint16_t start, uint16_t quadrantIndex, uint8_t flag);
+
+    // Nodes are numbered in the order paint_session_arrange() initially links them: node 0 is the paint head, the rest
+    // follow quadrant by quadrant
+    std::vector<uint16_t> _entries;
+    std::vector<uint16_t> _quadrant;
+    std::vector<paint_struct_bound_box> _bounds;
+    // The same bounds split per coordinate, for evaluating a window's pairs in bulk
+    std::vector<uint16_t> _x;
+    std::vector<uint16_t> _y;
+    std::vector<uint16_t> _z;
+    std::vector<uint16_t> _xEnd;
+    std::vector<uint16_t> _yEnd;
+    std::vector<uint16_t> _zEnd;
+    std::vector<uint8_t> _initialFlags;
+    std::vector<uint32_t> _quadrantStart; // first node of each quadrant, relative to QuadrantBackIndex
+    uint32_t _backIndex = 0;
+    rotation_list _lists[4];
+
+    // Results for the current window: _masks[row * _columns + column] holds bit R set when check_bounding_box<R> holds
+    // for nodes _rowBase + row and _columnBase + column
+    std::vector<uint8_t> _masks;
+    std::vector<uint8_t> _rowAny; // all bits set in a row of _masks
+    uint32_t _rowBase = 0;
+    uint32_t _rows = 0;
+    uint32_t _columnBase = 0;
+    uint32_t _columns = 0;
+
+    // The window's bounds as 8 bit offsets from its smallest value along each axis, indexed by row
+    std::vector<uint8_t> _quantized[6];
+    bool _quantize = true;
+    size_t _windows = 0;
+    size_t _quantizedWindows = 0;
+
+    std::vector<uint16_t> _orders[4];
+};
@@ -0,0 +1,154 @@
+#include "paint_simt.h"
+
+namespace
+{
+    // Four lanes fit the SSE2 registers every x86-64 has, wider vectors would be split up and spilled
+    struct scalar_lanes
+    {
+        static constexpr size_t width = 4;
+        typedef int32_t vec __attribute__((vector_size(width * 4)));
+
+        static vec gather(const int32_t* base, vec index)
+        {
+            vec result;
+            for (size_t lane = 0; lane < width; lane++)
+            {
+                result[lane] = base[index[lane]];
+            }
+            return result;
+        }
+
+        static uint32_t mask(vec lanes)
+        {
+            uint32_t result = 0;
+            for (size_t lane = 0; lane < width; lane++)
+            {
+                result |= (lanes[lane] != 0 ? 1u : 0u) << lane;
+            }
+            return result;
+        }
+    };
+} // namespace
+
+void simt_arrange_scalar(simt_nodes& nodes, const std::vector<simt_session>& sessions)
+{
+    simt_arrange<scalar_lanes>(nodes, sessions);
+}
+
+const char* simt_isa_name(simt_isa isa)
+{
+    switch (isa)
+    {
+        case simt_isa::scalar:
+            return "scalar";
+        case simt_isa::avx2:
+            return "avx2";
+        case simt_isa::avx512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+size_t simt_isa_lanes(simt_isa isa)
+{
+    switch (isa)
+    {
+        case simt_isa::scalar:
+            return 4;
+        case simt_isa::avx2:
+            return 8;
+        case simt_isa::avx512:
+            return 16;
+    }
+    return 1;
+}
+
+bool simt_isa_supported(simt_isa isa)
+{
+    switch (isa)
+    {
+        case simt_isa::scalar:
+            return true;
+#if defined(__x86_64__) || defined(__i386__)
+        case simt_isa::avx2:
+            return __builtin_cpu_supports("avx2");
+        case simt_isa::avx512:
+            return __builtin_cpu_supports("avx512f");
+#else
+        default:
+            return false;
+#endif
+    }
+    return false;
+}
+
+void paint_simt::arrange(paint_session* sessions, size_t count, simt_isa isa)
+{
+    _nodes.next.assign(1, 0);
+    _nodes.flags.assign(1, PAINT_QUADRANT_FLAG_BIGGER);
+    _nodes.quadrant.assign(1, UINT16_MAX);
+    _nodes.xy.assign(1, 0);
+    _nodes.zx.assign(1, 0);
+    _nodes.yz_end.assign(1, 0);
+    _structs.assign(1, nullptr);
+    _sessions.clear();
+
+    auto push = [this](paint_struct* ps) {
+        const paint_struct_bound_box& bounds = ps->bounds;
+        _nodes.next.push_back(0);
+        _nodes.flags.push_back(ps->quadrant_flags);
+        _nodes.quadrant.push_back(ps->quadrant_index);
+        _nodes.xy.push_back(bounds.x | bounds.y << 16);
+        _nodes.zx.push_back(bounds.z | bounds.x_end << 16);
+        _nodes.yz_end.push_back(bounds.y_end | bounds.z_end << 16);
+        _structs.push_back(ps);
+    };
+    for (size_t i = 0; i < count; i++)
+    {
+        paint_session& session = sessions[i];
+        session.PaintHead.next_quadrant_ps = nullptr;
+        if (session.QuadrantBackIndex == UINT32_MAX)
+        {
+            continue;
+        }
+
+        // The quadrants concatenated after the head, as paint_session_arrange() does
+        const int32_t head = (int32_t)_nodes.next.size();
+        push(&session.PaintHead);
+        _nodes.quadrant.back() = 0;
+        for (uint32_t quadrantIndex = session.QuadrantBackIndex; quadrantIndex <= session.QuadrantFrontIndex; quadrantIndex++)
+        {
+            for (paint_struct* ps = session.Quadrants[quadrantIndex]; ps != nullptr; ps = ps->next_quadrant_ps)
+            {
+                _nodes.next.back() = (int32_t)_nodes.next.size();
+                push(ps);
+            }
+        }
+        _sessions.push_back({ head, (int32_t)session.QuadrantBackIndex, (int32_t)session.QuadrantFrontIndex,
+            (uint8_t)(session.CurrentRotation & 3) });
+    }
+    switch (isa)
+    {
+        case simt_isa::scalar:
+            simt_arrange_scalar(_nodes, _sessions);
+            break;
+        case simt_isa::avx2:
+            simt_arrange_avx2(_nodes, _sessions);
+            break;
+        case simt_isa::avx512:
+            simt_arrange_avx512(_nodes, _sessions);
+            break;
+    }
+
+    for (const simt_session& session : _sessions)
+    {
+        paint_struct* ps = _structs[session.head];
+        for (int32_t node = _nodes.next[session.head]; node != 0; node = _nodes.next[node])
+        {
+            ps->next_quadrant_ps = _structs[node];
+            ps = ps->next_quadrant_ps;
+            ps->quadrant_flags = (uint8_t)_nodes.flags[node];
+        }
+        ps->next_quadrant_ps = nullptr;
+    }
+}
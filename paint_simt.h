@@ -0,0 +1,42 @@
+/*
+ * Experimental arranger advancing several sessions in lockstep, one per SIMD lane.
+ *
+ * Arranging a session is a chain of dependent loads, which leaves the vector units idle. With a batch of independent
+ * sessions, such as the columns of a giant screenshot, each lane can chase its own list instead, so that one gather
+ * loads the next node of 8 (AVX2) or 16 (AVX-512) sessions. Lanes whose session is done take the next one from the
+ * batch. See paint_simt_engine.h for how the helper is mapped onto lanes.
+ *
+ * The resulting orders are identical to paint_session_arrange() at each session's CurrentRotation.
+ */
+
+#pragma once
+
+#include "paint.h"
+#include "paint_simt_engine.h"
+
+#include <cstddef>
+#include <vector>
+
+enum class simt_isa
+{
+    scalar, // the same lockstep engine on four lanes, with gathers done one lane at a time
+    avx2,
+    avx512,
+};
+
+const char* simt_isa_name(simt_isa isa);
+size_t simt_isa_lanes(simt_isa isa);
+// Whether both the compiler and the CPU running the benchmark support it
+bool simt_isa_supported(simt_isa isa);
+
+class paint_simt
+{
+public:
+    // Sessions must have their pointers fixed up and not be arranged yet
+    void arrange(paint_session* sessions, size_t count, simt_isa isa);
+
+private:
+    simt_nodes _nodes;
+    std::vector<simt_session> _sessions;
+    std::vector<paint_struct*> _structs; // by node index
+};
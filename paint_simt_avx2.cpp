@@ -0,0 +1,35 @@
+// Compiled with -mavx2, see the Makefile
+#include "paint_simt_engine.h"
+
+#ifdef __AVX2__
+#    include <immintrin.h>
+
+namespace
+{
+    struct avx2_lanes
+    {
+        static constexpr size_t width = 8;
+        typedef int32_t vec __attribute__((vector_size(width * 4)));
+
+        static vec gather(const int32_t* base, vec index)
+        {
+            return (vec)_mm256_i32gather_epi32(base, (__m256i)index, 4);
+        }
+
+        static uint32_t mask(vec lanes)
+        {
+            return (uint32_t)_mm256_movemask_ps((__m256)lanes);
+        }
+    };
+} // namespace
+
+void simt_arrange_avx2(simt_nodes& nodes, const std::vector<simt_session>& sessions)
+{
+    simt_arrange<avx2_lanes>(nodes, sessions);
+}
+#else
+void simt_arrange_avx2(simt_nodes& nodes, const std::vector<simt_session>& sessions)
+{
+    simt_arrange_scalar(nodes, sessions);
+}
+#endif
@@ -0,0 +1,36 @@
+// Compiled with -mavx512f, see the Makefile
+#include "paint_simt_engine.h"
+
+#ifdef __AVX512F__
+#    include <immintrin.h>
+
+namespace
+{
+    struct avx512_lanes
+    {
+        static constexpr size_t width = 16;
+        typedef int32_t vec __attribute__((vector_size(width * 4)));
+
+        static vec gather(const int32_t* base, vec index)
+        {
+            // The unmasked form leaves GCC warning about its uninitialised source operand
+            return (vec)_mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, (__m512i)index, base, 4);
+        }
+
+        static uint32_t mask(vec lanes)
+        {
+            return _mm512_test_epi32_mask((__m512i)lanes, (__m512i)lanes);
+        }
+    };
+} // namespace
+
+void simt_arrange_avx512(simt_nodes& nodes, const std::vector<simt_session>& sessions)
+{
+    simt_arrange<avx512_lanes>(nodes, sessions);
+}
+#else
+void simt_arrange_avx512(simt_nodes& nodes, const std::vector<simt_session>& sessions)
+{
+    simt_arrange_scalar(nodes, sessions);
+}
+#endif
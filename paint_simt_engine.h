@@ -0,0 +1,211 @@
+/*
+ * Lockstep arrangement engine behind paint_simt, included by the translation units compiled for each instruction set.
+ *
+ * Every lane runs paint_arrange_structs_helper_rotation() as a state machine over index based lists: seeking the
+ * window, flagging it, finding the next initial struct and scanning for structs to move in front of it. One step
+ * advances every lane by one list node, whatever state it is in. The node loads of a step are gathers over all lanes,
+ * state changes and the bounding box comparison are vector selects, and only the stores (flags, relinking, loading
+ * the next session into a lane) are done lane by lane.
+ *
+ * Each instruction set provides a lanes type:
+ *
+ *     struct lanes
+ *     {
+ *         static constexpr size_t width;
+ *         typedef int32_t vec __attribute__((vector_size(width * 4)));
+ *         static vec gather(const int32_t* base, vec index);
+ *         static uint32_t mask(vec lanes); // bit per lane, set for lanes that are all ones
+ *     };
+ *
+ * The lanes types differ between the translation units, so each engine instantiation is their own.
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Paint structs of a batch of sessions, index 0 is a sentinel which ends every list
+struct simt_nodes
+{
+    std::vector<int32_t> next;
+    std::vector<int32_t> flags;
+    std::vector<int32_t> quadrant;
+    std::vector<int32_t> xy;     // x | y << 16
+    std::vector<int32_t> zx;     // z | x_end << 16
+    std::vector<int32_t> yz_end; // y_end | z_end << 16
+};
+
+struct simt_session
+{
+    int32_t head;
+    int32_t backIndex;
+    int32_t frontIndex;
+    uint8_t rotation;
+};
+
+void simt_arrange_scalar(simt_nodes& nodes, const std::vector<simt_session>& sessions);
+void simt_arrange_avx2(simt_nodes& nodes, const std::vector<simt_session>& sessions);
+void simt_arrange_avx512(simt_nodes& nodes, const std::vector<simt_session>& sessions);
+
+// Lane states, plain integers as vector operations don't take enumerations
+static constexpr int32_t SIMT_SEEK = 0; // walking to the first struct of the window
+static constexpr int32_t SIMT_FLAG = 1; // setting the flags of the window's structs
+static constexpr int32_t SIMT_FIND = 2; // looking for the next IDENTICAL struct
+static constexpr int32_t SIMT_SCAN = 3; // comparing NEXT structs against it
+static constexpr int32_t SIMT_IDLE = 4; // no session left for the lane
+
+template<typename TLanes> void simt_arrange(simt_nodes& nodes, const std::vector<simt_session>& sessions)
+{
+    using vec = typename TLanes::vec;
+    constexpr size_t width = TLanes::width;
+
+    int32_t* next = nodes.next.data();
+    int32_t* flags = nodes.flags.data();
+    const int32_t* quadrant = nodes.quadrant.data();
+    const int32_t* xy = nodes.xy.data();
+    const int32_t* zx = nodes.zx.data();
+    const int32_t* yzEnd = nodes.yz_end.data();
+
+    constexpr int32_t BIGGER = PAINT_QUADRANT_FLAG_BIGGER;
+    constexpr int32_t IDENTICAL = PAINT_QUADRANT_FLAG_IDENTICAL;
+    constexpr int32_t NEXT = PAINT_QUADRANT_FLAG_NEXT;
+
+    const vec zero = {};
+    vec state = zero + SIMT_IDLE;
+    vec ps = zero;
+    vec psNext = zero;
+    vec psTemp = zero;
+    vec psCache = zero;
+    vec quadrantIndex = zero;
+    vec flag = zero;
+    vec frontIndex = zero;
+    // All ones at rotations which compare the opposite way along x or y than rotation 0 does
+    vec xBefore = zero;
+    vec yBefore = zero;
+    // Bounding box of each lane's initial struct, packed as the nodes are
+    vec initialXy = zero;
+    vec initialZx = zero;
+    vec initialYzEnd = zero;
+
+    size_t pending = 0;
+    auto start = [&](size_t lane) {
+        if (pending == sessions.size())
+        {
+            state[lane] = SIMT_IDLE;
+            return;
+        }
+        const simt_session& session = sessions[pending++];
+        state[lane] = SIMT_SEEK;
+        psNext[lane] = session.head;
+        quadrantIndex[lane] = session.backIndex;
+        flag[lane] = NEXT;
+        frontIndex[lane] = session.frontIndex;
+        xBefore[lane] = session.rotation == 1 || session.rotation == 2 ? -1 : 0;
+        yBefore[lane] = session.rotation == 2 || session.rotation == 3 ? -1 : 0;
+    };
+    for (size_t lane = 0; lane < width; lane++)
+    {
+        start(lane);
+    }
+
+    while (TLanes::mask(state != SIMT_IDLE) != 0)
+    {
+        const vec seek = state == SIMT_SEEK;
+        const vec flagging = state == SIMT_FLAG;
+        const vec find = state == SIMT_FIND;
+        const vec scan = state == SIMT_SCAN;
+
+        // Seeking and scanning advance ps_next, flagging and finding advance ps
+        const vec node = TLanes::gather(next, (seek | scan) ? psNext : ps);
+        const vec nodeQuadrant = TLanes::gather(quadrant, node);
+        const vec nodeFlags = TLanes::gather(flags, node);
+        const vec nodeXy = TLanes::gather(xy, node);
+        const vec nodeZx = TLanes::gather(zx, node);
+        const vec nodeYzEnd = TLanes::gather(yzEnd, node);
+
+        const vec bigger = (nodeFlags & BIGGER) != 0;
+        const vec identical = (nodeFlags & IDENTICAL) != 0;
+        const vec nextFlag = (nodeFlags & NEXT) != 0;
+
+        const vec windowFound = seek & (quadrantIndex <= nodeQuadrant);
+        const vec flagged = nodeQuadrant >= quadrantIndex;
+        const vec pastWindow = nodeQuadrant > quadrantIndex + 1;
+        const vec newFlags = pastWindow ? zero + BIGGER
+                                        : (nodeQuadrant == quadrantIndex + 1 ? zero + (NEXT | IDENTICAL) : flag | IDENTICAL);
+        const vec storeFlags = flagging & flagged;
+        const vec flagsDone = flagging & pastWindow;
+        const vec windowDone = find & bigger;
+        const vec initialFound = find & ~bigger & identical;
+        const vec scanDone = scan & bigger;
+
+        // check_bounding_box<R> for every lane's rotation, with the x and y comparisons inverted where R needs it
+        const vec x = nodeXy & 0xFFFF;
+        const vec y = (nodeXy >> 16) & 0xFFFF;
+        const vec z = nodeZx & 0xFFFF;
+        const vec xEnd = (nodeZx >> 16) & 0xFFFF;
+        const vec yEnd = nodeYzEnd & 0xFFFF;
+        const vec zEnd = (nodeYzEnd >> 16) & 0xFFFF;
+        const vec initialX = initialXy & 0xFFFF;
+        const vec initialY = (initialXy >> 16) & 0xFFFF;
+        const vec initialZ = initialZx & 0xFFFF;
+        const vec initialXEnd = (initialZx >> 16) & 0xFFFF;
+        const vec initialYEnd = initialYzEnd & 0xFFFF;
+        const vec initialZEnd = (initialYzEnd >> 16) & 0xFFFF;
+        const vec overlap = (initialZEnd >= z) & ((initialYEnd >= y) ^ yBefore) & ((initialXEnd >= x) ^ xBefore);
+        const vec inside = (initialZ < zEnd) & ((initialY < yEnd) ^ yBefore) & ((initialX < xEnd) ^ xBefore);
+        const vec swap = scan & ~bigger & nextFlag & overlap & ~inside;
+
+        const vec oldPs = ps;
+        const vec oldPsNext = psNext;
+        ps = seek ? oldPsNext
+                  : (flagging ? (pastWindow ? psTemp : node)
+                              : (find ? (bigger | identical ? oldPs : node) : (scan ? (bigger ? psTemp : oldPsNext) : oldPs)));
+        psNext = seek | find ? node : (scan ? (swap ? oldPsNext : node) : oldPsNext);
+        psCache = windowFound ? oldPsNext : psCache;
+        psTemp = windowFound ? oldPsNext : (initialFound ? oldPs : psTemp);
+        initialXy = initialFound ? nodeXy : initialXy;
+        initialZx = initialFound ? nodeZx : initialZx;
+        initialYzEnd = initialFound ? nodeYzEnd : initialYzEnd;
+        state = windowFound ? zero + SIMT_FLAG
+                            : (flagsDone | scanDone ? zero + SIMT_FIND : (initialFound ? zero + SIMT_SCAN : state));
+
+        // The next window starts from the cached node, with flag 0 after the first one
+        quadrantIndex = windowDone ? quadrantIndex + 1 : quadrantIndex;
+        flag = windowDone ? zero : flag;
+        psNext = windowDone ? psCache : psNext;
+        state = windowDone ? zero + SIMT_SEEK : state;
+        const vec sessionDone = windowDone & (quadrantIndex >= frontIndex);
+
+        uint32_t work = TLanes::mask(storeFlags | initialFound | swap | sessionDone);
+        while (work != 0)
+        {
+            const size_t lane = __builtin_ctz(work);
+            work &= work - 1;
+            const int32_t n = node[lane];
+            if (storeFlags[lane])
+            {
+                flags[n] = newFlags[lane];
+            }
+            else if (initialFound[lane])
+            {
+                flags[n] &= ~IDENTICAL;
+            }
+            else if (swap[lane])
+            {
+                const int32_t before = ps[lane];
+                const int32_t front = psTemp[lane];
+                next[before] = next[n];
+                next[n] = next[front];
+                next[front] = n;
+            }
+            else
+            {
+                start(lane);
+            }
+        }
+    }
+}
@@ -10,8 +10,14 @@
  * Make sure you have Google benchmark installed and available.
  * Compile this with... Warning, the output of the screenshot command may be large and require lots of RAM to compile
  *
- *     g++ paint_struct_benchmark.cpp -Wall -Wextra -Wno-missing-field-initializers -lbenchmark \
- *         -g -O2 -o paint_struct_bench -DSESSION_FILE=\"out\" -std=c++17 -O2
+ *     make SESSION_FILE=out
+ *
+ * (see the Makefile for the objects and libraries it links).
+ *
+ * To keep the memory needed by the compiler in check, and to use all your cores, split the capture into shards which
+ * get compiled as separate translation units (see corpus_tool.cpp):
+ *
+ *     make SESSION_FILE=out SHARDS=16 -j"$(nproc)"
  *
  * You can limit amount of data provided to compilation when not doing real benchmark, but just playing around by providing
  * only a few paint sessions. The provided data (out.gz) contains values extracted from the "dome" park
@@ -36,457 +42,2109 @@
  *     ----------------------------------------------------------------
  *     BM_paint_session_arrange        945 ns        825 ns     872513
  *
- * Play with code, compiler and benchmark options.
+ * Play with code, compiler and benchmark options. What gets measured can be chosen at runtime, see --help. E.g.
+ *
+ *     ./paint_struct_bench --corpus=out.gz --sessions=100-119 --rotations=0-3 --arrangers=all --threads=1,4 --format=json
+ *
+ * loads the capture without compiling it in and measures arranging sessions 100 to 119 at every rotation, with all
+ * arranger implementations, on one and four threads. --once arranges the selection a single time, for profilers.
+ *
+ * Large captures can be converted into an indexed corpus, of which only the sessions selected by --sessions and
+ * --where (conditions on struct count, quadrant range and zoom) are read:
+ *
+ *     ./corpus_tool index out.idx out.gz
+ *     ./paint_struct_bench --corpus=out.idx --where='structs>=1500,quadrants<40' --per-session
+ *
+ * Indexed corpora are stored in independently compressed blocks of sessions, read in parallel. --load measures reading
+ * a whole one on each of --threads, in GB/s of decoded session encoding:
+ *
+ *     ./corpus_tool index --block=8 out.idx out.gz
+ *     ./paint_struct_bench --load=out.idx --threads=1,2,4,8
+ *
+ * To guard against regressions, store a baseline and compare later builds against it. The gate measures every session
+ * separately, with hardware counters where available, and exits with failure listing the sessions that got slower:
+ *
+ *     ./paint_struct_bench --corpus=out.gz --save-baseline=baseline.json
+ *     ./paint_struct_bench --corpus=out.gz --baseline=baseline.json --threshold=5
+ *
+ * Most quadrant windows hold structs which are already in order, e.g. strips of terrain. --window-skip measures an
+ * arranger which rules such windows out from the extremes of their bounding boxes, after checking its orders against
+ * baseline, and reports the share of windows it skipped:
+ *
+ *     ./paint_struct_bench --corpus=out.gz --window-skip --rotations=0-3
+ *
+ * Attached sprites share PaintStructs with the structs arrangement walks. --pools arranges sessions with a pool per
+ * entry type instead, next to baseline, and reports the memory both layouts take. It needs a capture with attached
+ * structs, which corpus_tool can add:
+ *
+ *     ./corpus_tool attach 0.5 out.attached out.gz
+ *     ./paint_struct_bench --corpus=out.attached --pools
+ *
+ * --sprites draws arranged sessions with sprites, generated locally and stored run length encoded like the game's,
+ * through a cache of decoded sprites of each given size shared by the drawing threads, and reports its hit rate:
+ *
+ *     ./paint_struct_bench --corpus=out.attached --sprites=0,64,1024 --threads=1,4
+ *
+ * --draw-batch adds the same draws reordered into runs of the same sprite, only ever swapping draws whose rectangles
+ * don't intersect (see draw_batch.h), checked to give an identical picture.
+ *
+ * --draw-bins draws one session at a time on all of --threads instead, its framebuffer split into square bins of each
+ * given size which are drawn concurrently (see draw_bins.h), checked against drawing the session serially:
+ *
+ *     ./paint_struct_bench --corpus=out.attached --draw-bins=64,128 --sprites=4096 --threads=1,2,4,8
+ *
+ * --remap blits the recoloured sprites of the arranged selection through their palette remap tables (see
+ * palette_remap.h), once for each instruction set the CPU supports, next to blitting them without remapping; the
+ * rates are recoloured pixels written:
+ *
+ *     ./paint_struct_bench --corpus=out.attached --remap
+ *
+ * --simt measures an experimental arranger which gives each SIMD lane a session of its own and advances them all in
+ * lockstep, gathering the next node of 8 or 16 sessions at once, against a pool of threads each arranging whole
+ * sessions:
+ *
+ *     ./paint_struct_bench --corpus=out.gz --simt --threads=1,4
+ *
+ * Captures are tagged with the zoom level they were taken at, and corpus_tool can derive more zoomed out ones. Load
+ * several and --zoom-matrix reports the cost of arranging a session at each level, next to how densely populated
+ * its sessions and quadrants are:
+ *
+ *     ./corpus_tool zoom 2 out.zoom2 out.gz
+ *     ./paint_struct_bench --corpus=out.gz --corpus=out.zoom2 --zoom-matrix --arrangers=all
+ *
+ * Averages hide the frames that take too long. --frame-budget replays the selection as a sequence of frames and counts
+ * the ones whose arrangement doesn't fit its share of the frame time, here with frames of eight columns arranged on one
+ * and on four threads:
+ *
+ *     ./paint_struct_bench --corpus=out.gz --frame-budget=60,144 --arrange-fraction=0.2 --frame-sessions=8 --threads=1,4
+ *
+ * --pipeline measures replaying frames (e.g. from `corpus_tool animate`) through arrangement and a stand-in drawing
+ * stage, sequentially and with arrangement of the next frame overlapping drawing of the current one:
+ *
+ *     ./paint_struct_bench --corpus=frames --pipeline
+ *
+ * --viewports arranges a main viewport (the largest selected session) together with smaller window viewports taken
+ * from across the range of session sizes, serially and concurrently, reporting the main viewport's latency:
+ *
+ *     ./paint_struct_bench --corpus=out.gz --corpus=out.zoom2 --viewports=6 --threads=2,4
+ *
+ * On multi-socket machines --numa compares arranging the selection on a set of workers spread over the NUMA nodes
+ * with the sessions placed naively, by first touch from their worker, or bound to its node, and reports the share of
+ * session memory that ended up remote:
+ *
+ *     ./paint_struct_bench --corpus=out.gz --numa --threads="$(nproc)"
+ *
+ * How well an arranger holds up next to memory hungry neighbours is measured with --interference, which runs
+ * antagonist threads streaming through memory, chasing pointers or thrashing the last level cache while arranging,
+ * and summarises the slowdown against running alone:
+ *
+ *     ./paint_struct_bench --corpus=out.gz --interference=stream,thrash --antagonist-threads=2 --arrangers=all
+ *
+ * Sessions can also be streamed in from another process over a shared memory ring, with corpus_tool standing in
+ * for the game. --live arranges them as they arrive and reports the time spent waiting, decoding and arranging:
+ *
+ *     ./corpus_tool replay /paint-live out.gz 120 &
+ *     ./paint_struct_bench --live=/paint-live --arrangers=all
+ *
+ * With --record the live sessions are kept as a frame recording, with the times they arrived and the viewport they
+ * cover. --replay feeds a recording to the arrangers as fast as they go and at the recorded times, reporting
+ * throughput and how long frames wait behind each other when the recording comes in bursts:
+ *
+ *     ./paint_struct_bench --live=/paint-live --record=gameplay.frames
+ *     ./paint_struct_bench --replay=gameplay.frames --arrangers=all
+ *
+ * Every allocation goes through counting operator new and delete. --memory reports heap use, resident set size and
+ * page faults for each phase of working with the selection (loading, copying and fixing up, arranging, tearing down),
+ * and adds heap allocations and peak heap use to the results of whichever benchmarks are selected:
+ *
+ *     ./paint_struct_bench --corpus=out.gz --memory --pipeline
  */
 
+#include "antagonists.h"
+#include "arrangers.h"
+#include "corpus_index.h"
+#include "draw_batch.h"
+#include "draw_bins.h"
+#include "frame_budget.h"
+#include "frame_pipeline.h"
+#include "frame_replay.h"
+#include "job_pool.h"
+#include "live_capture.h"
+#include "memory_accounting.h"
+#include "numa_placement.h"
+#include "paint.h"
+#include "paint_draw.h"
+#include "paint_pools.h"
+#include "paint_rotation_batch.h"
+#include "paint_simt.h"
+#include "paint_window_skip.h"
+#include "perf_counters.h"
+#include "regression_gate.h"
+#include "session_corpus.h"
+#include "viewport_arrange.h"
+
+#include <algorithm>
+#include <atomic>
 #include <benchmark/benchmark.h>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iterator>
-#define MAX_PAINT_QUADRANTS 512
-#define assert_struct_size(x, y) static_assert(sizeof(x) == (y), "Improper struct size")
-
-#ifndef SESSION_FILE
-#    define SESSION_FILE "out-min"
-#endif
-
-struct SurfaceElement;
-struct PathElement;
-struct TrackElement;
-struct SmallSceneryElement;
-struct LargeSceneryElement;
-struct WallElement;
-struct EntranceElement;
-struct BannerElement;
-struct CorruptElement;
-
-struct TileElementBase
-{
-    uint8_t type;             // 0
-    uint8_t flags;            // 1
-    uint8_t base_height;      // 2
-    uint8_t clearance_height; // 3
-
-    uint8_t GetType() const;
-    void SetType(uint8_t newType);
-    uint8_t GetDirection() const;
-    void SetDirection(uint8_t direction);
-    uint8_t GetDirectionWithOffset(uint8_t offset) const;
-    bool IsLastForTile() const;
-    bool IsGhost() const;
-    void Remove();
-};
+#include <map>
+#include <memory>
+#include <numeric>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void BM_paint_session_arrange(benchmark::State& state)
+{
+    std::set<int> data;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const size_t sessionCount = session_corpus_size();
+        paint_session* local_s = new paint_session[sessionCount];
+        session_corpus_copy(local_s, 0, sessionCount);
+        fixup_pointers(local_s, sessionCount, std::size(local_s->PaintStructs), std::size(local_s->Quadrants));
+        state.ResumeTiming();
+        paint_session_arrange(local_s);
+        state.PauseTiming();
+        delete[] local_s;
+        state.ResumeTiming();
+    }
+}
 
-enum class TileElementType : uint8_t
-{
-    Surface = (0 << 2),
-    Path = (1 << 2),
-    Track = (2 << 2),
-    SmallScenery = (3 << 2),
-    Entrance = (4 << 2),
-    Wall = (5 << 2),
-    LargeScenery = (6 << 2),
-    Banner = (7 << 2),
-    Corrupt = (8 << 2),
+struct bench_options
+{
+    std::vector<const char*> corpora;
+    std::vector<size_t> sessions;
+    session_filter where; // conditions on the stats of the selected sessions
+    std::vector<uint8_t> rotations{ 0 };
+    std::vector<const paint_arranger*> arrangers;
+    std::vector<int> threads{ 1 };
+    session_reset reset = session_reset::copy;
+    bool perSession = false;
+    bool perfCounters = false;
+    bool rotationBatch = false;
+    bool windowSkip = false;
+    bool pools = false;
+    bool sprites = false;
+    std::vector<size_t> spriteCaches{ 0, 256, 4096 }; // KiB
+    bool drawBatch = false;
+    std::vector<size_t> drawBins; // bin sizes in pixels
+    bool simt = false;
+    bool remap = false;
+    const char* live = nullptr; // shared memory ring to consume sessions from
+    double liveTimeout = 30;
+    const char* record = nullptr; // frame recording written from the live sessions
+    const char* replay = nullptr; // frame recording to replay
+    const char* load = nullptr;   // indexed corpus whose loading is measured
+    std::vector<replay_pace> paces{ replay_pace::fast, replay_pace::recorded };
+    bool zoomMatrix = false;
+    bool frameBudget = false;
+    bool pipeline = false;
+    size_t viewports = 0; // windows arranged along with the main viewport
+    bool numa = false;
+    std::vector<antagonist_kind> antagonists; // besides running alone
+    size_t antagonistThreads = 1;
+    bool memory = false;
+    frame_budget_options frames;
+    bool once = false;
+    const char* baseline = nullptr;
+    const char* saveBaseline = nullptr;
+    gate_thresholds thresholds;
+    bool selected = false; // anything beyond the corpus was chosen on the command line
 };
 
-/**
- * Map element structure
- * size: 0x08
- */
-struct TileElement : public TileElementBase
+static void print_usage(const char* argv0)
+{
+    std::printf(
+        "Usage: %s [options] [benchmark options]\n"
+        "\n"
+        "  --corpus=FILE         load sessions from a capture (plain, gzip or indexed, see corpus_tool index) instead\n"
+        "                        of the compiled in ones, can be repeated to load several\n"
+        "  --sessions=LIST       sessions to arrange, e.g. 0-9,17 (default: all)\n"
+        "  --where=CONDITIONS    only those of the sessions whose stats meet all conditions, e.g.\n"
+        "                        'structs>=1000,quadrants<64,zoom=0' (quoted for the shell) on structs, back, front,\n"
+        "                        quadrants (the range) and zoom\n"
+        "  --per-session         measure each selected session separately\n"
+        "  --rotations=LIST      rotations to arrange at, 0-3 (default: 0)\n"
+        "  --arrangers=LIST      arranger implementations, or \"all\" (default: baseline)\n"
+        "  --threads=LIST        thread counts, each thread arranging its own copy (default: 1)\n"
+        "  --reset=MODE          copy: copy and fix up sessions between iterations (default)\n"
+        "                        links: only restore the links modified by arrangement\n"
+        "  --format=FORMAT       console, json or csv\n"
+        "  --perf-counters       also report hardware counters per arrangement, where the system allows it\n"
+        "  --rotation-batch      compare arranging the selection at all four rotations in one pass against four\n"
+        "                        separate arrangements, with windows evaluated on bounds quantized to 8 bits where they\n"
+        "                        fit and on the full 16 bits\n"
+        "  --window-skip         compare baseline against the window-skip arranger at each of --rotations, reporting\n"
+        "                        the share of quadrant windows it skips\n"
+        "  --pools               compare baseline on sessions holding all entries in PaintStructs against sessions with\n"
+        "                        a pool per entry type, on a capture with attached structs (see corpus_tool attach)\n"
+        "  --sprites[=LIST]      draw the arranged selection with generated sprites, decoded through caches of the\n"
+        "                        given sizes in KiB shared by each of --threads (default: 0,256,4096, 0 decoding on\n"
+        "                        every draw), reporting hit rates\n"
+        "  --draw-batch          with --sprites, also draw with the draws reordered into runs of the same sprite where\n"
+        "                        that can't change the picture\n"
+        "  --draw-bins[=LIST]    with --sprites, also draw each session on all of --threads, split into square bins of\n"
+        "                        the given sizes in pixels (default: 128)\n"
+        "  --remap               blit the recoloured sprites of the selection with palette remapping, for each\n"
+        "                        instruction set the CPU supports, and without\n"
+        "  --simt                arrange the selection with sessions advancing in lockstep in SIMD lanes, for each\n"
+        "                        instruction set the CPU supports, against a pool of each of --threads arranging\n"
+        "                        sessions concurrently\n"
+        "  --frame-budget[=HZ]   replay the selection as frames and count those whose arrangement misses its budget at\n"
+        "                        the given refresh rates (default: 60,144), with each of --threads\n"
+        "  --arrange-fraction=F  share of the frame time given to arrangement (default: 0.25)\n"
+        "  --frame-sessions=N    consecutive sessions making up a frame, arranged in parallel (default: 1)\n"
+        "  --frame-loops=N       times the frame sequence is replayed (default: 3)\n"
+        "  --pipeline            replay the selection as frames which are arranged and drawn, sequentially and with\n"
+        "                        arrangement and drawing of consecutive frames overlapping on two threads\n"
+        "  --viewports[=N]       arrange the largest selected session as the main viewport along with N (default: 5)\n"
+        "                        smaller ones as window viewports, serially and concurrently with each of --threads\n"
+        "  --numa                arrange the selection on --threads workers spread over the NUMA nodes, with naive,\n"
+        "                        first touch and explicitly bound session placement\n"
+        "  --interference[=LIST] arrange alone and next to antagonist threads: stream, chase and/or thrash (default:\n"
+        "                        all), and summarise the slowdown\n"
+        "  --antagonist-threads=N  threads per antagonist (default: 1)\n"
+        "  --zoom-matrix         measure the selection grouped by the zoom level of the captures, and summarise the\n"
+        "                        cost per session for each level and arranger\n"
+        "\n"
+        "Regression gate, measures each selected session separately with hardware counters and 5 repetitions:\n"
+        "  --save-baseline=FILE  store the results as a baseline\n"
+        "  --baseline=FILE       compare against a stored baseline, exit with failure on regressions\n"
+        "  --threshold=PERCENT   smallest slowdown considered a regression (default: 5)\n"
+        "  --noise-sigmas=N      slowdowns within N standard deviations of the noise are ignored (default: 3)\n"
+        "\n"
+        "  --live=RING           arrange sessions streamed over a shared memory ring (see corpus_tool replay) with\n"
+        "                        each of --arrangers at the first of --rotations, until the producer is done\n"
+        "  --live-timeout=S      seconds to wait for the producer to create the ring (default: 30)\n"
+        "  --record=FILE         with --live, also record the sessions with their arrival times and viewports\n"
+        "  --replay=FILE         replay a frame recording (see --record and corpus_tool record) through each of\n"
+        "                        --arrangers, reporting throughput and frame latency\n"
+        "  --replay-pace=LIST    fast: each frame as soon as the previous one is done, recorded: at the recorded\n"
+        "                        times (default: fast,recorded)\n"
+        "  --load=FILE           measure reading a whole indexed corpus into memory on each of --threads, in GB/s of\n"
+        "                        decoded session encoding\n"
+        "  --memory              report heap, resident memory and page faults per phase, and heap use of the selected\n"
+        "                        benchmarks\n"
+        "  --once                arrange the selection once without benchmarking, for use under a profiler\n"
+        "  --list                list arrangers and the sessions available\n"
+        "\n"
+        "Without any selection the classic BM_paint_session_arrange is run. Remaining options are passed to Google\n"
+        "Benchmark, see --help there.\n",
+        argv0);
+}
+
+// Parses "0-3,7" style lists
+static bool parse_list(const char* text, std::vector<size_t>& values)
+{
+    values.clear();
+    const char* pos = text;
+    while (*pos != '\0')
+    {
+        char* end;
+        const size_t first = std::strtoul(pos, &end, 10);
+        if (end == pos)
+        {
+            return false;
+        }
+        size_t last = first;
+        pos = end;
+        if (*pos == '-')
+        {
+            last = std::strtoul(pos + 1, &end, 10);
+            if (end == pos + 1 || last < first)
+            {
+                return false;
+            }
+            pos = end;
+        }
+        for (size_t value = first; value <= last; value++)
+        {
+            values.push_back(value);
+        }
+        if (*pos == ',')
+        {
+            pos++;
+        }
+        else if (*pos != '\0')
+        {
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+// Comma separated values, such as refresh rates of 59.94 Hz
+static bool parse_doubles(const char* text, std::vector<double>& values)
+{
+    values.clear();
+    const char* pos = text;
+    while (*pos != '\0')
+    {
+        char* end;
+        const double value = std::strtod(pos, &end);
+        if (end == pos || !(value > 0))
+        {
+            return false;
+        }
+        values.push_back(value);
+        pos = end;
+        if (*pos == ',')
+        {
+            pos++;
+        }
+        else if (*pos != '\0')
+        {
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+static bool parse_arrangers(const char* text, std::vector<const paint_arranger*>& arrangers)
+{
+    arrangers.clear();
+    if (std::strcmp(text, "all") == 0)
+    {
+        for (size_t i = 0; i < paint_arranger_count(); i++)
+        {
+            arrangers.push_back(&paint_arrangers()[i]);
+        }
+        return true;
+    }
+    std::string names = text;
+    size_t start = 0;
+    while (start <= names.size())
+    {
+        size_t end = names.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = names.size();
+        }
+        const paint_arranger* arranger = paint_arranger_find(names.substr(start, end - start).c_str());
+        if (arranger == nullptr)
+        {
+            std::fprintf(stderr, "Unknown arranger: %s\n", names.substr(start, end - start).c_str());
+            return false;
+        }
+        arrangers.push_back(arranger);
+        start = end + 1;
+    }
+    return true;
+}
+
+// Returns the value of a --name=value option, or nullptr when arg isn't that option
+static const char* option_value(const char* arg, const char* name)
+{
+    const size_t length = std::strlen(name);
+    if (std::strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        return arg + length + 1;
+    }
+    return nullptr;
+}
+
+// Consumes the options handled here, leaving the rest of argv for Google Benchmark
+static bool parse_options(int& argc, char** argv, bench_options& options, std::vector<std::string>& benchmarkArgs)
+{
+    std::vector<size_t> list;
+    int kept = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value;
+        bool ok = true;
+        if ((value = option_value(arg, "--corpus")) != nullptr)
+        {
+            options.corpora.push_back(value);
+        }
+        else if ((value = option_value(arg, "--sessions")) != nullptr)
+        {
+            ok = parse_list(value, options.sessions);
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--where")) != nullptr)
+        {
+            ok = options.where.parse(value);
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--rotations")) != nullptr)
+        {
+            ok = parse_list(value, list);
+            options.rotations.assign(list.begin(), list.end());
+            for (size_t rotation : list)
+            {
+                ok = ok && rotation < 4;
+            }
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--arrangers")) != nullptr)
+        {
+            ok = parse_arrangers(value, options.arrangers);
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--threads")) != nullptr)
+        {
+            ok = parse_list(value, list);
+            options.threads.assign(list.begin(), list.end());
+            for (size_t threads : list)
+            {
+                ok = ok && threads > 0;
+            }
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--reset")) != nullptr)
+        {
+            ok = std::strcmp(value, "copy") == 0 || std::strcmp(value, "links") == 0;
+            options.reset = std::strcmp(value, "links") == 0 ? session_reset::links : session_reset::copy;
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--format")) != nullptr)
+        {
+            ok = std::strcmp(value, "console") == 0 || std::strcmp(value, "json") == 0 || std::strcmp(value, "csv") == 0;
+            benchmarkArgs.push_back(std::string("--benchmark_format=") + value);
+        }
+        else if ((value = option_value(arg, "--baseline")) != nullptr)
+        {
+            options.baseline = value;
+        }
+        else if ((value = option_value(arg, "--save-baseline")) != nullptr)
+        {
+            options.saveBaseline = value;
+        }
+        else if ((value = option_value(arg, "--threshold")) != nullptr)
+        {
+            options.thresholds.relative = std::strtod(value, nullptr) / 100;
+            ok = options.thresholds.relative > 0;
+        }
+        else if ((value = option_value(arg, "--noise-sigmas")) != nullptr)
+        {
+            options.thresholds.sigmas = std::strtod(value, nullptr);
+            ok = options.thresholds.sigmas >= 0;
+        }
+        else if (std::strcmp(arg, "--perf-counters") == 0)
+        {
+            options.perfCounters = true;
+        }
+        else if (std::strcmp(arg, "--rotation-batch") == 0)
+        {
+            options.rotationBatch = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--window-skip") == 0)
+        {
+            options.windowSkip = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--sprites") == 0)
+        {
+            options.sprites = true;
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--sprites")) != nullptr)
+        {
+            ok = parse_list(value, options.spriteCaches);
+            options.sprites = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--draw-batch") == 0)
+        {
+            options.drawBatch = true;
+            options.sprites = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--draw-bins") == 0)
+        {
+            options.drawBins = { 128 };
+            options.sprites = true;
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--draw-bins")) != nullptr)
+        {
+            ok = parse_list(value, options.drawBins);
+            for (size_t size : options.drawBins)
+            {
+                ok = ok && size > 0 && size <= 4096;
+            }
+            options.sprites = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--pools") == 0)
+        {
+            options.pools = true;
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--live")) != nullptr)
+        {
+            options.live = value;
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--live-timeout")) != nullptr)
+        {
+            options.liveTimeout = std::strtod(value, nullptr);
+            ok = options.liveTimeout >= 0;
+        }
+        else if ((value = option_value(arg, "--record")) != nullptr)
+        {
+            options.record = value;
+        }
+        else if ((value = option_value(arg, "--replay")) != nullptr)
+        {
+            options.replay = value;
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--load")) != nullptr)
+        {
+            options.load = value;
+        }
+        else if ((value = option_value(arg, "--replay-pace")) != nullptr)
+        {
+            options.paces.clear();
+            std::string names = value;
+            for (size_t start = 0; ok && start <= names.size();)
+            {
+                const size_t end = std::min(names.find(',', start), names.size());
+                const std::string name = names.substr(start, end - start);
+                ok = name == "fast" || name == "recorded";
+                options.paces.push_back(name == "fast" ? replay_pace::fast : replay_pace::recorded);
+                start = end + 1;
+            }
+        }
+        else if (std::strcmp(arg, "--remap") == 0)
+        {
+            options.remap = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--simt") == 0)
+        {
+            options.simt = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--frame-budget") == 0)
+        {
+            options.frameBudget = true;
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--frame-budget")) != nullptr)
+        {
+            ok = parse_doubles(value, options.frames.rates);
+            options.frameBudget = true;
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--arrange-fraction")) != nullptr)
+        {
+            options.frames.arrangeFraction = std::strtod(value, nullptr);
+            ok = options.frames.arrangeFraction > 0 && options.frames.arrangeFraction <= 1;
+        }
+        else if ((value = option_value(arg, "--frame-sessions")) != nullptr)
+        {
+            options.frames.frameSessions = std::strtoul(value, nullptr, 10);
+            ok = options.frames.frameSessions > 0;
+        }
+        else if ((value = option_value(arg, "--frame-loops")) != nullptr)
+        {
+            options.frames.loops = std::strtoul(value, nullptr, 10);
+            ok = options.frames.loops > 0;
+        }
+        else if (std::strcmp(arg, "--pipeline") == 0)
+        {
+            options.pipeline = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--viewports") == 0)
+        {
+            options.viewports = 5;
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--viewports")) != nullptr)
+        {
+            options.viewports = std::strtoul(value, nullptr, 10);
+            ok = options.viewports > 0;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--numa") == 0)
+        {
+            options.numa = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--interference") == 0)
+        {
+            options.antagonists = { antagonist_kind::stream, antagonist_kind::chase, antagonist_kind::thrash };
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--interference")) != nullptr)
+        {
+            options.antagonists.clear();
+            std::string names = value;
+            for (size_t start = 0; ok && start <= names.size();)
+            {
+                const size_t end = std::min(names.find(',', start), names.size());
+                antagonist_kind kind;
+                ok = antagonist_parse(names.substr(start, end - start).c_str(), kind) && kind != antagonist_kind::none;
+                options.antagonists.push_back(kind);
+                start = end + 1;
+            }
+            options.selected = true;
+        }
+        else if ((value = option_value(arg, "--antagonist-threads")) != nullptr)
+        {
+            options.antagonistThreads = std::strtoul(value, nullptr, 10);
+            ok = options.antagonistThreads > 0;
+        }
+        else if (std::strcmp(arg, "--zoom-matrix") == 0)
+        {
+            options.zoomMatrix = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--per-session") == 0)
+        {
+            options.perSession = true;
+            options.selected = true;
+        }
+        else if (std::strcmp(arg, "--memory") == 0)
+        {
+            options.memory = true;
+        }
+        else if (std::strcmp(arg, "--once") == 0)
+        {
+            options.once = true;
+        }
+        else if (std::strcmp(arg, "--list") == 0 || std::strcmp(arg, "--help") == 0)
+        {
+            // Handled once the corpus is known
+            benchmarkArgs.push_back(arg);
+        }
+        else
+        {
+            argv[kept++] = argv[i];
+        }
+
+        if (!ok)
+        {
+            std::fprintf(stderr, "Invalid option: %s\n", arg);
+            return false;
+        }
+    }
+    argc = kept;
+    return true;
+}
+
+static void list_corpus()
+{
+    std::printf("Arrangers:\n");
+    for (size_t i = 0; i < paint_arranger_count(); i++)
+    {
+        std::printf("  %-20s %s\n", paint_arrangers()[i].name, paint_arrangers()[i].description);
+    }
+    std::printf("Sessions: %zu\n", session_corpus_size());
+}
+
+static void arrange_sessions(benchmark::State& state, const paint_arranger* arranger, std::vector<size_t> sessions,
+    uint8_t rotation, session_reset reset, bool perfCounters)
+{
+    session_set set(sessions, reset);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        set.reset(rotation);
+        state.ResumeTiming();
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            arranger->arrange(&set.data()[i]);
+        }
+    }
+
+    // Counted in a separate pass, so enabling and disabling them doesn't end up in the timings
+    perf_counters counters;
+    if (perfCounters && counters.available())
+    {
+        constexpr int passes = 16;
+        for (int pass = 0; pass < passes; pass++)
+        {
+            set.reset(rotation);
+            counters.start();
+            for (size_t i = 0; i < set.size(); i++)
+            {
+                arranger->arrange(&set.data()[i]);
+            }
+            counters.stop();
+        }
+        for (size_t i = 0; i < counters.size(); i++)
+        {
+            state.counters[counters.name(i)] = benchmark::Counter(
+                (double)counters.value(i) / passes, benchmark::Counter::kAvgThreads);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * set.live_structs());
+    state.counters["sessions"] = benchmark::Counter((double)set.size(), benchmark::Counter::kAvgThreads);
+    state.counters["structs"] = benchmark::Counter((double)set.live_structs(), benchmark::Counter::kAvgThreads);
+}
+
+static void arrange_under_interference(benchmark::State& state, const paint_arranger* arranger,
+    std::vector<size_t> sessions, uint8_t rotation, session_reset reset, antagonist_kind kind, size_t antagonistThreads)
+{
+    antagonist_set antagonists(kind, antagonistThreads);
+    arrange_sessions(state, arranger, std::move(sessions), rotation, reset, false);
+    if (kind != antagonist_kind::none)
+    {
+        // Already bytes per second over the antagonists' own run, not a total for the benchmark to divide
+        state.counters["antagonist_bytes"] = benchmark::Counter(antagonists.stop(), benchmark::Counter::kDefaults,
+            benchmark::Counter::kIs1024);
+    }
+}
+
+static void arrange_rotations_sequential(benchmark::State& state, std::vector<size_t> sessions, session_reset reset)
+{
+    session_set set(sessions, reset);
+    for (auto _ : state)
+    {
+        for (uint8_t rotation = 0; rotation < 4; rotation++)
+        {
+            state.PauseTiming();
+            set.reset(rotation);
+            state.ResumeTiming();
+            for (size_t i = 0; i < set.size(); i++)
+            {
+                paint_session_arrange(&set.data()[i]);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * set.live_structs() * 4);
+}
+
+static void arrange_rotations_batch(benchmark::State& state, std::vector<size_t> sessions, bool quantize)
+{
+    session_set set(sessions, session_reset::copy);
+    paint_rotation_batch batch;
+    batch.set_quantize(quantize);
+    size_t windows = 0;
+    size_t quantizedWindows = 0;
+
+    // Make sure the single pass orders match the sequential ones before measuring it, with every window comparison
+    // kernel the CPU supports, measuring the widest
+    session_set check(sessions, session_reset::links);
+    std::vector<uint16_t> expected;
+    const std::vector<const char*> isas = quantize ? window_compare_isas() : std::vector<const char*>{ nullptr };
+    for (const char* isa : isas)
+    {
+        if (isa != nullptr)
+        {
+            window_compare_select(isa);
+        }
+        for (uint8_t rotation = 0; rotation < 4; rotation++)
+        {
+            check.reset(rotation);
+            for (size_t i = 0; i < set.size(); i++)
+            {
+                paint_session_arrange(&check.data()[i]);
+                paint_session_get_order(check.data()[i], expected);
+                batch.arrange(set.data()[i]);
+                if (rotation == 0 && isa == isas.front())
+                {
+                    windows += batch.windows();
+                    quantizedWindows += batch.quantized_windows();
+                }
+                if (batch.order(rotation) != expected)
+                {
+                    state.SkipWithError(("Order differs for session " + std::to_string(sessions[i]) + " at rotation "
+                                         + std::to_string(rotation) + (isa != nullptr ? std::string(" with ") + isa : ""))
+                                            .c_str());
+                    if (isa != nullptr)
+                    {
+                        window_compare_select(isas.front());
+                    }
+                    return;
+                }
+            }
+        }
+    }
+    if (quantize)
+    {
+        window_compare_select(isas.front());
+    }
+
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            batch.arrange(set.data()[i]);
+        }
+        benchmark::DoNotOptimize(batch.order(3).data());
+    }
+    state.SetItemsProcessed(state.iterations() * set.live_structs() * 4);
+    state.counters["quantized_windows_pct"] = windows == 0 ? 0.0 : 100.0 * quantizedWindows / windows;
+    if (quantize)
+    {
+        state.SetLabel(window_compare_isa());
+    }
+}
+
+static void arrange_window_skip(
+    benchmark::State& state, std::vector<size_t> sessions, uint8_t rotation, session_reset reset)
+{
+    session_set set(sessions, reset);
+
+    // The orders have to match baseline's, and the pass doing so also counts the windows
+    session_set check(sessions, session_reset::links);
+    check.reset(rotation);
+    set.reset(rotation);
+    window_skip_stats_take();
+    std::vector<uint16_t> expected;
+    std::vector<uint16_t> order;
+    for (size_t i = 0; i < set.size(); i++)
+    {
+        paint_session_arrange(&check.data()[i]);
+        paint_session_get_order(check.data()[i], expected);
+        paint_session_arrange_window_skip(&set.data()[i]);
+        paint_session_get_order(set.data()[i], order);
+        if (order != expected)
+        {
+            state.SkipWithError(("Order differs for session " + std::to_string(sessions[i])).c_str());
+            return;
+        }
+    }
+    const window_skip_stats stats = window_skip_stats_take();
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        set.reset(rotation);
+        state.ResumeTiming();
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            paint_session_arrange_window_skip(&set.data()[i]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * set.live_structs());
+    state.counters["windows"] = (double)stats.windows;
+    state.counters["skipped"] = (double)stats.skipped;
+    state.counters["skipped_share"] = stats.windows == 0 ? 0.0 : (double)stats.skipped / stats.windows;
+}
+
+static void arrange_typed_pools(
+    benchmark::State& state, std::vector<size_t> sessions, uint8_t rotation, session_reset reset)
 {
-    uint8_t pad_04[4];
+    session_set check(sessions, reset);
+    pooled_session_set set(sessions);
 
-    template<typename TType, TileElementType TClass> TType* as() const
+    // Same orders as baseline on the union, whose footprint is measured on the way
+    check.reset(rotation);
+    set.reset(rotation);
+    std::vector<uint16_t> expected;
+    std::vector<uint16_t> order;
+    size_t unionSpan = 0;
+    for (size_t i = 0; i < set.size(); i++)
     {
-        return (TileElementType)GetType() == TClass ? (TType*)this : nullptr;
+        paint_session_arrange(&check.data()[i]);
+        paint_session_get_order(check.data()[i], expected);
+        paint_session_arrange(&set.data()[i]);
+        set.get_order(i, order);
+        if (order != expected)
+        {
+            state.SkipWithError(("Order differs for session " + std::to_string(sessions[i])).c_str());
+            return;
+        }
+        if (!expected.empty())
+        {
+            const auto [first, last] = std::minmax_element(expected.begin(), expected.end());
+            unionSpan += (*last - *first + 1) * sizeof(paint_entry);
+        }
+    }
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        set.reset(rotation);
+        state.ResumeTiming();
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            paint_session_arrange(&set.data()[i]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * set.live_structs());
+    state.counters["attached"] = (double)set.attached_structs();
+    // Memory holding the sessions, and the stretch of it holding the structs arrangement walks
+    state.counters["union_bytes"] = (double)(set.size() * sizeof(paint_session));
+    state.counters["pool_bytes"] = (double)set.bytes();
+    state.counters["union_struct_span"] = (double)unionSpan;
+    state.counters["pool_struct_span"] = (double)(set.live_structs() * sizeof(paint_struct));
+}
+
+// Draws the arranged selection at rotation 0, each thread drawing whole sessions, with the sprites looked up in one
+// shared cache. The first pass starts with it empty. Batched draws are checked to leave the same pixels.
+static void draw_sprites(
+    benchmark::State& state, std::vector<size_t> sessions, size_t cacheBytes, int threads, bool batched)
+{
+    session_set set(sessions, session_reset::links);
+    set.reset(0);
+    std::vector<std::vector<draw_command>> commands(set.size());
+    std::vector<paint_framebuffer> framebuffers(set.size());
+    sprite_set sprites;
+    size_t draws = 0;
+    for (size_t i = 0; i < set.size(); i++)
+    {
+        paint_session_arrange(&set.data()[i]);
+        paint_session_draw_commands(set.data()[i], commands[i]);
+        sprite_set_generate(sprites, commands[i]);
+        paint_framebuffer_fit(framebuffers[i], set.data()[i]);
+        draws += commands[i].size();
+    }
+
+    draw_batch_stats batching;
+    if (batched)
+    {
+        sprite_cache check(sprites, sprites.decoded_bytes() * 2);
+        double seconds = 0;
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            paint_framebuffer arranged = framebuffers[i];
+            paint_draw_commands(commands[i], check, arranged);
+            const auto start = std::chrono::steady_clock::now();
+            draw_commands_batch(commands[i], &batching);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            paint_framebuffer batchedFramebuffer = framebuffers[i];
+            paint_draw_commands(commands[i], check, batchedFramebuffer);
+            if (batchedFramebuffer.pixels != arranged.pixels)
+            {
+                state.SkipWithError(("Batched draws differ for session " + std::to_string(sessions[i])).c_str());
+                return;
+            }
+        }
+        state.counters["batch_us"] = seconds / set.size() * 1e6;
+    }
+
+    sprite_cache cache(sprites, cacheBytes);
+    job_pool pool((size_t)threads);
+    std::atomic<uint64_t> pixels{ 0 };
+    for (auto _ : state)
+    {
+        pool.run(set.size(), [&](size_t i) { pixels += paint_draw_commands(commands[i], cache, framebuffers[i]); });
+    }
+    const sprite_cache_stats stats = cache.stats_take();
+    state.SetItemsProcessed(state.iterations() * draws);
+    state.counters["pixels"] = benchmark::Counter((double)pixels, benchmark::Counter::kIsRate);
+    state.counters["hit_rate"] = stats.hit_rate();
+    state.counters["misses"] = (double)stats.misses / state.iterations();
+    state.counters["evictions"] = (double)stats.evictions / state.iterations();
+    state.counters["sprites"] = (double)sprites.size();
+    state.counters["sprite_bytes"] = (double)sprites.decoded_bytes();
+    if (batched)
+    {
+        state.counters["runs_before"] = (double)batching.runs_before;
+        state.counters["runs_after"] = (double)batching.runs_after;
+    }
+}
+
+// Draws the arranged selection at rotation 0 one session after the other, each on all threads by bins of the given
+// size, including the assignment of commands to bins. Binned drawing is checked to leave the same pixels as serial.
+static void draw_binned(benchmark::State& state, std::vector<size_t> sessions, size_t cacheBytes, int binSize, int threads)
+{
+    session_set set(sessions, session_reset::links);
+    set.reset(0);
+    std::vector<std::vector<draw_command>> commands(set.size());
+    std::vector<paint_framebuffer> framebuffers(set.size());
+    sprite_set sprites;
+    size_t draws = 0;
+    for (size_t i = 0; i < set.size(); i++)
+    {
+        paint_session_arrange(&set.data()[i]);
+        paint_session_draw_commands(set.data()[i], commands[i]);
+        sprite_set_generate(sprites, commands[i]);
+        paint_framebuffer_fit(framebuffers[i], set.data()[i]);
+        draws += commands[i].size();
+    }
+
+    job_pool pool((size_t)threads);
+    draw_bins bins;
+    size_t binCount = 0;
+    size_t binDraws = 0;
+    double assignSeconds = 0;
+    {
+        sprite_cache check(sprites, sprites.decoded_bytes() * 2);
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            paint_framebuffer serial = framebuffers[i];
+            const uint64_t serialWritten = paint_draw_commands(commands[i], check, serial);
+            const auto start = std::chrono::steady_clock::now();
+            draw_bins_assign(commands[i], sprites, framebuffers[i], binSize, bins);
+            assignSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            binCount += bins.count();
+            binDraws += bins.commands.size();
+            paint_framebuffer binned = framebuffers[i];
+            const uint64_t binnedWritten = draw_bins_draw(commands[i], bins, check, binned, pool);
+            if (binned.pixels != serial.pixels || binnedWritten != serialWritten)
+            {
+                state.SkipWithError(("Binned draws differ for session " + std::to_string(sessions[i])).c_str());
+                return;
+            }
+        }
+    }
+
+    sprite_cache cache(sprites, cacheBytes);
+    uint64_t pixels = 0;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            draw_bins_assign(commands[i], sprites, framebuffers[i], binSize, bins);
+            pixels += draw_bins_draw(commands[i], bins, cache, framebuffers[i], pool);
+        }
+    }
+    const sprite_cache_stats stats = cache.stats_take();
+    state.SetItemsProcessed(state.iterations() * draws);
+    state.counters["pixels"] = benchmark::Counter((double)pixels, benchmark::Counter::kIsRate);
+    state.counters["hit_rate"] = stats.hit_rate();
+    state.counters["misses"] = (double)stats.misses / state.iterations();
+    state.counters["bins"] = (double)binCount / set.size();
+    // Draws per command, above 1 by the commands crossing bin edges
+    state.counters["bin_draws"] = draws == 0 ? 0.0 : (double)binDraws / draws;
+    state.counters["assign_us"] = assignSeconds / set.size() * 1e6;
+}
+
+// Blits the recoloured draws of the arranged selection at rotation 0 with their sprites decoded beforehand, remapped
+// with the given instruction set or not at all. Remapped pixels are checked against the scalar lookup's.
+static void remap_sprites(benchmark::State& state, std::vector<size_t> sessions, bool remap, remap_isa isa)
+{
+    session_set set(sessions, session_reset::links);
+    set.reset(0);
+    std::vector<std::vector<draw_command>> recoloured(set.size());
+    std::vector<paint_framebuffer> framebuffers(set.size());
+    sprite_set sprites;
+    std::vector<draw_command> commands;
+    size_t draws = 0;
+    for (size_t i = 0; i < set.size(); i++)
+    {
+        paint_session_arrange(&set.data()[i]);
+        paint_session_draw_commands(set.data()[i], commands);
+        sprite_set_generate(sprites, commands);
+        paint_framebuffer_fit(framebuffers[i], set.data()[i]);
+        std::copy_if(commands.begin(), commands.end(), std::back_inserter(recoloured[i]),
+            [](const draw_command& command) { return command.colours != 0; });
+        draws += commands.size();
+    }
+    sprite_cache cache(sprites, sprites.decoded_bytes() * 2);
+    palette_remap_cache remaps(isa);
+    palette_remap_cache* used = remap ? &remaps : nullptr;
+
+    size_t pixels = 0;
+    if (remap)
+    {
+        palette_remap_cache scalar(remap_isa::scalar);
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            paint_framebuffer expected = framebuffers[i];
+            pixels += paint_draw_commands(recoloured[i], cache, expected, &scalar);
+            paint_framebuffer remapped = framebuffers[i];
+            paint_draw_commands(recoloured[i], cache, remapped, &remaps);
+            if (remapped.pixels != expected.pixels)
+            {
+                state.SkipWithError(("Remapped pixels differ for session " + std::to_string(sessions[i])).c_str());
+                return;
+            }
+        }
+        // Every combination of colours again in a cache of its own, to time building the tables alone
+        palette_remap_cache built(isa);
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            for (const draw_command& command : recoloured[i])
+            {
+                built.get(command.colours);
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        state.counters["tables"] = (double)built.size();
+        state.counters["build_us"] = seconds * 1e6;
+        state.SetLabel(remap_isa_name(isa));
+    }
+    else
+    {
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            paint_framebuffer plain = framebuffers[i];
+            pixels += paint_draw_commands(recoloured[i], cache, plain);
+        }
+    }
+
+    size_t recolouredDraws = 0;
+    for (const std::vector<draw_command>& session : recoloured)
+    {
+        recolouredDraws += session.size();
+    }
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            benchmark::DoNotOptimize(paint_draw_commands(recoloured[i], cache, framebuffers[i], used));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * pixels);
+    state.counters["recoloured_pct"] = draws == 0 ? 0.0 : 100.0 * recolouredDraws / draws;
+}
+
+static void arrange_simt(benchmark::State& state, std::vector<size_t> sessions, uint8_t rotation, simt_isa isa)
+{
+    session_set set(sessions, session_reset::copy);
+    paint_simt simt;
+
+    session_set check(sessions, session_reset::links);
+    check.reset(rotation);
+    set.reset(rotation);
+    simt.arrange(set.data(), set.size(), isa);
+    std::vector<uint16_t> expected;
+    std::vector<uint16_t> order;
+    for (size_t i = 0; i < set.size(); i++)
+    {
+        paint_session_arrange(&check.data()[i]);
+        paint_session_get_order(check.data()[i], expected);
+        paint_session_get_order(set.data()[i], order);
+        if (order != expected)
+        {
+            state.SkipWithError(("Order differs for session " + std::to_string(sessions[i])).c_str());
+            return;
+        }
+    }
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        set.reset(rotation);
+        state.ResumeTiming();
+        simt.arrange(set.data(), set.size(), isa);
+    }
+    state.SetItemsProcessed(state.iterations() * set.live_structs());
+    state.counters["lanes"] = (double)simt_isa_lanes(isa);
+}
+
+// The thread parallel way of arranging a batch, one session per job
+static void arrange_pooled(benchmark::State& state, std::vector<size_t> sessions, uint8_t rotation, int threads)
+{
+    session_set set(sessions, session_reset::copy);
+    job_pool pool((size_t)threads);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        set.reset(rotation);
+        state.ResumeTiming();
+        pool.run(set.size(), [&set](size_t i) { paint_session_arrange(&set.data()[i]); });
+    }
+    state.SetItemsProcessed(state.iterations() * set.live_structs());
+}
+
+static void run_pipeline(benchmark::State& state, const paint_arranger* arranger, std::vector<size_t> frames,
+    uint8_t rotation, bool doubleBuffered)
+{
+    frame_pipeline_result result;
+    double totalLatency = 0;
+    double worstLatency = 0;
+    for (auto _ : state)
+    {
+        if (doubleBuffered)
+        {
+            frame_pipeline_double_buffered(frames, *arranger, rotation, result);
+        }
+        else
+        {
+            frame_pipeline_sequential(frames, *arranger, rotation, result);
+        }
+        for (double latency : result.latencies)
+        {
+            totalLatency += latency;
+            worstLatency = std::max(worstLatency, latency);
+        }
+    }
+    const double frameCount = (double)state.iterations() * frames.size();
+    state.counters["frames"] = benchmark::Counter(frameCount, benchmark::Counter::kIsRate);
+    state.counters["latency_us"] = totalLatency / frameCount / 1e3;
+    state.counters["max_latency_us"] = worstLatency / 1e3;
+    state.counters["pixels"] = (double)result.pixels / frames.size();
+}
+
+static void arrange_viewports(benchmark::State& state, const paint_arranger* arranger, std::vector<size_t> sessions,
+    uint8_t rotation, int threads, viewport_schedule schedule)
+{
+    session_set set(sessions, session_reset::links);
+    std::vector<paint_viewport> viewports;
+    for (size_t i = 0; i < set.size(); i++)
+    {
+        // The mix ends with the main viewport
+        viewports.push_back({ &set.data()[i], 0, i + 1 == set.size() });
+    }
+    // The set only knows its total, count each session's own structs
+    for (paint_viewport& viewport : viewports)
+    {
+        for (const paint_struct* head : viewport.session->Quadrants)
+        {
+            for (const paint_struct* ps = head; ps != nullptr; ps = ps->next_quadrant_ps)
+            {
+                viewport.structs++;
+            }
+        }
+    }
+
+    job_pool pool((size_t)threads);
+    double mainLatency = 0;
+    double makespan = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        set.reset(rotation);
+        state.ResumeTiming();
+        paint_viewports_arrange(viewports, *arranger, pool, schedule);
+        double last = 0;
+        for (const paint_viewport& viewport : viewports)
+        {
+            last = std::max(last, viewport.finished);
+        }
+        mainLatency += viewports.back().finished;
+        makespan += last;
+    }
+    state.counters["main_latency_us"] = mainLatency / state.iterations() / 1e3;
+    state.counters["all_done_us"] = makespan / state.iterations() / 1e3;
+    state.counters["viewports"] = (double)viewports.size();
+    state.SetItemsProcessed(state.iterations() * set.live_structs());
+}
+
+static void arrange_numa(benchmark::State& state, const paint_arranger* arranger, std::vector<size_t> sessions,
+    uint8_t rotation, int threads, numa_placement placement)
+{
+    job_pool pool((size_t)threads);
+    numa_session_batch batch(sessions, pool, placement);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        batch.reset(rotation);
+        state.ResumeTiming();
+        batch.arrange(*arranger);
+    }
+    const double remote = batch.remote_page_fraction();
+    state.counters["remote_pages_pct"] = remote < 0 ? -1 : remote * 100;
+    state.counters["nodes"] = (double)numa_node_count();
+    if (batch.bind_failed())
+    {
+        state.SetLabel("mbind unavailable, placed by first touch");
+    }
+    state.SetItemsProcessed(state.iterations() * sessions.size());
+}
+
+// count sessions spread over the range of sizes as windows, smallest first, then the largest selected session as the
+// main viewport. Last, so that the in-order schedule gets to it after all windows, as a game opening them first would.
+static std::vector<size_t> viewport_mix(const std::vector<size_t>& selection, size_t count)
+{
+    std::vector<std::pair<size_t, size_t>> sizes; // live structs, session
+    for (size_t session : selection)
+    {
+        session_set set({ session }, session_reset::copy);
+        sizes.emplace_back(set.live_structs(), session);
+    }
+    std::sort(sizes.begin(), sizes.end());
+    std::vector<size_t> mix;
+    const size_t others = sizes.size() - 1;
+    for (size_t i = 0; i < count && others > 0; i++)
+    {
+        mix.push_back(sizes[count == 1 ? 0 : i * (others - 1) / (count - 1)].second);
+    }
+    mix.push_back(sizes.back().second);
+    return mix;
+}
+
+// Reads a whole indexed corpus, from opening the file to decoded sessions, with its blocks spread over a pool
+static void load_corpus(benchmark::State& state, const char* path, int threads)
+{
+    job_pool pool((size_t)threads);
+    std::unique_ptr<paint_session[]> sessions;
+    std::vector<size_t> selection;
+    uint64_t sessionBytes = 0;
+    for (auto _ : state)
+    {
+        indexed_corpus index;
+        if (!index.open(path))
+        {
+            state.SkipWithError("unreadable corpus");
+            return;
+        }
+        if (selection.size() != index.size())
+        {
+            state.PauseTiming();
+            sessions.reset(new paint_session[index.size()]);
+            selection.resize(index.size());
+            std::iota(selection.begin(), selection.end(), 0);
+            state.ResumeTiming();
+        }
+        if (!index.read(selection, sessions.get(), pool))
+        {
+            state.SkipWithError("malformed corpus");
+            return;
+        }
+        benchmark::DoNotOptimize(sessions.get());
+        sessionBytes = index.session_bytes();
+    }
+    // Throughput is of the uncompressed session encoding, whatever the codec
+    state.SetBytesProcessed((int64_t)(sessionBytes * state.iterations()));
+    state.counters["sessions"] = (double)selection.size();
+}
+
+static void register_load(const bench_options& options)
+{
+    indexed_corpus index;
+    const char* codec = index.open(options.load) ? block_codec_name(index.codec()) : "unreadable";
+    for (int threads : options.threads)
+    {
+        benchmark::RegisterBenchmark(
+            (std::string("load/") + codec + "/threads:" + std::to_string(threads)).c_str(), load_corpus, options.load,
+            threads)
+            ->UseRealTime();
+    }
+}
+
+static void register_benchmarks(const bench_options& options)
+{
+    std::vector<std::vector<size_t>> groups;
+    if (options.perSession)
+    {
+        for (size_t session : options.sessions)
+        {
+            groups.push_back({ session });
+        }
+    }
+    else
+    {
+        groups.push_back(options.sessions);
+    }
+
+    if (options.numa)
+    {
+        for (const paint_arranger* arranger : options.arrangers)
+        {
+            for (uint8_t rotation : options.rotations)
+            {
+                for (int threads : options.threads)
+                {
+                    for (numa_placement placement :
+                         { numa_placement::naive, numa_placement::first_touch, numa_placement::bind })
+                    {
+                        const std::string name = std::string("numa/") + arranger->name + "/rotation:"
+                            + std::to_string(rotation) + "/" + numa_placement_name(placement) + "/threads:"
+                            + std::to_string(threads);
+                        benchmark::RegisterBenchmark(
+                            name.c_str(), arrange_numa, arranger, options.sessions, rotation, threads, placement)
+                            ->UseRealTime();
+                    }
+                }
+            }
+        }
+        return;
     }
 
-public:
-    SurfaceElement* AsSurface() const
+    if (options.viewports != 0)
     {
-        return as<SurfaceElement, TileElementType::Surface>();
+        const std::vector<size_t> mix = viewport_mix(options.sessions, options.viewports);
+        for (const paint_arranger* arranger : options.arrangers)
+        {
+            for (uint8_t rotation : options.rotations)
+            {
+                const std::string name = std::string("viewports/") + arranger->name + "/rotation:" + std::to_string(rotation);
+                benchmark::RegisterBenchmark((name + "/serial").c_str(), arrange_viewports, arranger, mix, rotation, 1,
+                    viewport_schedule::serial)
+                    ->UseRealTime();
+                for (int threads : options.threads)
+                {
+                    for (viewport_schedule schedule : { viewport_schedule::in_order, viewport_schedule::size_aware })
+                    {
+                        benchmark::RegisterBenchmark(
+                            (name + "/" + viewport_schedule_name(schedule) + "/threads:" + std::to_string(threads)).c_str(),
+                            arrange_viewports, arranger, mix, rotation, threads, schedule)
+                            ->UseRealTime();
+                    }
+                }
+            }
+        }
+        return;
     }
-    PathElement* AsPath() const
+
+    if (options.pipeline)
     {
-        return as<PathElement, TileElementType::Path>();
+        for (const paint_arranger* arranger : options.arrangers)
+        {
+            for (uint8_t rotation : options.rotations)
+            {
+                const std::string name = std::string("pipeline/") + arranger->name + "/rotation:" + std::to_string(rotation);
+                benchmark::RegisterBenchmark(
+                    (name + "/sequential").c_str(), run_pipeline, arranger, options.sessions, rotation, false)
+                    ->UseRealTime();
+                benchmark::RegisterBenchmark(
+                    (name + "/double-buffered").c_str(), run_pipeline, arranger, options.sessions, rotation, true)
+                    ->UseRealTime();
+            }
+        }
+        return;
     }
-    TrackElement* AsTrack() const
+
+    if (options.rotationBatch)
     {
-        return as<TrackElement, TileElementType::Track>();
+        for (const auto& group : groups)
+        {
+            std::string suffix = options.perSession ? "/session:" + std::to_string(group.front()) : "";
+            benchmark::RegisterBenchmark(
+                ("rotations/sequential" + suffix).c_str(), arrange_rotations_sequential, group, options.reset);
+            benchmark::RegisterBenchmark(("rotations/batch" + suffix).c_str(), arrange_rotations_batch, group, true);
+            benchmark::RegisterBenchmark(
+                ("rotations/batch/bounds:16" + suffix).c_str(), arrange_rotations_batch, group, false);
+        }
+        return;
     }
-    SmallSceneryElement* AsSmallScenery() const
+
+    if (options.remap)
     {
-        return as<SmallSceneryElement, TileElementType::SmallScenery>();
+        benchmark::RegisterBenchmark("remap/off", remap_sprites, options.sessions, false, remap_isa::scalar)
+            ->UseRealTime();
+        for (remap_isa isa : { remap_isa::scalar, remap_isa::avx2, remap_isa::avx512 })
+        {
+            if (remap_isa_supported(isa))
+            {
+                benchmark::RegisterBenchmark((std::string("remap/") + remap_isa_name(isa)).c_str(), remap_sprites,
+                    options.sessions, true, isa)
+                    ->UseRealTime();
+            }
+        }
+        return;
     }
-    LargeSceneryElement* AsLargeScenery() const
+
+    if (options.simt)
     {
-        return as<LargeSceneryElement, TileElementType::LargeScenery>();
+        for (uint8_t rotation : options.rotations)
+        {
+            const std::string suffix = "/rotation:" + std::to_string(rotation);
+            for (simt_isa isa : { simt_isa::scalar, simt_isa::avx2, simt_isa::avx512 })
+            {
+                if (simt_isa_supported(isa))
+                {
+                    benchmark::RegisterBenchmark((std::string("simt/") + simt_isa_name(isa) + suffix).c_str(),
+                        arrange_simt, options.sessions, rotation, isa)
+                        ->UseRealTime();
+                }
+            }
+            for (int threads : options.threads)
+            {
+                benchmark::RegisterBenchmark(("simt/pool/threads:" + std::to_string(threads) + suffix).c_str(),
+                    arrange_pooled, options.sessions, rotation, threads)
+                    ->UseRealTime();
+            }
+        }
+        return;
     }
-    WallElement* AsWall() const
+
+    if (options.sprites)
     {
-        return as<WallElement, TileElementType::Wall>();
+        for (size_t cache : options.spriteCaches)
+        {
+            for (bool batched : { false, true })
+            {
+                if (batched && !options.drawBatch)
+                {
+                    continue;
+                }
+                for (int threads : options.threads)
+                {
+                    const std::string name = "sprites/cache:" + std::to_string(cache) + "K"
+                        + (batched ? "/batched" : "") + "/threads:" + std::to_string(threads);
+                    benchmark::RegisterBenchmark(
+                        name.c_str(), draw_sprites, options.sessions, cache * 1024, threads, batched)
+                        ->UseRealTime();
+                }
+            }
+            for (size_t binSize : options.drawBins)
+            {
+                for (int threads : options.threads)
+                {
+                    const std::string name = "sprites/cache:" + std::to_string(cache) + "K/bins:" + std::to_string(binSize)
+                        + "/threads:" + std::to_string(threads);
+                    benchmark::RegisterBenchmark(
+                        name.c_str(), draw_binned, options.sessions, cache * 1024, (int)binSize, threads)
+                        ->UseRealTime();
+                }
+            }
+        }
+        return;
     }
-    EntranceElement* AsEntrance() const
+
+    if (options.pools)
     {
-        return as<EntranceElement, TileElementType::Entrance>();
+        for (uint8_t rotation : options.rotations)
+        {
+            for (const auto& group : groups)
+            {
+                std::string suffix = "/rotation:" + std::to_string(rotation);
+                if (options.perSession)
+                {
+                    suffix += "/session:" + std::to_string(group.front());
+                }
+                benchmark::RegisterBenchmark(("pools/union" + suffix).c_str(), arrange_sessions,
+                    paint_arranger_find("baseline"), group, rotation, options.reset, options.perfCounters);
+                benchmark::RegisterBenchmark(
+                    ("pools/typed" + suffix).c_str(), arrange_typed_pools, group, rotation, options.reset);
+            }
+        }
+        return;
     }
-    BannerElement* AsBanner() const
+
+    if (options.windowSkip)
     {
-        return as<BannerElement, TileElementType::Banner>();
+        for (uint8_t rotation : options.rotations)
+        {
+            for (const auto& group : groups)
+            {
+                std::string suffix = "/rotation:" + std::to_string(rotation);
+                if (options.perSession)
+                {
+                    suffix += "/session:" + std::to_string(group.front());
+                }
+                benchmark::RegisterBenchmark(("windows/baseline" + suffix).c_str(), arrange_sessions,
+                    paint_arranger_find("baseline"), group, rotation, options.reset, options.perfCounters);
+                benchmark::RegisterBenchmark(
+                    ("windows/window-skip" + suffix).c_str(), arrange_window_skip, group, rotation, options.reset);
+            }
+        }
+        return;
     }
-    CorruptElement* AsCorrupt() const
+
+    for (const paint_arranger* arranger : options.arrangers)
     {
-        return as<CorruptElement, TileElementType::Corrupt>();
+        for (uint8_t rotation : options.rotations)
+        {
+            for (const auto& group : groups)
+            {
+                std::string name = std::string("arrange/") + arranger->name + "/rotation:" + std::to_string(rotation);
+                if (options.perSession)
+                {
+                    name += "/session:" + std::to_string(group.front());
+                }
+                auto* benchmark = benchmark::RegisterBenchmark(
+                    name.c_str(), arrange_sessions, arranger, group, rotation, options.reset, options.perfCounters);
+                for (int threads : options.threads)
+                {
+                    benchmark->Threads(threads);
+                }
+            }
+        }
     }
+}
 
-    void ClearAs(uint8_t newType);
-};
-assert_struct_size(TileElement, 8);
-
-#pragma pack(push, 1)
-struct paint_struct_bound_box
+struct interference_run
 {
-    uint16_t x;
-    uint16_t y;
-    uint16_t z;
-    uint16_t x_end;
-    uint16_t y_end;
-    uint16_t z_end;
+    std::string name;
+    const paint_arranger* arranger;
+    uint8_t rotation;
+    antagonist_kind kind;
 };
 
-struct attached_paint_struct
+static std::vector<interference_run> register_interference(const bench_options& options)
 {
-    uint32_t image_id; // 0x00
-    union
+    std::vector<antagonist_kind> kinds{ antagonist_kind::none };
+    kinds.insert(kinds.end(), options.antagonists.begin(), options.antagonists.end());
+    std::vector<interference_run> runs;
+    for (const paint_arranger* arranger : options.arrangers)
     {
-        uint32_t tertiary_colour;
-        // If masked image_id is masked_id
-        uint32_t colour_image_id;
-    };
-    uint16_t x;    // 0x08
-    uint16_t y;    // 0x0A
-    uint8_t flags; // 0x0C
-    uint8_t pad_0D;
-    attached_paint_struct* next; // 0x0E
-};
-
-/* size 0x34 */
-struct paint_struct
-{
-    uint32_t image_id; // 0x00
-    union
-    {
-        uint32_t tertiary_colour; // 0x04
-        // If masked image_id is masked_id
-        uint32_t colour_image_id; // 0x04
-    };
-    paint_struct_bound_box bounds; // 0x08
-    uint16_t x;                    // 0x14
-    uint16_t y;                    // 0x16
-    uint16_t quadrant_index;
-    uint8_t flags;
-    uint8_t quadrant_flags;
-    attached_paint_struct* attached_ps; // 0x1C
-    paint_struct* children;
-    paint_struct* next_quadrant_ps; // 0x24
-    uint8_t sprite_type;            // 0x28
-    uint8_t var_29;
-    uint16_t pad_2A;
-    uint16_t map_x;           // 0x2C
-    uint16_t map_y;           // 0x2E
-    TileElement* tileElement; // 0x30 (or sprite pointer)
-};
-
-using rct_string_id = uint16_t;
+        for (uint8_t rotation : options.rotations)
+        {
+            for (antagonist_kind kind : kinds)
+            {
+                std::string name = std::string("interference/") + arranger->name + "/rotation:" + std::to_string(rotation)
+                    + "/" + antagonist_name(kind);
+                benchmark::RegisterBenchmark(name.c_str(), arrange_under_interference, arranger, options.sessions,
+                    rotation, options.reset, kind, options.antagonistThreads);
+                runs.push_back({ std::move(name), arranger, rotation, kind });
+            }
+        }
+    }
+    return runs;
+}
 
-struct paint_string_struct
+static void print_interference(const std::vector<interference_run>& runs, const std::vector<bench_result>& results,
+    size_t antagonistThreads)
 {
-    rct_string_id string_id;   // 0x00
-    paint_string_struct* next; // 0x02
-    uint16_t x;                // 0x06
-    uint16_t y;                // 0x08
-    uint32_t args[4];          // 0x0A
-    uint8_t* y_offsets;        // 0x1A
-};
-#pragma pack(pop)
+    std::map<std::string, double> times;
+    for (const bench_result& result : results)
+    {
+        times[result.name] = result.metrics.at("cpu_time_ns").median;
+    }
 
-union paint_entry
-{
-    paint_struct basic;
-    attached_paint_struct attached;
-    paint_string_struct string;
-};
-static_assert(sizeof(paint_entry) == sizeof(paint_struct), "Invalid size");
+    std::fprintf(stderr, "\nSlowdown next to %zu antagonist thread(s), CPU time of the arranging thread\n\n",
+        antagonistThreads);
+    std::fprintf(stderr, "%-20s %8s %-10s %14s %10s\n", "arranger", "rotation", "antagonist", "time ns", "slowdown");
+    double alone = 0;
+    for (const interference_run& run : runs)
+    {
+        auto time = times.find(run.name);
+        if (time == times.end())
+        {
+            continue;
+        }
+        if (run.kind == antagonist_kind::none)
+        {
+            alone = time->second;
+        }
+        std::fprintf(stderr, "%-20s %8u %-10s %14.0f %9.1f%%\n", run.arranger->name, run.rotation, antagonist_name(run.kind),
+            time->second, alone > 0 ? (time->second / alone - 1) * 100 : 0.0);
+    }
+}
 
-struct paint_session
+struct zoom_level
 {
-    paint_entry PaintStructs[4000];
-    paint_struct* Quadrants[MAX_PAINT_QUADRANTS]; // needed
-    paint_struct PaintHead;                       // needed
-    uint32_t QuadrantBackIndex;                   // needed
-    uint32_t QuadrantFrontIndex;                  // needed
+    uint8_t zoom;
+    std::vector<size_t> sessions;
+    size_t structs = 0;
+    size_t occupiedQuadrants = 0;
+    std::vector<std::string> benchmarks; // per arranger, then rotation
 };
 
-enum PAINT_QUADRANT_FLAGS
+// Groups the selected sessions by the zoom level they were captured at
+static std::vector<zoom_level> zoom_levels(const std::vector<size_t>& sessions)
 {
-    PAINT_QUADRANT_FLAG_IDENTICAL = (1 << 0),
-    PAINT_QUADRANT_FLAG_BIGGER = (1 << 7),
-    PAINT_QUADRANT_FLAG_NEXT = (1 << 1),
-};
-
-uint8_t gCurrentRotation;
+    std::map<uint8_t, zoom_level> levels;
+    for (size_t session : sessions)
+    {
+        levels[session_corpus_zoom(session)].sessions.push_back(session);
+    }
 
-uint8_t get_current_rotation()
-{
-    return gCurrentRotation & 3;
+    std::vector<zoom_level> result;
+    for (auto& entry : levels)
+    {
+        zoom_level& level = entry.second;
+        level.zoom = entry.first;
+        session_set set(level.sessions, session_reset::copy);
+        level.structs = set.live_structs();
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            for (const paint_struct* head : set.data()[i].Quadrants)
+            {
+                level.occupiedQuadrants += head != nullptr;
+            }
+        }
+        result.push_back(std::move(level));
+    }
+    return result;
 }
 
-template<uint8_t> static bool check_bounding_box(const paint_struct_bound_box&, const paint_struct_bound_box&)
+static void register_zoom_matrix(const bench_options& options, std::vector<zoom_level>& levels)
 {
-    return false;
+    for (zoom_level& level : levels)
+    {
+        for (const paint_arranger* arranger : options.arrangers)
+        {
+            for (uint8_t rotation : options.rotations)
+            {
+                std::string name = "zoom:" + std::to_string(level.zoom) + "/" + arranger->name + "/rotation:"
+                    + std::to_string(rotation);
+                benchmark::RegisterBenchmark(
+                    name.c_str(), arrange_sessions, arranger, level.sessions, rotation, options.reset, options.perfCounters);
+                level.benchmarks.push_back(std::move(name));
+            }
+        }
+    }
 }
 
-template<> bool check_bounding_box<0>(const paint_struct_bound_box& initialBBox, const paint_struct_bound_box& currentBBox)
+static void print_zoom_matrix(
+    const bench_options& options, const std::vector<zoom_level>& levels, const std::vector<bench_result>& results)
 {
-    if (initialBBox.z_end >= currentBBox.z && initialBBox.y_end >= currentBBox.y && initialBBox.x_end >= currentBBox.x
-        && !(initialBBox.z < currentBBox.z_end && initialBBox.y < currentBBox.y_end && initialBBox.x < currentBBox.x_end))
+    std::map<std::string, double> times;
+    for (const bench_result& result : results)
     {
-        return true;
+        auto time = result.metrics.find("cpu_time_ns");
+        if (time != result.metrics.end())
+        {
+            times[result.name] = time->second.median;
+        }
     }
-    return false;
-}
 
-template<> bool check_bounding_box<1>(const paint_struct_bound_box& initialBBox, const paint_struct_bound_box& currentBBox)
-{
-    if (initialBBox.z_end >= currentBBox.z && initialBBox.y_end >= currentBBox.y && initialBBox.x_end < currentBBox.x
-        && !(initialBBox.z < currentBBox.z_end && initialBBox.y < currentBBox.y_end && initialBBox.x >= currentBBox.x_end))
+    std::fprintf(stderr, "\nArrange cost per session, averaged over rotations\n\n%-6s %9s %15s %16s", "zoom", "sessions",
+        "structs/session", "structs/quadrant");
+    for (const paint_arranger* arranger : options.arrangers)
     {
-        return true;
+        std::fprintf(stderr, " %15.15s ns", arranger->name);
+    }
+    std::fprintf(stderr, "\n");
+    for (const zoom_level& level : levels)
+    {
+        std::fprintf(stderr, "%-6u %9zu %15.1f %16.2f", level.zoom, level.sessions.size(),
+            (double)level.structs / level.sessions.size(),
+            level.occupiedQuadrants == 0 ? 0.0 : (double)level.structs / level.occupiedQuadrants);
+        for (size_t arranger = 0; arranger < options.arrangers.size(); arranger++)
+        {
+            double total = 0;
+            size_t measured = 0;
+            for (size_t rotation = 0; rotation < options.rotations.size(); rotation++)
+            {
+                auto time = times.find(level.benchmarks[arranger * options.rotations.size() + rotation]);
+                if (time != times.end())
+                {
+                    total += time->second;
+                    measured++;
+                }
+            }
+            if (measured == 0)
+            {
+                std::fprintf(stderr, " %18s", "-");
+            }
+            else
+            {
+                std::fprintf(stderr, " %18.0f", total / measured / level.sessions.size());
+            }
+        }
+        std::fprintf(stderr, "\n");
     }
-    return false;
 }
 
-template<> bool check_bounding_box<2>(const paint_struct_bound_box& initialBBox, const paint_struct_bound_box& currentBBox)
+static void print_memory_phase(const char* phase, const memory_snapshot& before, const memory_snapshot& after)
+{
+    constexpr double mebibyte = 1 << 20;
+    std::fprintf(stderr, "%-22s %10llu %12.2f %12.2f %12.2f %10.1f %10.1f %8llu %6llu\n", phase,
+        (unsigned long long)(after.allocations - before.allocations),
+        (after.allocatedBytes - before.allocatedBytes) / mebibyte, after.liveBytes / mebibyte,
+        (after.peakBytes - before.liveBytes) / mebibyte, after.residentBytes / mebibyte,
+        ((double)after.residentBytes - (double)before.residentBytes) / mebibyte,
+        (unsigned long long)(after.minorFaults - before.minorFaults),
+        (unsigned long long)(after.majorFaults - before.majorFaults));
+}
+
+// Footprint of each phase of working with the selection, for both ways of resetting sessions
+static void report_memory(const bench_options& options, const memory_snapshot& startup, const memory_snapshot& loaded)
 {
-    if (initialBBox.z_end >= currentBBox.z && initialBBox.y_end < currentBBox.y && initialBBox.x_end < currentBBox.x
-        && !(initialBBox.z < currentBBox.z_end && initialBBox.y >= currentBBox.y_end && initialBBox.x >= currentBBox.x_end))
+    std::fprintf(stderr, "%-22s %10s %12s %12s %12s %10s %10s %8s %6s\n", "phase", "allocs", "alloc MiB", "live MiB",
+        "peak +MiB", "RSS MiB", "RSS +MiB", "minflt", "majflt");
+    print_memory_phase("load", startup, loaded);
+
+    size_t liveStructs = 0;
+    for (session_reset reset : { session_reset::copy, session_reset::links })
     {
-        return true;
+        const std::string mode = reset == session_reset::copy ? "copy" : "links";
+        memory_reset_peak();
+        const memory_snapshot start = memory_sample();
+        auto set = std::make_unique<session_set>(options.sessions, reset);
+        const memory_snapshot fixedUp = memory_sample();
+        print_memory_phase((mode + " fixup").c_str(), start, fixedUp);
+
+        memory_reset_peak();
+        for (const paint_arranger* arranger : options.arrangers)
+        {
+            for (uint8_t rotation : options.rotations)
+            {
+                set->reset(rotation);
+                for (size_t i = 0; i < set->size(); i++)
+                {
+                    arranger->arrange(&set->data()[i]);
+                }
+            }
+        }
+        const memory_snapshot arranged = memory_sample();
+        print_memory_phase((mode + " arrange").c_str(), fixedUp, arranged);
+
+        liveStructs = set->live_structs();
+        memory_reset_peak();
+        set.reset();
+        print_memory_phase((mode + " teardown").c_str(), arranged, memory_sample());
     }
-    return false;
+
+    const size_t sessions = options.sessions.size();
+    std::fprintf(stderr, "\n%zu sessions of %.1f KiB each, of which %.1f KiB on average hold reachable paint structs\n",
+        sessions, sizeof(paint_session) / 1024.0, (double)liveStructs * sizeof(paint_struct) / sessions / 1024.0);
 }
 
-template<> bool check_bounding_box<3>(const paint_struct_bound_box& initialBBox, const paint_struct_bound_box& currentBBox)
+static void print_heap_use(const std::vector<bench_result>& results)
 {
-    if (initialBBox.z_end >= currentBBox.z && initialBBox.y_end < currentBBox.y && initialBBox.x_end >= currentBBox.x
-        && !(initialBBox.z < currentBBox.z_end && initialBBox.y >= currentBBox.y_end && initialBBox.x < currentBBox.x_end))
+    std::fprintf(stderr, "\n%-70s %14s %16s\n", "benchmark", "allocs/iter", "peak heap bytes");
+    for (const bench_result& result : results)
     {
-        return true;
+        auto allocs = result.metrics.find("heap_allocs");
+        auto peak = result.metrics.find("heap_peak_bytes");
+        if (allocs != result.metrics.end() && peak != result.metrics.end())
+        {
+            std::fprintf(stderr, "%-70s %14.1f %16.0f\n", result.name.c_str(), allocs->second.median, peak->second.median);
+        }
     }
-    return false;
 }
 
-static_assert(sizeof(paint_struct) == 0x44);
-template<uint8_t _TRotation>
-static paint_struct* paint_arrange_structs_helper_rotation(paint_struct* ps_next, uint16_t quadrantIndex, uint8_t flag)
+static void run_once(const bench_options& options)
 {
-    paint_struct* ps;
-    paint_struct* ps_temp;
-    do
+    session_set set(options.sessions, options.reset);
+    if (options.rotationBatch)
     {
-        ps = ps_next;
-        ps_next = ps_next->next_quadrant_ps;
-        if (ps_next == nullptr)
-            return ps;
-    } while (quadrantIndex > ps_next->quadrant_index);
-
-    // Cache the last visited node so we don't have to walk the whole list again
-    paint_struct* ps_cache = ps;
+        paint_rotation_batch batch;
+        set.reset(0);
+        for (size_t i = 0; i < set.size(); i++)
+        {
+            batch.arrange(set.data()[i]);
+        }
+        return;
+    }
 
-    ps_temp = ps;
-    do
+    for (const paint_arranger* arranger : options.arrangers)
     {
-        ps = ps->next_quadrant_ps;
-        if (ps == nullptr)
-            break;
-
-        if (ps->quadrant_index > quadrantIndex + 1)
+        for (uint8_t rotation : options.rotations)
         {
-            ps->quadrant_flags = PAINT_QUADRANT_FLAG_BIGGER;
+            set.reset(rotation);
+            for (size_t i = 0; i < set.size(); i++)
+            {
+                arranger->arrange(&set.data()[i]);
+            }
         }
-        else if (ps->quadrant_index == quadrantIndex + 1)
+    }
+}
+
+// Loads the corpora and resolves the selection. Indexed corpora only have the selected sessions read, the others
+// are left out of the corpus.
+static bool load_corpora(bench_options& options)
+{
+    const std::set<size_t> requested(options.sessions.begin(), options.sessions.end());
+    for (const char* corpus : options.corpora)
+    {
+        if (!indexed_corpus::detect(corpus))
         {
-            ps->quadrant_flags = PAINT_QUADRANT_FLAG_NEXT | PAINT_QUADRANT_FLAG_IDENTICAL;
+            if (!session_corpus_load(corpus))
+            {
+                return false;
+            }
+            continue;
         }
-        else if (ps->quadrant_index == quadrantIndex)
+        indexed_corpus index;
+        const bool loaded = index.open(corpus)
+            && index.load(
+                [&](size_t session, const session_stats& stats) {
+                    return (requested.empty() || requested.count(session) != 0) && options.where.matches(stats);
+                },
+                std::max(1u, std::thread::hardware_concurrency()));
+        if (!loaded)
         {
-            ps->quadrant_flags = flag | PAINT_QUADRANT_FLAG_IDENTICAL;
+            return false;
         }
-    } while (ps->quadrant_index <= quadrantIndex + 1);
-    ps = ps_temp;
+    }
 
-    while (true)
+    std::map<size_t, bool> selectable; // sessions loaded, and whether they meet --where
+    for (const session_shard& shard : session_corpus_shards())
     {
-        while (true)
+        for (size_t i = 0; i < shard.count; i++)
         {
-            ps_next = ps->next_quadrant_ps;
-            if (ps_next == nullptr)
-                return ps_cache;
-            if (ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_BIGGER)
-                return ps_cache;
-            if (ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_IDENTICAL)
-                break;
-            ps = ps_next;
+            selectable[shard.first + i] = options.where.matches(session_stats_of(shard.sessions[i], shard.zoom));
         }
-
-        ps_next->quadrant_flags &= ~PAINT_QUADRANT_FLAG_IDENTICAL;
-        ps_temp = ps;
-
-        const paint_struct_bound_box& initialBBox = ps_next->bounds;
-
-        while (true)
+    }
+    std::vector<size_t> sessions;
+    for (size_t session : options.sessions)
+    {
+        if (session >= session_corpus_size())
         {
-            ps = ps_next;
-            ps_next = ps_next->next_quadrant_ps;
-            if (ps_next == nullptr)
-                break;
-            if (ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_BIGGER)
-                break;
-            if (!(ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_NEXT))
-                continue;
-
-            const paint_struct_bound_box& currentBBox = ps_next->bounds;
-
-            const bool compareResult = check_bounding_box<_TRotation>(initialBBox, currentBBox);
-
-            if (compareResult)
+            std::fprintf(stderr, "Session %zu out of range, the corpus has %zu\n", session, session_corpus_size());
+            return false;
+        }
+        if (selectable[session])
+        {
+            sessions.push_back(session);
+        }
+    }
+    if (options.sessions.empty())
+    {
+        for (const auto& [session, meets] : selectable)
+        {
+            if (meets)
             {
-                ps->next_quadrant_ps = ps_next->next_quadrant_ps;
-                paint_struct* ps_temp2 = ps_temp->next_quadrant_ps;
-                ps_temp->next_quadrant_ps = ps_next;
-                ps_next->next_quadrant_ps = ps_temp2;
-                ps_next = ps;
+                sessions.push_back(session);
             }
         }
-
-        ps = ps_temp;
     }
-}
-
-paint_struct* paint_arrange_structs_helper(paint_struct* ps_next, uint16_t quadrantIndex, uint8_t flag, uint8_t rotation)
-{
-    switch (rotation)
+    if (sessions.empty())
     {
-        case 0:
-            return paint_arrange_structs_helper_rotation<0>(ps_next, quadrantIndex, flag);
-        case 1:
-            return paint_arrange_structs_helper_rotation<1>(ps_next, quadrantIndex, flag);
-        case 2:
-            return paint_arrange_structs_helper_rotation<2>(ps_next, quadrantIndex, flag);
-        case 3:
-            return paint_arrange_structs_helper_rotation<3>(ps_next, quadrantIndex, flag);
+        std::fprintf(stderr, "No sessions meet --where\n");
+        return false;
     }
-    return nullptr;
+    options.sessions = sessions;
+    return true;
 }
 
-void paint_session_arrange(paint_session* session)
+int main(int argc, char** argv)
 {
-    paint_struct* psHead = &session->PaintHead;
+    bench_options options;
+    std::vector<std::string> benchmarkArgs;
+    if (!parse_options(argc, argv, options, benchmarkArgs))
+    {
+        return EXIT_FAILURE;
+    }
+    for (const auto& arg : benchmarkArgs)
+    {
+        if (arg == "--help")
+        {
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        }
+    }
+    if (options.memory)
+    {
+        memory_accounting_enable();
+    }
+    const memory_snapshot startup = memory_sample();
+    if (!load_corpora(options))
+    {
+        return EXIT_FAILURE;
+    }
+    const memory_snapshot loaded = memory_sample();
+    for (const auto& arg : benchmarkArgs)
+    {
+        if (arg == "--list")
+        {
+            list_corpus();
+            return EXIT_SUCCESS;
+        }
+    }
 
-    paint_struct* ps = psHead;
-    ps->next_quadrant_ps = nullptr;
+    if (options.arrangers.empty())
+    {
+        options.arrangers.push_back(paint_arranger_find("baseline"));
+    }
 
-    uint32_t quadrantIndex = session->QuadrantBackIndex;
-    const uint8_t rotation = get_current_rotation();
-    if (quadrantIndex != UINT32_MAX)
+    if (options.memory)
     {
-        do
+        report_memory(options, startup, loaded);
+        if (!options.selected)
         {
-            paint_struct* ps_next = session->Quadrants[quadrantIndex];
-            if (ps_next != nullptr)
-            {
-                ps->next_quadrant_ps = ps_next;
-                do
-                {
-                    ps = ps_next;
-                    ps_next = ps_next->next_quadrant_ps;
-                } while (ps_next != nullptr);
-            }
-        } while (++quadrantIndex <= session->QuadrantFrontIndex);
+            return EXIT_SUCCESS;
+        }
+    }
+
+    if (options.live != nullptr)
+    {
+        return live_capture_run(
+                   options.live, options.liveTimeout, options.arrangers, options.rotations.front(), options.record)
+            ? EXIT_SUCCESS
+            : EXIT_FAILURE;
+    }
+    if (options.replay != nullptr)
+    {
+        return frame_replay_run(options.replay, options.arrangers, options.paces) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (options.once)
+    {
+        run_once(options);
+        return EXIT_SUCCESS;
+    }
+    if (options.frameBudget)
+    {
+        frame_budget_run(options.frames, options.sessions, options.arrangers, options.threads, options.rotations.front(),
+            options.reset);
+        return EXIT_SUCCESS;
+    }
 
-        paint_struct* ps_cache = paint_arrange_structs_helper(
-            psHead, session->QuadrantBackIndex & 0xFFFF, PAINT_QUADRANT_FLAG_NEXT, rotation);
+    const bool gate = options.baseline != nullptr || options.saveBaseline != nullptr;
+    std::vector<bench_result> baseline;
+    if (options.baseline != nullptr && !gate_load_baseline(options.baseline, baseline))
+    {
+        return EXIT_FAILURE;
+    }
+    std::vector<zoom_level> levels;
+    std::vector<interference_run> interference;
+    if (gate)
+    {
+        options.perSession = true;
+        options.perfCounters = true;
+        register_benchmarks(options);
+    }
+    else if (!options.antagonists.empty())
+    {
+        interference = register_interference(options);
+    }
+    else if (options.zoomMatrix)
+    {
+        levels = zoom_levels(options.sessions);
+        register_zoom_matrix(options, levels);
+    }
+    else if (options.load != nullptr)
+    {
+        register_load(options);
+    }
+    else if (options.selected)
+    {
+        register_benchmarks(options);
+    }
+    else
+    {
+        benchmark::RegisterBenchmark("BM_paint_session_arrange", BM_paint_session_arrange);
+    }
 
-        quadrantIndex = session->QuadrantBackIndex;
-        while (++quadrantIndex < session->QuadrantFrontIndex)
+    // Defaults go first so that they can be overridden on the command line
+    std::vector<std::string> defaultArgs;
+    if (gate)
+    {
+        defaultArgs.push_back("--benchmark_repetitions=5");
+        defaultArgs.push_back("--benchmark_display_aggregates_only=true");
+    }
+    std::vector<char*> args{ argv[0] };
+    for (auto& arg : defaultArgs)
+    {
+        args.push_back(arg.data());
+    }
+    args.insert(args.end(), argv + 1, argv + argc);
+    for (auto& arg : benchmarkArgs)
+    {
+        args.push_back(arg.data());
+    }
+    // Read before Initialize() consumes it, the last one given wins as with Google Benchmark's own parsing
+    std::string format = "console";
+    for (char* arg : args)
+    {
+        if (const char* value = option_value(arg, "--benchmark_format"))
         {
-            ps_cache = paint_arrange_structs_helper(ps_cache, quadrantIndex & 0xFFFF, 0, rotation);
+            format = value;
         }
     }
-}
-paint_session s[] = {
-#include SESSION_FILE
-};
+    int benchmarkArgc = (int)args.size();
+    benchmark::Initialize(&benchmarkArgc, args.data());
+    if (benchmark::ReportUnrecognizedArguments(benchmarkArgc, args.data()))
+    {
+        return EXIT_FAILURE;
+    }
 
-static void fixup_pointers(paint_session* s, size_t paint_session_entries, size_t paint_struct_entries, size_t quadrant_entries)
-{
-    for (size_t i = 0; i < paint_session_entries; i++)
+    heap_memory_manager memoryManager;
+    if (options.memory)
+    {
+        benchmark::RegisterMemoryManager(&memoryManager);
+    }
+
+    int result = EXIT_SUCCESS;
+    if (gate || !interference.empty() || options.zoomMatrix || options.memory)
     {
-        for (size_t j = 0; j < paint_struct_entries; j++)
+        results_reporter reporter(format);
+        benchmark::RunSpecifiedBenchmarks(&reporter);
+        const auto results = reporter.results();
+        if (options.saveBaseline != nullptr && !gate_save_baseline(options.saveBaseline, results))
         {
-            if (s[i].PaintStructs[j].basic.next_quadrant_ps == (paint_struct*)paint_struct_entries)
-            {
-                s[i].PaintStructs[j].basic.next_quadrant_ps = nullptr;
-            }
-            else
-            {
-                s[i].PaintStructs[j].basic.next_quadrant_ps = &s[i].PaintStructs
-                                                                   [(uintptr_t)s[i].PaintStructs[j].basic.next_quadrant_ps]
-                                                                       .basic;
-            }
+            result = EXIT_FAILURE;
         }
-        for (size_t j = 0; j < quadrant_entries; j++)
+        if (options.baseline != nullptr && gate_compare(baseline, results, options.thresholds) != 0)
         {
-            if (s[i].Quadrants[j] == (paint_struct*)quadrant_entries)
-            {
-                s[i].Quadrants[j] = nullptr;
-            }
-            else
-            {
-                s[i].Quadrants[j] = &s[i].PaintStructs[(size_t)s[i].Quadrants[j]].basic;
-            }
+            result = EXIT_FAILURE;
+        }
+        if (!interference.empty())
+        {
+            print_interference(interference, results, options.antagonistThreads);
+        }
+        if (options.zoomMatrix)
+        {
+            print_zoom_matrix(options, levels, results);
+        }
+        if (options.memory)
+        {
+            print_heap_use(results);
         }
     }
-}
-
-#if 0
-int main()
-{
-    fixup_pointers(s, std::size(s), std::size(s->PaintStructs), std::size(s->Quadrants));
-    paint_session_arrange(s);
-    return 0;
-}
-#endif
-
-#if 1
-static void BM_paint_session_arrange(benchmark::State& state)
-{
-    std::set<int> data;
-    for (auto _ : state)
+    else
     {
-        state.PauseTiming();
-        paint_session* local_s = new paint_session[std::size(s)];
-        std::copy_n(s, std::size(s), local_s);
-        fixup_pointers(local_s, std::size(s), std::size(s->PaintStructs), std::size(s->Quadrants));
-        state.ResumeTiming();
-        paint_session_arrange(local_s);
-        state.PauseTiming();
-        delete[] local_s;
-        state.ResumeTiming();
+        benchmark::RunSpecifiedBenchmarks();
     }
+    benchmark::RegisterMemoryManager(nullptr);
+    benchmark::Shutdown();
+    return result;
 }
-BENCHMARK(BM_paint_session_arrange);
-
-BENCHMARK_MAIN();
-#endif
@@ -0,0 +1,70 @@
+#include "paint_window_compare.h"
+
+typedef uint8_t u8x16 __attribute__((vector_size(16)));
+
+void window_compare_u8_sse2(const quantized_box& initial, const quantized_columns& columns, size_t count, uint8_t* masks)
+{
+    window_compare_u8_kernel<u8x16>(initial, columns, count, masks);
+}
+
+using window_compare_function = void (*)(const quantized_box&, const quantized_columns&, size_t, uint8_t*);
+
+struct window_compare_choice
+{
+    const char* isa;
+    window_compare_function function;
+};
+
+// Widest first
+static std::vector<window_compare_choice> supported_window_compares()
+{
+    std::vector<window_compare_choice> choices;
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx512bw"))
+    {
+        choices.push_back({ "avx512", window_compare_u8_avx512 });
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        choices.push_back({ "avx2", window_compare_u8_avx2 });
+    }
+#endif
+    choices.push_back({ "sse2", window_compare_u8_sse2 });
+    return choices;
+}
+
+static const std::vector<window_compare_choice> s_supported = supported_window_compares();
+static window_compare_choice s_choice = s_supported.front();
+
+void window_compare_u8(const quantized_box& initial, const quantized_columns& columns, size_t count, uint8_t* masks)
+{
+    s_choice.function(initial, columns, count, masks);
+}
+
+const char* window_compare_isa()
+{
+    return s_choice.isa;
+}
+
+std::vector<const char*> window_compare_isas()
+{
+    std::vector<const char*> isas;
+    for (const window_compare_choice& choice : s_supported)
+    {
+        isas.push_back(choice.isa);
+    }
+    return isas;
+}
+
+bool window_compare_select(const char* isa)
+{
+    for (const window_compare_choice& choice : s_supported)
+    {
+        if (std::strcmp(choice.isa, isa) == 0)
+        {
+            s_choice = choice;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,113 @@
+/*
+ * Bulk evaluation of check_bounding_box<0..3> for one initial struct against a window's structs, on bounds quantized
+ * to 8 bits.
+ *
+ * Within a quadrant window the bounds span a small range, even though the coordinates themselves are large (the dome
+ * capture sits around x 1800, y 63500). Stored as offsets from the window's smallest value along each axis they fit a
+ * byte in most windows, and a vector register holds 16 (SSE2), 32 (AVX2) or 64 (AVX-512) of them instead of 8, 16 or
+ * 32 uint16 ones. Only values along the same axis are ever compared, so a common offset per axis keeps every
+ * comparison's result.
+ *
+ * The kernel is a template over the vector type, built for each instruction set in its own translation unit and
+ * picked by what the CPU supports on first use. Another one the CPU supports can be selected, so that all of them get
+ * checked.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+struct quantized_box
+{
+    uint8_t x;
+    uint8_t y;
+    uint8_t z;
+    uint8_t x_end;
+    uint8_t y_end;
+    uint8_t z_end;
+};
+
+// Structure of arrays of quantized boxes
+struct quantized_columns
+{
+    const uint8_t* x;
+    const uint8_t* y;
+    const uint8_t* z;
+    const uint8_t* xEnd;
+    const uint8_t* yEnd;
+    const uint8_t* zEnd;
+};
+
+// masks[i] gets bit R set when check_bounding_box<R>(initial, column i) holds
+void window_compare_u8(const quantized_box& initial, const quantized_columns& columns, size_t count, uint8_t* masks);
+// Instruction set window_compare_u8() runs with
+const char* window_compare_isa();
+// Instruction sets the CPU supports, the one picked on first use first
+std::vector<const char*> window_compare_isas();
+// Has window_compare_u8() run with one of window_compare_isas() from now on, returns false for any other. Not safe to
+// call while another thread compares windows.
+bool window_compare_select(const char* isa);
+
+void window_compare_u8_sse2(const quantized_box& initial, const quantized_columns& columns, size_t count, uint8_t* masks);
+void window_compare_u8_avx2(const quantized_box& initial, const quantized_columns& columns, size_t count, uint8_t* masks);
+void window_compare_u8_avx512(
+    const quantized_box& initial, const quantized_columns& columns, size_t count, uint8_t* masks);
+
+// TVec is a GCC vector of uint8_t, of the width of the instruction set's registers
+template<typename TVec>
+void window_compare_u8_kernel(const quantized_box& initial, const quantized_columns& columns, size_t count, uint8_t* masks)
+{
+    using vec = TVec;
+    constexpr size_t width = sizeof(vec);
+
+    const vec zero = {};
+    const vec initialX = zero + initial.x;
+    const vec initialY = zero + initial.y;
+    const vec initialZ = zero + initial.z;
+    const vec initialXEnd = zero + initial.x_end;
+    const vec initialYEnd = zero + initial.y_end;
+    const vec initialZEnd = zero + initial.z_end;
+
+    size_t i = 0;
+    for (; i + width <= count; i += width)
+    {
+        vec x, y, z, xEnd, yEnd, zEnd;
+        std::memcpy(&x, columns.x + i, width);
+        std::memcpy(&y, columns.y + i, width);
+        std::memcpy(&z, columns.z + i, width);
+        std::memcpy(&xEnd, columns.xEnd + i, width);
+        std::memcpy(&yEnd, columns.yEnd + i, width);
+        std::memcpy(&zEnd, columns.zEnd + i, width);
+
+        // Same as compare_all_rotations() in paint_rotation_batch.cpp, with all ones for true
+        const vec zOverlap = (vec)(initialZEnd >= z);
+        const vec zInside = (vec)(initialZ < zEnd);
+        const vec yEndAfter = (vec)(initialYEnd >= y);
+        const vec xEndAfter = (vec)(initialXEnd >= x);
+        const vec yStart = (vec)(initialY < yEnd);
+        const vec xStart = (vec)(initialX < xEnd);
+        const vec r0 = zOverlap & yEndAfter & xEndAfter & ~(zInside & yStart & xStart);
+        const vec r1 = zOverlap & yEndAfter & ~xEndAfter & ~(zInside & yStart & ~xStart);
+        const vec r2 = zOverlap & ~yEndAfter & ~xEndAfter & ~(zInside & ~yStart & ~xStart);
+        const vec r3 = zOverlap & ~yEndAfter & xEndAfter & ~(zInside & ~yStart & xStart);
+        const vec result = (r0 & 1) | (r1 & 2) | (r2 & 4) | (r3 & 8);
+        std::memcpy(masks + i, &result, width);
+    }
+    for (; i < count; i++)
+    {
+        const bool zOverlap = initial.z_end >= columns.z[i];
+        const bool zInside = initial.z < columns.zEnd[i];
+        const bool yEndAfter = initial.y_end >= columns.y[i];
+        const bool xEndAfter = initial.x_end >= columns.x[i];
+        const bool yStart = initial.y < columns.yEnd[i];
+        const bool xStart = initial.x < columns.xEnd[i];
+        const uint8_t r0 = zOverlap & yEndAfter & xEndAfter & !(zInside & yStart & xStart);
+        const uint8_t r1 = zOverlap & yEndAfter & !xEndAfter & !(zInside & yStart & !xStart);
+        const uint8_t r2 = zOverlap & !yEndAfter & !xEndAfter & !(zInside & !yStart & !xStart);
+        const uint8_t r3 = zOverlap & !yEndAfter & xEndAfter & !(zInside & !yStart & xStart);
+        masks[i] = r0 | (r1 << 1) | (r2 << 2) | (r3 << 3);
+    }
+}
@@ -0,0 +1,15 @@
+// Compiled with -mavx2, see the Makefile
+#include "paint_window_compare.h"
+
+#ifdef __AVX2__
+typedef uint8_t u8x32 __attribute__((vector_size(32)));
+#endif
+
+void window_compare_u8_avx2(const quantized_box& initial, const quantized_columns& columns, size_t count, uint8_t* masks)
+{
+#ifdef __AVX2__
+    window_compare_u8_kernel<u8x32>(initial, columns, count, masks);
+#else
+    window_compare_u8_sse2(initial, columns, count, masks);
+#endif
+}
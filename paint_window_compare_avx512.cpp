@@ -0,0 +1,16 @@
+// Compiled with -mavx512bw, see the Makefile
+#include "paint_window_compare.h"
+
+#ifdef __AVX512BW__
+typedef uint8_t u8x64 __attribute__((vector_size(64)));
+#endif
+
+void window_compare_u8_avx512(
+    const quantized_box& initial, const quantized_columns& columns, size_t count, uint8_t* masks)
+{
+#ifdef __AVX512BW__
+    window_compare_u8_kernel<u8x64>(initial, columns, count, masks);
+#else
+    window_compare_u8_sse2(initial, columns, count, masks);
+#endif
+}
@@ -0,0 +1,232 @@
+#include "paint_window_skip.h"
+
+#include <algorithm>
+
+static thread_local window_skip_stats s_stats;
+
+// Smallest and largest value of each bounding box field over a set of structs
+struct bound_box_range
+{
+    paint_struct_bound_box min{ UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX };
+    paint_struct_bound_box max{ 0, 0, 0, 0, 0, 0 };
+    bool empty = true;
+
+    void add(const paint_struct_bound_box& box)
+    {
+        min.x = std::min(min.x, box.x);
+        min.y = std::min(min.y, box.y);
+        min.z = std::min(min.z, box.z);
+        min.x_end = std::min(min.x_end, box.x_end);
+        min.y_end = std::min(min.y_end, box.y_end);
+        min.z_end = std::min(min.z_end, box.z_end);
+        max.x = std::max(max.x, box.x);
+        max.y = std::max(max.y, box.y);
+        max.z = std::max(max.z, box.z);
+        max.x_end = std::max(max.x_end, box.x_end);
+        max.y_end = std::max(max.y_end, box.y_end);
+        max.z_end = std::max(max.z_end, box.z_end);
+        empty = false;
+    }
+};
+
+// Whether check_bounding_box<R>(initial, current) may hold for some initial in the first range and current in the
+// second. Each comparison of check_bounding_box is tested against the most favourable extremes, so false is exact and
+// true only means a pair can't be ruled out.
+template<uint8_t TRotation> static bool may_swap(const bound_box_range& initial, const bound_box_range& current)
+{
+    if (initial.empty || current.empty)
+        return false;
+
+    // Rotations 0 and 3 require the initial box to end after the current one starts along x, 1 and 2 before it
+    constexpr bool xAfter = TRotation == 0 || TRotation == 3;
+    constexpr bool yAfter = TRotation == 0 || TRotation == 1;
+
+    const bool zOverlap = initial.max.z_end >= current.min.z;
+    const bool xEnd = xAfter ? initial.max.x_end >= current.min.x : initial.min.x_end < current.max.x;
+    const bool yEnd = yAfter ? initial.max.y_end >= current.min.y : initial.min.y_end < current.max.y;
+    if (!(zOverlap && xEnd && yEnd))
+        return false;
+
+    // The negated part of check_bounding_box, when it holds for every pair
+    const bool zInside = initial.max.z < current.min.z_end;
+    const bool xStart = xAfter ? initial.max.x < current.min.x_end : initial.min.x >= current.max.x_end;
+    const bool yStart = yAfter ? initial.max.y < current.min.y_end : initial.min.y >= current.max.y_end;
+    return !(zInside && xStart && yStart);
+}
+
+// check_bounding_box<R> is local to paint.cpp, this is the same set of comparisons
+template<uint8_t TRotation> static bool swaps(const paint_struct_bound_box& initial, const paint_struct_bound_box& current)
+{
+    constexpr bool xAfter = TRotation == 0 || TRotation == 3;
+    constexpr bool yAfter = TRotation == 0 || TRotation == 1;
+
+    const bool xEnd = xAfter ? initial.x_end >= current.x : initial.x_end < current.x;
+    const bool yEnd = yAfter ? initial.y_end >= current.y : initial.y_end < current.y;
+    const bool xStart = xAfter ? initial.x < current.x_end : initial.x >= current.x_end;
+    const bool yStart = yAfter ? initial.y < current.y_end : initial.y >= current.y_end;
+    return initial.z_end >= current.z && yEnd && xEnd && !(initial.z < current.z_end && yStart && xStart);
+}
+
+// paint_arrange_structs_helper_rotation() with the window test added to its flagging pass
+template<uint8_t TRotation>
+static paint_struct* paint_arrange_window_skip(paint_struct* ps_next, uint16_t quadrantIndex, uint8_t flag)
+{
+    paint_struct* ps;
+    paint_struct* ps_temp;
+    do
+    {
+        ps = ps_next;
+        ps_next = ps_next->next_quadrant_ps;
+        if (ps_next == nullptr)
+            return ps;
+    } while (quadrantIndex > ps_next->quadrant_index);
+
+    paint_struct* ps_cache = ps;
+    s_stats.windows++;
+
+    // Structs left behind by earlier windows keep their flags, so the ranges go by the flags rather than the quadrant
+    bound_box_range initialRange;
+    bound_box_range currentRange;
+    ps_temp = ps;
+    do
+    {
+        ps = ps->next_quadrant_ps;
+        if (ps == nullptr)
+            break;
+
+        if (ps->quadrant_index > quadrantIndex + 1)
+        {
+            ps->quadrant_flags = PAINT_QUADRANT_FLAG_BIGGER;
+            break;
+        }
+        else if (ps->quadrant_index == quadrantIndex + 1)
+        {
+            ps->quadrant_flags = PAINT_QUADRANT_FLAG_NEXT | PAINT_QUADRANT_FLAG_IDENTICAL;
+        }
+        else if (ps->quadrant_index == quadrantIndex)
+        {
+            ps->quadrant_flags = flag | PAINT_QUADRANT_FLAG_IDENTICAL;
+        }
+        if (ps->quadrant_flags & PAINT_QUADRANT_FLAG_IDENTICAL)
+            initialRange.add(ps->bounds);
+        if (ps->quadrant_flags & PAINT_QUADRANT_FLAG_NEXT)
+            currentRange.add(ps->bounds);
+    } while (true);
+    ps = ps_temp;
+
+    if (!may_swap<TRotation>(initialRange, currentRange))
+    {
+        // Nothing moves, all that the scan would leave behind is the IDENTICAL flags cleared up to the first BIGGER
+        s_stats.skipped++;
+        for (ps = ps->next_quadrant_ps; ps != nullptr && !(ps->quadrant_flags & PAINT_QUADRANT_FLAG_BIGGER);
+             ps = ps->next_quadrant_ps)
+        {
+            ps->quadrant_flags &= ~PAINT_QUADRANT_FLAG_IDENTICAL;
+        }
+        return ps_cache;
+    }
+
+    while (true)
+    {
+        while (true)
+        {
+            ps_next = ps->next_quadrant_ps;
+            if (ps_next == nullptr)
+                return ps_cache;
+            if (ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_BIGGER)
+                return ps_cache;
+            if (ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_IDENTICAL)
+                break;
+            ps = ps_next;
+        }
+
+        ps_next->quadrant_flags &= ~PAINT_QUADRANT_FLAG_IDENTICAL;
+        ps_temp = ps;
+
+        const paint_struct_bound_box& initialBBox = ps_next->bounds;
+
+        while (true)
+        {
+            ps = ps_next;
+            ps_next = ps_next->next_quadrant_ps;
+            if (ps_next == nullptr)
+                break;
+            if (ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_BIGGER)
+                break;
+            if (!(ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_NEXT))
+                continue;
+
+            if (swaps<TRotation>(initialBBox, ps_next->bounds))
+            {
+                ps->next_quadrant_ps = ps_next->next_quadrant_ps;
+                paint_struct* ps_temp2 = ps_temp->next_quadrant_ps;
+                ps_temp->next_quadrant_ps = ps_next;
+                ps_next->next_quadrant_ps = ps_temp2;
+                ps_next = ps;
+            }
+        }
+
+        ps = ps_temp;
+    }
+}
+
+template<uint8_t TRotation> static void arrange_windows(paint_session* session, paint_struct* psHead)
+{
+    paint_struct* ps_cache = paint_arrange_window_skip<TRotation>(
+        psHead, session->QuadrantBackIndex & 0xFFFF, PAINT_QUADRANT_FLAG_NEXT);
+
+    uint32_t quadrantIndex = session->QuadrantBackIndex;
+    while (++quadrantIndex < session->QuadrantFrontIndex)
+    {
+        ps_cache = paint_arrange_window_skip<TRotation>(ps_cache, quadrantIndex & 0xFFFF, 0);
+    }
+}
+
+void paint_session_arrange_window_skip(paint_session* session)
+{
+    paint_struct* psHead = &session->PaintHead;
+
+    paint_struct* ps = psHead;
+    ps->next_quadrant_ps = nullptr;
+
+    uint32_t quadrantIndex = session->QuadrantBackIndex;
+    if (quadrantIndex == UINT32_MAX)
+        return;
+
+    do
+    {
+        paint_struct* ps_next = session->Quadrants[quadrantIndex];
+        if (ps_next != nullptr)
+        {
+            ps->next_quadrant_ps = ps_next;
+            do
+            {
+                ps = ps_next;
+                ps_next = ps_next->next_quadrant_ps;
+            } while (ps_next != nullptr);
+        }
+    } while (++quadrantIndex <= session->QuadrantFrontIndex);
+
+    switch (session->CurrentRotation & 3)
+    {
+        case 0:
+            arrange_windows<0>(session, psHead);
+            break;
+        case 1:
+            arrange_windows<1>(session, psHead);
+            break;
+        case 2:
+            arrange_windows<2>(session, psHead);
+            break;
+        case 3:
+            arrange_windows<3>(session, psHead);
+            break;
+    }
+}
+
+window_skip_stats window_skip_stats_take()
+{
+    const window_skip_stats stats = s_stats;
+    s_stats = {};
+    return stats;
+}
@@ -0,0 +1,25 @@
+/*
+ * Session arrangement which skips quadrant windows that can't reorder anything.
+ *
+ * While flagging the structs of a window, the helper also collects the smallest and largest value of every bounding box
+ * field over the structs the window could use as the initial one and over those it could move in front of it. When
+ * even these extremes can't satisfy check_bounding_box<R>, no pair in the window can, and the scan is replaced by only
+ * clearing the flags the scan would have cleared. The resulting order is identical to paint_session_arrange().
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <cstdint>
+
+void paint_session_arrange_window_skip(paint_session* session);
+
+struct window_skip_stats
+{
+    uint64_t windows = 0;
+    uint64_t skipped = 0;
+};
+
+// Windows arranged and skipped by the calling thread since the previous call
+window_skip_stats window_skip_stats_take();
@@ -0,0 +1,190 @@
+#include "palette_remap.h"
+
+static constexpr uint32_t IMAGE_TYPE_REMAP = 1u << 29;
+static constexpr uint32_t IMAGE_TYPE_REMAP_2_PLUS = 1u << 31;
+static constexpr uint32_t COLOUR_MASK = 31;
+static constexpr uint8_t SHADES = 12;
+// First placeholder index of the primary, secondary and tertiary ramps
+static constexpr uint8_t PLACEHOLDER_RAMPS[] = { 202, 243, 46 };
+
+// The colours field holds primary | secondary << 5 | tertiary << 10 | ramps remapped << 15
+static constexpr size_t MAX_COLOURS = 4 << 15;
+
+static uint32_t hash(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x21F0AAADu;
+    value ^= value >> 15;
+    value *= 0x735A2D97u;
+    value ^= value >> 15;
+    return value;
+}
+
+const char* remap_isa_name(remap_isa isa)
+{
+    switch (isa)
+    {
+        case remap_isa::scalar:
+            return "scalar";
+        case remap_isa::avx2:
+            return "avx2";
+        case remap_isa::avx512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+bool remap_isa_supported(remap_isa isa)
+{
+    switch (isa)
+    {
+        case remap_isa::scalar:
+            return true;
+#if defined(__x86_64__) || defined(__i386__)
+        case remap_isa::avx2:
+            return __builtin_cpu_supports("avx2");
+        case remap_isa::avx512:
+            return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vbmi");
+#else
+        default:
+            return false;
+#endif
+    }
+    return false;
+}
+
+remap_isa remap_isa_best()
+{
+    static const remap_isa best = remap_isa_supported(remap_isa::avx512)
+        ? remap_isa::avx512
+        : remap_isa_supported(remap_isa::avx2) ? remap_isa::avx2 : remap_isa::scalar;
+    return best;
+}
+
+uint32_t palette_remap_colours(uint32_t imageId, uint32_t tertiaryColour)
+{
+    if ((imageId & (IMAGE_TYPE_REMAP | IMAGE_TYPE_REMAP_2_PLUS)) == 0)
+    {
+        return 0;
+    }
+    const uint32_t primary = imageId >> 19 & COLOUR_MASK;
+    if ((imageId & IMAGE_TYPE_REMAP_2_PLUS) == 0)
+    {
+        return primary | 1u << 15;
+    }
+    const uint32_t secondary = imageId >> 24 & COLOUR_MASK;
+    if ((imageId & IMAGE_TYPE_REMAP) == 0)
+    {
+        return primary | secondary << 5 | 2u << 15;
+    }
+    return primary | secondary << 5 | (tertiaryColour & COLOUR_MASK) << 10 | 3u << 15;
+}
+
+uint32_t paint_struct_colours(const paint_struct& ps, uint32_t imageId)
+{
+    if (ps.image_id != 0)
+    {
+        return palette_remap_colours(ps.image_id, ps.tertiary_colour);
+    }
+    // The variant in the low bits doesn't change whether a shape is recoloured
+    const uint32_t shape = hash(imageId >> 2);
+    if (shape % 4 != 0)
+    {
+        return 0;
+    }
+    const uint32_t block = hash((ps.bounds.x >> 9) | (uint32_t)(ps.bounds.y >> 9) << 16);
+    const uint32_t ramps = 1 + (shape >> 8) % 3;
+    return (block & ((1u << (5 * ramps)) - 1)) | ramps << 15;
+}
+
+uint32_t attached_paint_struct_colours(const attached_paint_struct& attached, uint32_t parentColours)
+{
+    const uint32_t own = palette_remap_colours(attached.image_id, attached.tertiary_colour);
+    return own != 0 ? own : parentColours;
+}
+
+void palette_remap_build(uint32_t colours, palette_remap& remap)
+{
+    for (size_t i = 0; i < 256; i++)
+    {
+        remap.table[i] = (uint8_t)i;
+    }
+    const uint32_t ramps = colours >> 15;
+    for (uint32_t ramp = 0; ramp < ramps && ramp < 3; ramp++)
+    {
+        const uint32_t colour = colours >> (5 * ramp) & COLOUR_MASK;
+        for (uint8_t shade = 0; shade < SHADES; shade++)
+        {
+            remap.table[PLACEHOLDER_RAMPS[ramp] + shade] = (uint8_t)(10 + (colour * SHADES + shade) % 192);
+        }
+    }
+    remap.rows = 0;
+    for (size_t i = 0; i < 256; i++)
+    {
+        if (remap.table[i] != i)
+        {
+            remap.rows |= 1 << (i / 16);
+        }
+    }
+}
+
+palette_remap_cache::palette_remap_cache(remap_isa isa)
+    : _isa(isa)
+    , _remaps(MAX_COLOURS)
+{
+}
+
+palette_remap_cache::~palette_remap_cache()
+{
+    for (std::atomic<palette_remap*>& remap : _remaps)
+    {
+        delete remap.load(std::memory_order_relaxed);
+    }
+}
+
+const palette_remap& palette_remap_cache::get(uint32_t colours)
+{
+    std::atomic<palette_remap*>& slot = _remaps[colours % MAX_COLOURS];
+    palette_remap* remap = slot.load(std::memory_order_acquire);
+    if (remap != nullptr)
+    {
+        return *remap;
+    }
+    palette_remap* built = new palette_remap;
+    palette_remap_build(colours, *built);
+    if (slot.compare_exchange_strong(remap, built, std::memory_order_acq_rel))
+    {
+        _built++;
+        return *built;
+    }
+    // Another thread built it meanwhile
+    delete built;
+    return *remap;
+}
+
+size_t palette_remap_row_scalar(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count)
+{
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (source[i] != 0)
+        {
+            target[i] = remap.table[source[i]];
+            written++;
+        }
+    }
+    return written;
+}
+
+size_t palette_remap_row(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count, remap_isa isa)
+{
+    switch (isa)
+    {
+        case remap_isa::avx2:
+            return palette_remap_row_avx2(remap, source, target, count);
+        case remap_isa::avx512:
+            return palette_remap_row_avx512(remap, source, target, count);
+        default:
+            return palette_remap_row_scalar(remap, source, target, count);
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * Palette remapping of recoloured sprites, such as ride vehicles, track and guests' shirts.
+ *
+ * The game draws these sprites in placeholder ramps of 12 shades, which it swaps for the shades of the colours the
+ * image id (bits 19 to 23 and 24 to 28) and the tertiary colour pick: palette indices 202 to 213 take the primary
+ * colour, 243 to 254 the secondary and 46 to 57 the tertiary. Which of them apply depends on the image id's flags.
+ *
+ * The swap is a lookup of every pixel in a table of 256 palette indices. palette_remap_cache builds a table once per
+ * combination of colours and keeps it for all threads. palette_remap_row() applies one to a row of sprite pixels with
+ * byte shuffles: AVX2 looks up 16 entries per shuffle, so a table also notes which of its 16 rows of 16 entries
+ * differ from the identity, and only those are looked up. AVX-512 VBMI looks up all 256 entries in two permutes of
+ * two registers each.
+ *
+ * The benchmark ships no palette either, so every colour gets a ramp of its own in indices 10 to 201.
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct alignas(64) palette_remap
+{
+    uint8_t table[256];
+    uint16_t rows; // bit n set when table[16 * n] to table[16 * n + 15] aren't their own indices
+};
+
+enum class remap_isa
+{
+    scalar,
+    avx2,
+    avx512, // with VBMI
+};
+
+const char* remap_isa_name(remap_isa isa);
+bool remap_isa_supported(remap_isa isa);
+// The widest one the CPU supports
+remap_isa remap_isa_best();
+
+// Colours the image id recolours its sprite with as a palette_remap_cache key, 0 when it isn't recoloured
+uint32_t palette_remap_colours(uint32_t imageId, uint32_t tertiaryColour);
+
+// Like paint_struct_image_id(), derived for structs of captures without image ids: about a quarter of the shapes are
+// recoloured, in colours shared by the structs of a block of 16 by 16 tiles, as those of a ride are
+uint32_t paint_struct_colours(const paint_struct& ps, uint32_t imageId);
+// Attached structs without recolouring of their own take their parent's colours
+uint32_t attached_paint_struct_colours(const attached_paint_struct& attached, uint32_t parentColours);
+
+void palette_remap_build(uint32_t colours, palette_remap& remap);
+
+class palette_remap_cache
+{
+public:
+    explicit palette_remap_cache(remap_isa isa = remap_isa_best());
+    ~palette_remap_cache();
+    palette_remap_cache(const palette_remap_cache&) = delete;
+    palette_remap_cache& operator=(const palette_remap_cache&) = delete;
+
+    // Built on first use, without locking, for colours returned by palette_remap_colours()
+    const palette_remap& get(uint32_t colours);
+
+    remap_isa isa() const
+    {
+        return _isa;
+    }
+    // Tables built so far
+    size_t size() const
+    {
+        return _built;
+    }
+
+private:
+    remap_isa _isa;
+    std::vector<std::atomic<palette_remap*>> _remaps;
+    std::atomic<size_t> _built{ 0 };
+};
+
+// Writes the remapped opaque pixels of the row to target, leaving it alone where the source is transparent, and
+// returns their number
+size_t palette_remap_row(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count, remap_isa isa);
+
+size_t palette_remap_row_scalar(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count);
+size_t palette_remap_row_avx2(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count);
+size_t palette_remap_row_avx512(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count);
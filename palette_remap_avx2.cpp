@@ -0,0 +1,39 @@
+// Compiled with -mavx2, see the Makefile
+#include "palette_remap.h"
+
+#ifdef __AVX2__
+#    include <immintrin.h>
+
+size_t palette_remap_row_avx2(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i pixels = _mm256_loadu_si256((const __m256i*)(source + i));
+        // The shuffle only looks at the low nibble and bit 7, so each row's hits are picked by the high nibble
+        const __m256i low = _mm256_and_si256(pixels, lowNibble);
+        const __m256i high = _mm256_and_si256(_mm256_srli_epi16(pixels, 4), lowNibble);
+        __m256i remapped = pixels;
+        for (uint32_t rows = remap.rows; rows != 0; rows &= rows - 1)
+        {
+            const int row = __builtin_ctz(rows);
+            const __m256i entries = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)(remap.table + 16 * row)));
+            const __m256i inRow = _mm256_cmpeq_epi8(high, _mm256_set1_epi8((char)row));
+            remapped = _mm256_blendv_epi8(remapped, _mm256_shuffle_epi8(entries, low), inRow);
+        }
+        const __m256i transparent = _mm256_cmpeq_epi8(pixels, zero);
+        const __m256i previous = _mm256_loadu_si256((const __m256i*)(target + i));
+        _mm256_storeu_si256((__m256i*)(target + i), _mm256_blendv_epi8(remapped, previous, transparent));
+        written += 32 - __builtin_popcount((uint32_t)_mm256_movemask_epi8(transparent));
+    }
+    return written + palette_remap_row_scalar(remap, source + i, target + i, count - i);
+}
+#else
+size_t palette_remap_row_avx2(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count)
+{
+    return palette_remap_row_scalar(remap, source, target, count);
+}
+#endif
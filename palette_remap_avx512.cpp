@@ -0,0 +1,34 @@
+// Compiled with -mavx512bw -mavx512vbmi, see the Makefile
+#include "palette_remap.h"
+
+#if defined(__AVX512BW__) && defined(__AVX512VBMI__)
+#    include <immintrin.h>
+
+size_t palette_remap_row_avx512(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count)
+{
+    // Each permute picks from 128 entries by the low 7 bits, bit 7 picks the permute
+    const __m512i entries0 = _mm512_load_si512(remap.table);
+    const __m512i entries1 = _mm512_load_si512(remap.table + 64);
+    const __m512i entries2 = _mm512_load_si512(remap.table + 128);
+    const __m512i entries3 = _mm512_load_si512(remap.table + 192);
+    size_t written = 0;
+    for (size_t i = 0; i < count; i += 64)
+    {
+        // The last pixels of the row go through the same path, masked
+        const __mmask64 inRow = count - i >= 64 ? ~(__mmask64)0 : ((__mmask64)1 << (count - i)) - 1;
+        const __m512i pixels = _mm512_maskz_loadu_epi8(inRow, source + i);
+        const __m512i low = _mm512_permutex2var_epi8(entries0, pixels, entries1);
+        const __m512i high = _mm512_permutex2var_epi8(entries2, pixels, entries3);
+        const __m512i remapped = _mm512_mask_blend_epi8(_mm512_movepi8_mask(pixels), low, high);
+        const __mmask64 opaque = _mm512_test_epi8_mask(pixels, pixels);
+        _mm512_mask_storeu_epi8(target + i, opaque, remapped);
+        written += __builtin_popcountll(opaque);
+    }
+    return written;
+}
+#else
+size_t palette_remap_row_avx512(const palette_remap& remap, const uint8_t* source, uint8_t* target, size_t count)
+{
+    return palette_remap_row_scalar(remap, source, target, count);
+}
+#endif
@@ -0,0 +1,139 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#    include <linux/perf_event.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+
+#    include <cstring>
+
+struct counter_config
+{
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+static const counter_config s_configs[] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "l1d_misses", PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+};
+
+bool perf_counter_name(const std::string& name)
+{
+    for (const auto& config : s_configs)
+    {
+        if (name == config.name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+perf_counters::perf_counters()
+{
+    for (const auto& config : s_configs)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = config.type;
+        attr.config = config.config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        const int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0)
+        {
+            continue;
+        }
+        // Virtualised PMUs often accept the event but never count, drop those
+        uint64_t probe = 0;
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        for (volatile int i = 0; i < 1000; i = i + 1)
+        {
+        }
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &probe, sizeof(probe)) != sizeof(probe) || (probe == 0 && config.type == PERF_TYPE_HARDWARE
+                                                                 && config.config <= PERF_COUNT_HW_INSTRUCTIONS))
+        {
+            close(fd);
+            continue;
+        }
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        _counters.push_back({ config.name, fd, 0 });
+    }
+}
+
+perf_counters::~perf_counters()
+{
+    for (const auto& c : _counters)
+    {
+        close(c.fd);
+    }
+}
+
+void perf_counters::start()
+{
+    for (const auto& c : _counters)
+    {
+        ioctl(c.fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void perf_counters::reset()
+{
+    for (auto& c : _counters)
+    {
+        ioctl(c.fd, PERF_EVENT_IOC_RESET, 0);
+        c.value = 0;
+    }
+}
+
+void perf_counters::stop()
+{
+    for (auto& c : _counters)
+    {
+        ioctl(c.fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count;
+        if (read(c.fd, &count, sizeof(count)) == sizeof(count))
+        {
+            c.value = count;
+        }
+    }
+}
+
+#else
+
+bool perf_counter_name(const std::string&)
+{
+    return false;
+}
+
+perf_counters::perf_counters()
+{
+}
+
+perf_counters::~perf_counters()
+{
+}
+
+void perf_counters::start()
+{
+}
+
+void perf_counters::reset()
+{
+}
+
+void perf_counters::stop()
+{
+}
+
+#endif
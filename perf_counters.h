@@ -0,0 +1,57 @@
+/*
+ * Hardware performance counters for the current thread, read through perf_event_open(2).
+ *
+ * Counters which can't be opened (missing permissions, virtual machines, non-Linux systems) are left out, so callers
+ * should check available() and the names of the counters actually read.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Whether a counter of that name is one perf_counters reads, where the system lets it
+bool perf_counter_name(const std::string& name);
+
+class perf_counters
+{
+public:
+    perf_counters();
+    ~perf_counters();
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    bool available() const
+    {
+        return !_counters.empty();
+    }
+
+    // Accumulates counts between start() and stop(), user space only
+    void start();
+    void stop();
+    void reset();
+
+    size_t size() const
+    {
+        return _counters.size();
+    }
+    const std::string& name(size_t index) const
+    {
+        return _counters[index].name;
+    }
+    uint64_t value(size_t index) const
+    {
+        return _counters[index].value;
+    }
+
+private:
+    struct counter
+    {
+        std::string name;
+        int fd;
+        uint64_t value;
+    };
+
+    std::vector<counter> _counters;
+};
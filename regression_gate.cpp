@@ -0,0 +1,144 @@
+#include "regression_gate.h"
+
+#include "json.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+bool gate_save_baseline(const char* path, const std::vector<bench_result>& results)
+{
+    std::FILE* file = std::fopen(path, "w");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "Failed to create %s\n", path);
+        return false;
+    }
+    std::fprintf(file, "{\n  \"version\": 1,\n  \"benchmarks\": [");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        std::fprintf(file, "%s\n    {\n      \"name\": %s,\n      \"metrics\": {", i == 0 ? "" : ",",
+            json_quote(results[i].name).c_str());
+        size_t j = 0;
+        for (const auto& metric : results[i].metrics)
+        {
+            std::fprintf(file, "%s\n        %s: { \"median\": %.17g, \"noise\": %.17g }", j++ == 0 ? "" : ",",
+                json_quote(metric.first).c_str(), metric.second.median, metric.second.noise);
+        }
+        std::fprintf(file, "\n      }\n    }");
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+    return std::fclose(file) == 0;
+}
+
+bool gate_load_baseline(const char* path, std::vector<bench_result>& results)
+{
+    json_value root;
+    std::string error;
+    if (!json_value::parse_file(path, root, error))
+    {
+        std::fprintf(stderr, "%s: %s\n", path, error.c_str());
+        return false;
+    }
+    const json_value* version = root.find("version");
+    const json_value* benchmarks = root.find("benchmarks");
+    if (version == nullptr || version->number() != 1 || benchmarks == nullptr
+        || benchmarks->type() != json_value::kind::array)
+    {
+        std::fprintf(stderr, "%s: not a version 1 baseline\n", path);
+        return false;
+    }
+    results.clear();
+    for (const json_value& benchmark : benchmarks->array())
+    {
+        const json_value* name = benchmark.find("name");
+        const json_value* metrics = benchmark.find("metrics");
+        if (name == nullptr || metrics == nullptr || metrics->type() != json_value::kind::object)
+        {
+            std::fprintf(stderr, "%s: malformed benchmark entry\n", path);
+            return false;
+        }
+        bench_result result{ name->string(), {} };
+        for (const auto& metric : metrics->object())
+        {
+            const json_value* median = metric.second.find("median");
+            const json_value* noise = metric.second.find("noise");
+            if (median == nullptr || !median->is_number() || noise == nullptr || !noise->is_number())
+            {
+                std::fprintf(stderr, "%s: malformed metric %s\n", path, metric.first.c_str());
+                return false;
+            }
+            result.metrics[metric.first] = { median->number(), noise->number() };
+        }
+        results.push_back(std::move(result));
+    }
+    return true;
+}
+
+size_t gate_compare(
+    const std::vector<bench_result>& baseline, const std::vector<bench_result>& current, const gate_thresholds& thresholds)
+{
+    struct regression
+    {
+        const std::string* name;
+        const std::string* metric;
+        result_metric before;
+        result_metric after;
+        double change;
+    };
+    std::vector<regression> regressions;
+    size_t compared = 0;
+    size_t missing = 0;
+
+    for (const bench_result& before : baseline)
+    {
+        auto after = std::find_if(
+            current.begin(), current.end(), [&before](const bench_result& result) { return result.name == before.name; });
+        if (after == current.end())
+        {
+            missing++;
+            continue;
+        }
+        for (const auto& metric : before.metrics)
+        {
+            auto now = after->metrics.find(metric.first);
+            if (now == after->metrics.end() || metric.second.median <= 0)
+            {
+                continue;
+            }
+            compared++;
+            const result_metric& old = metric.second;
+            const double delta = now->second.median - old.median;
+            const double noise = std::sqrt(old.noise * old.noise + now->second.noise * now->second.noise);
+            const double allowed = std::max(thresholds.relative * old.median, thresholds.sigmas * noise);
+            if (delta > allowed)
+            {
+                regressions.push_back({ &before.name, &metric.first, old, now->second, delta / old.median });
+            }
+        }
+    }
+
+    std::sort(regressions.begin(), regressions.end(), [](const regression& a, const regression& b) {
+        return a.change > b.change;
+    });
+
+    std::fprintf(stderr, "\nRegression gate: %zu metrics compared, threshold %.1f%% or %.1f sigma\n", compared,
+        thresholds.relative * 100, thresholds.sigmas);
+    if (missing != 0)
+    {
+        std::fprintf(stderr, "%zu baseline benchmarks were not run\n", missing);
+    }
+    if (regressions.empty())
+    {
+        std::fprintf(stderr, "No regressions\n");
+        return 0;
+    }
+    std::fprintf(stderr, "%zu regressions, worst first:\n", regressions.size());
+    std::fprintf(stderr, "%-56s %-14s %14s %14s %9s\n", "benchmark", "metric", "baseline", "current", "change");
+    for (const regression& r : regressions)
+    {
+        std::fprintf(stderr, "%-56s %-14s %14.1f %14.1f %+8.1f%%\n", r.name->c_str(), r.metric->c_str(),
+            r.before.median, r.after.median, r.change * 100);
+    }
+    return regressions.size();
+}
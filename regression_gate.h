@@ -0,0 +1,26 @@
+/*
+ * Performance regression gate: compares per-benchmark timings and hardware counters against a stored baseline.
+ *
+ * Every metric is summarised by its median over benchmark repetitions and a noise estimate (the standard deviation
+ * over those repetitions). A metric regresses when it got worse by more than both the relative threshold and the
+ * given number of standard deviations of the combined noise of baseline and current run.
+ */
+
+#pragma once
+
+#include "results_reporter.h"
+
+#include <vector>
+
+struct gate_thresholds
+{
+    double relative = 0.05;
+    double sigmas = 3;
+};
+
+bool gate_save_baseline(const char* path, const std::vector<bench_result>& results);
+bool gate_load_baseline(const char* path, std::vector<bench_result>& results);
+
+// Prints the regressions ranked by relative slowdown to stderr, returns how many were found
+size_t gate_compare(
+    const std::vector<bench_result>& baseline, const std::vector<bench_result>& current, const gate_thresholds& thresholds);
@@ -0,0 +1,132 @@
+#include "results_reporter.h"
+
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+static const char* const CPU_TIME_METRIC = "cpu_time_ns";
+
+static double to_nanoseconds(double value, benchmark::TimeUnit unit)
+{
+    switch (unit)
+    {
+        case benchmark::kSecond:
+            return value * 1e9;
+        case benchmark::kMillisecond:
+            return value * 1e6;
+        case benchmark::kMicrosecond:
+            return value * 1e3;
+        default:
+            return value;
+    }
+}
+
+static benchmark::BenchmarkReporter* create_display(const std::string& format)
+{
+    if (format == "json")
+    {
+        return new benchmark::JSONReporter();
+    }
+    if (format == "csv")
+    {
+        // Deprecated, but still what --benchmark_format=csv gives
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+        return new benchmark::CSVReporter();
+#pragma GCC diagnostic pop
+    }
+    return new benchmark::ConsoleReporter(
+        isatty(STDOUT_FILENO) ? benchmark::ConsoleReporter::OO_Defaults : benchmark::ConsoleReporter::OO_Tabular);
+}
+
+results_reporter::results_reporter(const std::string& format)
+    : _display(create_display(format))
+{
+}
+
+bool results_reporter::ReportContext(const Context& context)
+{
+    return _display->ReportContext(context);
+}
+
+void results_reporter::Finalize()
+{
+    _display->Finalize();
+}
+
+void results_reporter::ReportRuns(const std::vector<Run>& runs)
+{
+    for (const Run& run : runs)
+    {
+        if (run.error_occurred)
+        {
+            continue;
+        }
+        std::map<std::string, double>* metrics;
+        const std::string name = run.run_name.str();
+        collected& entry = _runs[name];
+        if (run.run_type == Run::RT_Iteration)
+        {
+            metrics = &entry.single;
+        }
+        else if (run.aggregate_name == "median")
+        {
+            metrics = &entry.median;
+        }
+        else if (run.aggregate_name == "stddev")
+        {
+            metrics = &entry.stddev;
+        }
+        else
+        {
+            continue;
+        }
+        if (std::find(_order.begin(), _order.end(), name) == _order.end())
+        {
+            _order.push_back(name);
+        }
+        (*metrics)[CPU_TIME_METRIC] = to_nanoseconds(run.GetAdjustedCPUTime(), run.time_unit);
+        if (run.memory_result != nullptr)
+        {
+            (*metrics)["heap_allocs"] = run.allocs_per_iter;
+            (*metrics)["heap_peak_bytes"] = (double)run.memory_result->max_bytes_used;
+        }
+        for (const auto& counter : run.counters)
+        {
+            // Other counters describe the workload, or are better when higher, like hit rates and throughput
+            if (perf_counter_name(counter.first))
+            {
+                (*metrics)[counter.first] = counter.second.value;
+            }
+        }
+    }
+    _display->ReportRuns(runs);
+}
+
+std::vector<bench_result> results_reporter::results() const
+{
+    std::vector<bench_result> results;
+    for (const auto& name : _order)
+    {
+        const collected& entry = _runs.at(name);
+        bench_result result{ name, {} };
+        if (!entry.median.empty())
+        {
+            for (const auto& metric : entry.median)
+            {
+                auto noise = entry.stddev.find(metric.first);
+                result.metrics[metric.first] = { metric.second, noise == entry.stddev.end() ? 0 : noise->second };
+            }
+        }
+        else
+        {
+            for (const auto& metric : entry.single)
+            {
+                result.metrics[metric.first] = { metric.second, 0 };
+            }
+        }
+        results.push_back(std::move(result));
+    }
+    return results;
+}
@@ -0,0 +1,53 @@
+/*
+ * Reporter which keeps the results, so modes like the regression gate can post-process them, and passes everything on
+ * to the reporter of the output format asked for. What those modes print themselves goes to stderr, so that the JSON
+ * or CSV on stdout stays intact.
+ */
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct result_metric
+{
+    double median;
+    double noise;
+};
+
+struct bench_result
+{
+    std::string name;
+    // "cpu_time_ns", the hardware counters reported (see perf_counters.h), and with a memory manager "heap_allocs" per
+    // iteration and "heap_peak_bytes", all of them worse when higher
+    std::map<std::string, result_metric> metrics;
+};
+
+/**
+ * Uses the median and standard deviation aggregates when benchmarks are repeated, the single run with no noise
+ * otherwise.
+ */
+class results_reporter : public benchmark::BenchmarkReporter
+{
+public:
+    // "console", "json" or "csv", as --benchmark_format takes
+    explicit results_reporter(const std::string& format);
+    bool ReportContext(const Context& context) override;
+    void ReportRuns(const std::vector<Run>& runs) override;
+    void Finalize() override;
+    std::vector<bench_result> results() const;
+
+private:
+    std::unique_ptr<benchmark::BenchmarkReporter> _display;
+    struct collected
+    {
+        std::map<std::string, double> single;
+        std::map<std::string, double> median;
+        std::map<std::string, double> stddev;
+    };
+    std::vector<std::string> _order;
+    std::map<std::string, collected> _runs;
+};
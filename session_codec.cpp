@@ -0,0 +1,237 @@
+#include "session_codec.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+
+static constexpr uint16_t END_OF_LIST = UINT16_MAX;
+
+#pragma pack(push, 1)
+struct encoded_header
+{
+    uint16_t structs;
+    uint16_t quadrants;
+    uint8_t zoom;
+    uint8_t reserved;
+};
+
+struct encoded_struct
+{
+    uint16_t bounds[6];
+    uint16_t quadrant_index;
+    uint16_t next;
+    uint8_t quadrant_flags;
+    uint8_t sprite_type;
+};
+
+struct encoded_quadrant
+{
+    uint16_t index;
+    uint16_t head;
+};
+#pragma pack(pop)
+
+template<typename T> static void append(std::vector<uint8_t>& out, const T& value)
+{
+    const uint8_t* bytes = (const uint8_t*)&value;
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void session_encode(const paint_session& session, uint8_t zoom, std::vector<uint8_t>& out)
+{
+    const size_t structCount = std::size(session.PaintStructs);
+    const size_t quadrantCount = std::size(session.Quadrants);
+
+    // Number the reachable structs in list order
+    std::vector<uint16_t> renumbered(structCount, END_OF_LIST);
+    std::vector<uint16_t> order;
+    std::vector<encoded_quadrant> quadrants;
+    for (size_t quadrant = 0; quadrant < quadrantCount; quadrant++)
+    {
+        const size_t head = (size_t)session.Quadrants[quadrant];
+        // As in the capture format, the quadrant count stands for an empty quadrant
+        if (head == quadrantCount || head >= structCount)
+        {
+            continue;
+        }
+        for (size_t entry = head; entry < structCount && renumbered[entry] == END_OF_LIST;
+             entry = (size_t)session.PaintStructs[entry].basic.next_quadrant_ps)
+        {
+            renumbered[entry] = (uint16_t)order.size();
+            order.push_back((uint16_t)entry);
+        }
+        quadrants.push_back({ (uint16_t)quadrant, renumbered[head] });
+    }
+
+    append(out, encoded_header{ (uint16_t)order.size(), (uint16_t)quadrants.size(), zoom, 0 });
+    for (uint16_t entry : order)
+    {
+        const paint_struct& ps = session.PaintStructs[entry].basic;
+        const size_t next = (size_t)ps.next_quadrant_ps;
+        append(out,
+            encoded_struct{ { ps.bounds.x, ps.bounds.y, ps.bounds.z, ps.bounds.x_end, ps.bounds.y_end, ps.bounds.z_end },
+                ps.quadrant_index, next < structCount ? renumbered[next] : END_OF_LIST, ps.quadrant_flags,
+                ps.sprite_type });
+    }
+    for (const encoded_quadrant& quadrant : quadrants)
+    {
+        append(out, quadrant);
+    }
+}
+
+// Every list has to end without joining another, the arrangement would otherwise loop once it joins the quadrants
+static bool lists_well_formed(const uint8_t* data, const encoded_header& header)
+{
+    const uint8_t* structs = data + sizeof(header);
+    const uint8_t* quadrants = structs + header.structs * sizeof(encoded_struct);
+    std::vector<bool> reached(header.structs, false);
+    for (size_t i = 0; i < header.quadrants; i++)
+    {
+        encoded_quadrant quadrant;
+        std::memcpy(&quadrant, quadrants + i * sizeof(quadrant), sizeof(quadrant));
+        for (uint16_t entry = quadrant.head; entry != END_OF_LIST;)
+        {
+            if (entry >= header.structs || reached[entry])
+            {
+                return false;
+            }
+            reached[entry] = true;
+            std::memcpy(&entry, structs + entry * sizeof(encoded_struct) + offsetof(encoded_struct, next), sizeof(entry));
+        }
+    }
+    return true;
+}
+
+bool session_decode(const uint8_t* data, size_t size, paint_session& session, uint8_t& zoom)
+{
+    const size_t structCount = std::size(session.PaintStructs);
+    const size_t quadrantCount = std::size(session.Quadrants);
+
+    encoded_header header;
+    if (size < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.structs > structCount
+        || size != sizeof(header) + header.structs * sizeof(encoded_struct) + header.quadrants * sizeof(encoded_quadrant)
+        || !lists_well_formed(data, header))
+    {
+        return false;
+    }
+    zoom = header.zoom;
+
+    const uint8_t* pos = data + sizeof(header);
+    for (size_t i = 0; i < header.structs; i++, pos += sizeof(encoded_struct))
+    {
+        encoded_struct encoded;
+        std::memcpy(&encoded, pos, sizeof(encoded));
+        if (encoded.next != END_OF_LIST && encoded.next >= header.structs)
+        {
+            return false;
+        }
+        paint_struct& ps = session.PaintStructs[i].basic;
+        ps = {};
+        ps.bounds = { encoded.bounds[0], encoded.bounds[1], encoded.bounds[2], encoded.bounds[3], encoded.bounds[4],
+            encoded.bounds[5] };
+        ps.quadrant_index = encoded.quadrant_index;
+        ps.quadrant_flags = encoded.quadrant_flags;
+        ps.sprite_type = encoded.sprite_type;
+        ps.next_quadrant_ps = encoded.next == END_OF_LIST ? nullptr : &session.PaintStructs[encoded.next].basic;
+    }
+
+    std::fill(std::begin(session.Quadrants), std::end(session.Quadrants), nullptr);
+    session.QuadrantBackIndex = UINT32_MAX;
+    session.QuadrantFrontIndex = 0;
+    for (size_t i = 0; i < header.quadrants; i++, pos += sizeof(encoded_quadrant))
+    {
+        encoded_quadrant quadrant;
+        std::memcpy(&quadrant, pos, sizeof(quadrant));
+        if (quadrant.index >= quadrantCount || quadrant.head >= header.structs)
+        {
+            return false;
+        }
+        session.Quadrants[quadrant.index] = &session.PaintStructs[quadrant.head].basic;
+        session.QuadrantBackIndex = std::min<uint32_t>(session.QuadrantBackIndex, quadrant.index);
+        session.QuadrantFrontIndex = std::max<uint32_t>(session.QuadrantFrontIndex, quadrant.index);
+    }
+    session.PaintHead = {};
+    session.CurrentRotation = 0;
+    return true;
+}
+
+bool session_decode_indices(const uint8_t* data, size_t size, paint_session& session, uint8_t& zoom)
+{
+    const size_t structCount = std::size(session.PaintStructs);
+    const size_t quadrantCount = std::size(session.Quadrants);
+
+    encoded_header header;
+    if (size < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.structs > structCount
+        || size != sizeof(header) + header.structs * sizeof(encoded_struct) + header.quadrants * sizeof(encoded_quadrant)
+        || !lists_well_formed(data, header))
+    {
+        return false;
+    }
+    zoom = header.zoom;
+
+    // A quadrant starting with struct 512 would read back as empty, in which case that entry is left unused
+    const uint8_t* quadrants = data + sizeof(header) + header.structs * sizeof(encoded_struct);
+    bool skip = false;
+    for (size_t i = 0; i < header.quadrants; i++)
+    {
+        encoded_quadrant quadrant;
+        std::memcpy(&quadrant, quadrants + i * sizeof(quadrant), sizeof(quadrant));
+        skip |= quadrant.head == quadrantCount;
+    }
+    if (skip && header.structs == structCount)
+    {
+        return false;
+    }
+    auto entry = [&](size_t index) { return skip && index >= quadrantCount ? index + 1 : index; };
+
+    for (auto& unused : session.PaintStructs)
+    {
+        unused.basic = {};
+        unused.basic.next_quadrant_ps = (paint_struct*)structCount;
+    }
+    const uint8_t* pos = data + sizeof(header);
+    for (size_t i = 0; i < header.structs; i++, pos += sizeof(encoded_struct))
+    {
+        encoded_struct encoded;
+        std::memcpy(&encoded, pos, sizeof(encoded));
+        if (encoded.next != END_OF_LIST && encoded.next >= header.structs)
+        {
+            return false;
+        }
+        paint_struct& ps = session.PaintStructs[entry(i)].basic;
+        ps.bounds = { encoded.bounds[0], encoded.bounds[1], encoded.bounds[2], encoded.bounds[3], encoded.bounds[4],
+            encoded.bounds[5] };
+        ps.quadrant_index = encoded.quadrant_index;
+        ps.quadrant_flags = encoded.quadrant_flags;
+        ps.sprite_type = encoded.sprite_type;
+        ps.next_quadrant_ps = (paint_struct*)(encoded.next == END_OF_LIST ? structCount : entry(encoded.next));
+    }
+
+    std::fill(std::begin(session.Quadrants), std::end(session.Quadrants), (paint_struct*)quadrantCount);
+    for (size_t i = 0; i < header.quadrants; i++, pos += sizeof(encoded_quadrant))
+    {
+        encoded_quadrant quadrant;
+        std::memcpy(&quadrant, pos, sizeof(quadrant));
+        if (quadrant.index >= quadrantCount || quadrant.head >= header.structs)
+        {
+            return false;
+        }
+        session.Quadrants[quadrant.index] = (paint_struct*)entry(quadrant.head);
+    }
+    session.PaintHead = {};
+    session.QuadrantBackIndex = 0;
+    session.QuadrantFrontIndex = 0;
+    session.CurrentRotation = 0;
+    return true;
+}
@@ -0,0 +1,34 @@
+/*
+ * Compact binary form of a paint session, for streaming captures between processes.
+ *
+ * A paint_session is over 270 KiB however few structs it holds. The binary form carries only the reachable structs,
+ * renumbered in list order, and the heads of the non-empty quadrants. Attached structs are left out, arrangement
+ * doesn't look at them:
+ *
+ *     uint16_t structs, quadrants
+ *     uint8_t  zoom, reserved
+ *     structs   x { uint16_t x, y, z, x_end, y_end, z_end, quadrant_index, next; uint8_t quadrant_flags, sprite_type }
+ *     quadrants x { uint16_t index, head }
+ *
+ * where next is UINT16_MAX at the end of a list. Fields are in host byte order, both ends are expected to run on the
+ * same machine.
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Appends the encoding of a session as stored in the corpus, with its pointers still encoded as indices
+void session_encode(const paint_session& session, uint8_t zoom, std::vector<uint8_t>& out);
+
+// Decodes into a session with its pointers fixed up and quadrant range set, ready to be arranged. Only the structs the
+// encoding holds are written. Returns false on malformed input, which includes lists that don't end or join another.
+bool session_decode(const uint8_t* data, size_t size, paint_session& session, uint8_t& zoom);
+
+// Decodes into a session as stored in the corpus, with its pointers encoded as indices and every entry written, to be
+// fixed up when copied out like the captured ones. Returns false on malformed input.
+bool session_decode_indices(const uint8_t* data, size_t size, paint_session& session, uint8_t& zoom);
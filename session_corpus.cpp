@@ -0,0 +1,496 @@
+#include "session_corpus.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <zlib.h>
+
+static std::vector<session_shard>& shards()
+{
+    static std::vector<session_shard> registered;
+    return registered;
+}
+
+session_shard_registrar::session_shard_registrar(const paint_session* sessions, size_t count, size_t first, uint8_t zoom)
+{
+    auto& registered = shards();
+    auto it = std::lower_bound(
+        registered.begin(), registered.end(), first, [](const session_shard& a, size_t b) { return a.first < b; });
+    registered.insert(it, { sessions, count, first, zoom });
+}
+
+const std::vector<session_shard>& session_corpus_shards()
+{
+    return shards();
+}
+
+size_t session_corpus_size()
+{
+    size_t size = 0;
+    for (const auto& shard : shards())
+    {
+        size = std::max(size, shard.first + shard.count);
+    }
+    return size;
+}
+
+static const session_shard& find_shard(size_t index)
+{
+    for (const auto& shard : shards())
+    {
+        if (index >= shard.first && index < shard.first + shard.count)
+        {
+            return shard;
+        }
+    }
+    std::fprintf(stderr, "Session %zu is not part of any registered shard\n", index);
+    std::abort();
+}
+
+uint8_t session_corpus_zoom(size_t index)
+{
+    return find_shard(index).zoom;
+}
+
+const paint_session& session_corpus_get(size_t index)
+{
+    const session_shard& shard = find_shard(index);
+    return shard.sessions[index - shard.first];
+}
+
+void session_corpus_copy(paint_session* dest, size_t first, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dest[i] = session_corpus_get(first + i);
+    }
+}
+
+// Reads the numeric value following key in a line of the capture
+static bool parse_field(const char* line, const char* key, unsigned long& value)
+{
+    const char* pos = std::strstr(line, key);
+    if (pos == nullptr)
+    {
+        return false;
+    }
+    value = std::strtoul(pos + std::strlen(key), nullptr, 0);
+    return true;
+}
+
+// Index from the "/* 1234 */" comment starting each entry
+static bool parse_entry_index(const char* line, size_t& index)
+{
+    const char* pos = std::strstr(line, "/*");
+    if (pos == nullptr)
+    {
+        return false;
+    }
+    char* end;
+    index = std::strtoul(pos + 2, &end, 10);
+    return end != pos + 2;
+}
+
+static bool parse_paint_struct(const char* line, paint_struct& ps)
+{
+    const char* bounds = std::strstr(line, ".bounds = {");
+    if (bounds == nullptr)
+    {
+        return false;
+    }
+    char* pos = const_cast<char*>(bounds) + std::strlen(".bounds = {");
+    uint16_t* fields[] = { &ps.bounds.x, &ps.bounds.y, &ps.bounds.z, &ps.bounds.x_end, &ps.bounds.y_end, &ps.bounds.z_end };
+    for (uint16_t* field : fields)
+    {
+        *field = (uint16_t)std::strtoul(pos, &pos, 10);
+        pos += std::strspn(pos, ", ");
+    }
+
+    unsigned long value;
+    if (!parse_field(line, ".quadrant_index =", value))
+    {
+        return false;
+    }
+    ps.quadrant_index = (uint16_t)value;
+    if (parse_field(line, ".quadrant_flags =", value))
+    {
+        ps.quadrant_flags = (uint8_t)value;
+    }
+    if (!parse_field(line, ".next_quadrant_ps = (paint_struct*)", value))
+    {
+        return false;
+    }
+    ps.next_quadrant_ps = (paint_struct*)(uintptr_t)value;
+    if (parse_field(line, ".sprite_type =", value))
+    {
+        ps.sprite_type = (uint8_t)value;
+    }
+    if (parse_field(line, ".attached_ps = (attached_paint_struct*)", value))
+    {
+        ps.attached_ps = (attached_paint_struct*)(uintptr_t)value;
+    }
+    return true;
+}
+
+// Only the fields that attached_paint_struct doesn't share with the paint_struct overlaying it are written, the
+// entry's next_quadrant_ps keeps marking it as unused
+static bool parse_attached_struct(const char* line, attached_paint_struct& attached)
+{
+    unsigned long x;
+    unsigned long y;
+    unsigned long next = 0;
+    if (!parse_field(line, ".x =", x) || !parse_field(line, ".y =", y))
+    {
+        return false;
+    }
+    parse_field(line, ".next = (attached_paint_struct*)", next);
+    attached.x = (uint16_t)x;
+    attached.y = (uint16_t)y;
+    attached.next = (attached_paint_struct*)(uintptr_t)next;
+    return true;
+}
+
+bool session_corpus_load(const char* path)
+{
+    gzFile file = gzopen(path, "rb");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    uint8_t zoom = 0;
+
+    enum class section
+    {
+        none,
+        paint_structs,
+        quadrants,
+    };
+
+    std::vector<std::unique_ptr<paint_session>> sessions;
+    section current = section::none;
+    size_t lineNumber = 0;
+    bool ok = true;
+    char line[4096];
+    while (ok && gzgets(file, line, sizeof(line)) != nullptr)
+    {
+        lineNumber++;
+        size_t index;
+        unsigned long value;
+        if (sessions.empty() && parse_field(line, "/* zoom:", value))
+        {
+            zoom = (uint8_t)value;
+        }
+        else if (std::strstr(line, "{ /* session") != nullptr)
+        {
+            sessions.push_back(std::make_unique<paint_session>());
+            auto& session = *sessions.back();
+            // Entries missing from the capture are unused
+            for (auto& entry : session.PaintStructs)
+            {
+                entry.basic.next_quadrant_ps = (paint_struct*)std::size(session.PaintStructs);
+            }
+            std::fill(std::begin(session.Quadrants), std::end(session.Quadrants), (paint_struct*)std::size(session.Quadrants));
+            current = section::none;
+        }
+        else if (std::strstr(line, ".PaintStructs = {") != nullptr)
+        {
+            current = section::paint_structs;
+        }
+        else if (std::strstr(line, ".Quadrants = {") != nullptr)
+        {
+            current = section::quadrants;
+        }
+        else if (current == section::none || !parse_entry_index(line, index))
+        {
+            continue;
+        }
+        else if (sessions.empty())
+        {
+            ok = false;
+        }
+        else if (current == section::paint_structs)
+        {
+            auto& session = *sessions.back();
+            paint_entry* entry = index < std::size(session.PaintStructs) ? &session.PaintStructs[index] : nullptr;
+            ok = entry != nullptr
+                && (std::strstr(line, ".attached = {") != nullptr ? parse_attached_struct(line, entry->attached)
+                                                                   : parse_paint_struct(line, entry->basic));
+        }
+        else
+        {
+            auto& session = *sessions.back();
+            unsigned long value = 0;
+            ok = index < std::size(session.Quadrants) && parse_field(line, "(paint_struct*)", value);
+            session.Quadrants[index] = (paint_struct*)(uintptr_t)value;
+        }
+    }
+    gzclose(file);
+
+    if (!ok)
+    {
+        std::fprintf(stderr, "%s:%zu: malformed capture\n", path, lineNumber);
+        return false;
+    }
+    if (sessions.empty())
+    {
+        std::fprintf(stderr, "%s: no sessions found\n", path);
+        return false;
+    }
+
+    std::unique_ptr<paint_session[]> copies(new paint_session[sessions.size()]);
+    for (size_t i = 0; i < sessions.size(); i++)
+    {
+        copies[i] = *sessions[i];
+    }
+    session_corpus_add(std::move(copies), sessions.size(), session_corpus_begin(), zoom);
+    return true;
+}
+
+size_t session_corpus_begin()
+{
+    static bool loadedAny = false;
+    if (!loadedAny)
+    {
+        shards().clear();
+        loadedAny = true;
+    }
+    return session_corpus_size();
+}
+
+void session_corpus_add(std::unique_ptr<paint_session[]> sessions, size_t count, size_t first, uint8_t zoom)
+{
+    // Loaded sessions stay alive for the rest of the run, like the compiled in ones
+    static std::vector<std::unique_ptr<paint_session[]>> loaded;
+    loaded.push_back(std::move(sessions));
+    shards().push_back({ loaded.back().get(), count, first, zoom });
+}
+
+void session_corpus_write_zoom(std::FILE* file, uint8_t zoom)
+{
+    std::fprintf(file, "/* zoom: %u */\n", zoom);
+}
+
+void session_corpus_write(std::FILE* file, const paint_session& session, size_t index)
+{
+    const size_t structCount = std::size(session.PaintStructs);
+    const size_t quadrantCount = std::size(session.Quadrants);
+
+    // Number the reachable structs in list order, each followed by its attached structs as the game allocates them,
+    // everything else is dropped
+    std::vector<uint16_t> renumbered(structCount, UINT16_MAX);
+    std::vector<uint16_t> order;
+    std::vector<bool> attached;
+    for (const paint_struct* head : session.Quadrants)
+    {
+        if ((size_t)head == quadrantCount)
+        {
+            continue;
+        }
+        // The format can't tell a quadrant starting with struct 512 from an empty one, keep that slot unused
+        if (order.size() == quadrantCount && (size_t)head < structCount && renumbered[(size_t)head] == UINT16_MAX)
+        {
+            order.push_back(UINT16_MAX);
+            attached.push_back(false);
+        }
+        for (size_t entry = (size_t)head; entry < structCount;
+             entry = (size_t)session.PaintStructs[entry].basic.next_quadrant_ps)
+        {
+            if (renumbered[entry] != UINT16_MAX)
+            {
+                break;
+            }
+            renumbered[entry] = (uint16_t)order.size();
+            order.push_back((uint16_t)entry);
+            attached.push_back(false);
+            for (size_t child = (size_t)session.PaintStructs[entry].basic.attached_ps;
+                 child != 0 && child < structCount && renumbered[child] == UINT16_MAX;
+                 child = (size_t)session.PaintStructs[child].attached.next)
+            {
+                renumbered[child] = (uint16_t)order.size();
+                order.push_back((uint16_t)child);
+                attached.push_back(true);
+            }
+        }
+    }
+    auto encode = [&](const paint_struct* ps, size_t sentinel) {
+        const size_t entry = (size_t)ps;
+        return entry != sentinel && entry < structCount ? (size_t)renumbered[entry] : sentinel;
+    };
+    auto encode_attached = [&](const attached_paint_struct* attachedPs) {
+        const size_t entry = (size_t)attachedPs;
+        return entry != 0 && entry < structCount ? (size_t)renumbered[entry] : 0;
+    };
+
+    std::fprintf(file, "    { /* session %3zu */\n        .PaintStructs = {\n", index);
+    const paint_struct unused = { .next_quadrant_ps = (paint_struct*)structCount };
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        if (attached[i])
+        {
+            const attached_paint_struct& attachedPs = session.PaintStructs[order[i]].attached;
+            std::fprintf(file, "    /* %4zu */ { .attached = { .x = %5u, .y = %5u", i, attachedPs.x, attachedPs.y);
+            if (encode_attached(attachedPs.next) != 0)
+            {
+                std::fprintf(file, ", .next = (attached_paint_struct*)%4zu", encode_attached(attachedPs.next));
+            }
+            std::fprintf(file, "} },\n");
+            continue;
+        }
+        const paint_struct& ps = order[i] == UINT16_MAX ? unused : session.PaintStructs[order[i]].basic;
+        std::fprintf(file,
+            "    /* %4zu */ { .basic = { .bounds = { %5u, %5u, %5u, %5u, %5u, %5u }, .quadrant_index = %3u, "
+            ".quadrant_flags = 0x%x",
+            i, ps.bounds.x, ps.bounds.y, ps.bounds.z, ps.bounds.x_end, ps.bounds.y_end, ps.bounds.z_end, ps.quadrant_index,
+            ps.quadrant_flags);
+        if (encode_attached(ps.attached_ps) != 0)
+        {
+            std::fprintf(file, ", .attached_ps = (attached_paint_struct*)%4zu", encode_attached(ps.attached_ps));
+        }
+        std::fprintf(file, ", .next_quadrant_ps = (paint_struct*)%4zu", encode(ps.next_quadrant_ps, structCount));
+        // Only written for entities, so that captures without them keep the screenshot command's format
+        if (ps.sprite_type != 0)
+        {
+            std::fprintf(file, ", .sprite_type = %u", ps.sprite_type);
+        }
+        std::fprintf(file, "} },\n");
+    }
+    std::fprintf(file, "        },\n        .Quadrants = {\n");
+    for (size_t i = 0; i < quadrantCount; i++)
+    {
+        std::fprintf(file, "    /* %4zu */ (paint_struct*)%4zu,\n", i, encode(session.Quadrants[i], quadrantCount));
+    }
+    std::fprintf(file, "        }\n    },\n\n");
+}
+
+void fixup_pointers(paint_session* s, size_t paint_session_entries, size_t paint_struct_entries, size_t quadrant_entries)
+{
+    for (size_t i = 0; i < paint_session_entries; i++)
+    {
+        for (size_t j = 0; j < paint_struct_entries; j++)
+        {
+            if (s[i].PaintStructs[j].basic.next_quadrant_ps == (paint_struct*)paint_struct_entries)
+            {
+                s[i].PaintStructs[j].basic.next_quadrant_ps = nullptr;
+            }
+            else
+            {
+                s[i].PaintStructs[j].basic.next_quadrant_ps = &s[i].PaintStructs
+                                                                   [(uintptr_t)s[i].PaintStructs[j].basic.next_quadrant_ps]
+                                                                       .basic;
+            }
+        }
+        for (size_t j = 0; j < quadrant_entries; j++)
+        {
+            if (s[i].Quadrants[j] == (paint_struct*)quadrant_entries)
+            {
+                s[i].Quadrants[j] = nullptr;
+            }
+            else
+            {
+                s[i].Quadrants[j] = &s[i].PaintStructs[(size_t)s[i].Quadrants[j]].basic;
+            }
+        }
+
+        // Attached structs follow the struct they belong to, so an index of 0 can stand for none. Entries holding
+        // attached structs read as paint structs without any.
+        auto attached_pointer = [&](const attached_paint_struct* entry) {
+            const size_t index = (size_t)entry;
+            return index == 0 || index >= paint_struct_entries ? nullptr : &s[i].PaintStructs[index].attached;
+        };
+        for (size_t j = 0; j < paint_struct_entries; j++)
+        {
+            paint_struct& ps = s[i].PaintStructs[j].basic;
+            ps.attached_ps = attached_pointer(ps.attached_ps);
+            for (attached_paint_struct* attached = ps.attached_ps; attached != nullptr; attached = attached->next)
+            {
+                attached->next = attached_pointer(attached->next);
+            }
+        }
+
+        // The capture doesn't record the quadrant range, derive it the way the game does while adding structs
+        s[i].QuadrantBackIndex = UINT32_MAX;
+        s[i].QuadrantFrontIndex = 0;
+        for (size_t j = 0; j < quadrant_entries; j++)
+        {
+            if (s[i].Quadrants[j] != nullptr)
+            {
+                s[i].QuadrantBackIndex = std::min<uint32_t>(s[i].QuadrantBackIndex, j);
+                s[i].QuadrantFrontIndex = j;
+            }
+        }
+    }
+}
+
+static constexpr uint16_t NO_ENTRY = UINT16_MAX;
+
+static uint16_t entry_index(const paint_session& session, const paint_struct* ps)
+{
+    return ps == nullptr ? NO_ENTRY : (uint16_t)((const paint_entry*)ps - session.PaintStructs);
+}
+
+static paint_struct* entry_pointer(paint_session& session, uint16_t entry)
+{
+    return entry == NO_ENTRY ? nullptr : &session.PaintStructs[entry].basic;
+}
+
+session_set::session_set(const std::vector<size_t>& indices, session_reset mode)
+    : _indices(indices)
+    , _mode(mode)
+    , _sessions(new paint_session[indices.size()])
+{
+    _links.resize(indices.size());
+    _quadrants.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        paint_session& session = _sessions[i];
+        session = session_corpus_get(indices[i]);
+        fixup_pointers(&session, 1, std::size(session.PaintStructs), std::size(session.Quadrants));
+
+        for (const paint_struct* head : session.Quadrants)
+        {
+            _quadrants[i].push_back(entry_index(session, head));
+            for (const paint_struct* ps = head; ps != nullptr; ps = ps->next_quadrant_ps)
+            {
+                _links[i].push_back(
+                    { entry_index(session, ps), entry_index(session, ps->next_quadrant_ps), ps->quadrant_flags });
+            }
+        }
+        _liveStructs += _links[i].size();
+    }
+}
+
+session_set::~session_set()
+{
+    delete[] _sessions;
+}
+
+void session_set::reset(uint8_t rotation)
+{
+    for (size_t i = 0; i < _indices.size(); i++)
+    {
+        paint_session& session = _sessions[i];
+        if (_mode == session_reset::copy)
+        {
+            session = session_corpus_get(_indices[i]);
+            fixup_pointers(&session, 1, std::size(session.PaintStructs), std::size(session.Quadrants));
+        }
+        else
+        {
+            for (const saved_link& link : _links[i])
+            {
+                paint_struct& ps = session.PaintStructs[link.entry].basic;
+                ps.next_quadrant_ps = entry_pointer(session, link.next);
+                ps.quadrant_flags = link.quadrant_flags;
+            }
+            for (size_t j = 0; j < _quadrants[i].size(); j++)
+            {
+                session.Quadrants[j] = entry_pointer(session, _quadrants[i][j]);
+            }
+        }
+        session.CurrentRotation = rotation;
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * Registry of the paint sessions available to the benchmark.
+ *
+ * The captured corpus is compiled in one or more shards (see session_shard.cpp and corpus_tool.cpp), each of which
+ * registers its sessions at static-init time, or loaded from a capture file at runtime with session_corpus_load().
+ * Sessions keep the capture's encoding of pointers as indices until copied out and passed through fixup_pointers().
+ *
+ * Attached structs, written as "{ .attached = { .x, .y, .next } }" entries, follow the paint struct they belong to,
+ * which refers to the first of them with .attached_ps. A struct's attached links are left out when there are none and
+ * read as 0 then, entry 0 always being a paint struct. Screenshot captures have none.
+ *
+ * Each capture is tagged with the zoom level it was taken at, given by a "zoom: N" comment line ahead of the first
+ * session. Captures without the tag, like the output of the screenshot command, are zoom 0.
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+struct session_shard
+{
+    const paint_session* sessions;
+    size_t count;
+    size_t first; // index of sessions[0] within the whole capture
+    uint8_t zoom;
+};
+
+class session_shard_registrar
+{
+public:
+    session_shard_registrar(const paint_session* sessions, size_t count, size_t first, uint8_t zoom = 0);
+};
+
+// Registered shards, ordered by their position in the capture
+const std::vector<session_shard>& session_corpus_shards();
+size_t session_corpus_size();
+const paint_session& session_corpus_get(size_t index);
+uint8_t session_corpus_zoom(size_t index);
+void session_corpus_copy(paint_session* dest, size_t first, size_t count);
+
+// Reads a capture file, either plain or gzip compressed. The first capture loaded replaces the compiled in sessions,
+// further ones are appended after it.
+bool session_corpus_load(const char* path);
+
+// Registration of sessions loaded at runtime by other means, encoded as in a capture. A capture is numbered from the
+// index session_corpus_begin() returns, the first call dropping the compiled in sessions. Sessions of a capture may be
+// left out, an empty registration past its last session keeps the numbering of the next capture after it.
+size_t session_corpus_begin();
+void session_corpus_add(std::unique_ptr<paint_session[]> sessions, size_t count, size_t first, uint8_t zoom);
+
+// Writes a session in the capture format, renumbering its paint structs so that only the reachable ones are written
+void session_corpus_write(std::FILE* file, const paint_session& session, size_t index);
+void session_corpus_write_zoom(std::FILE* file, uint8_t zoom);
+
+void fixup_pointers(paint_session* s, size_t paint_session_entries, size_t paint_struct_entries, size_t quadrant_entries);
+
+// How a session_set gets back to the unarranged state between measurements
+enum class session_reset
+{
+    copy,  // copy the captured sessions again and fix up their pointers
+    links, // only restore the list links and quadrant flags the arrangement modifies
+};
+
+/**
+ * Working copies of a selection of corpus sessions which can be arranged repeatedly.
+ */
+class session_set
+{
+public:
+    session_set(const std::vector<size_t>& indices, session_reset mode);
+    ~session_set();
+    session_set(const session_set&) = delete;
+    session_set& operator=(const session_set&) = delete;
+
+    paint_session* data()
+    {
+        return _sessions;
+    }
+    size_t size() const
+    {
+        return _indices.size();
+    }
+    // Number of paint structs reachable from the quadrants, over all sessions
+    size_t live_structs() const
+    {
+        return _liveStructs;
+    }
+
+    // Brings all sessions back to their captured state, to be arranged at the given rotation
+    void reset(uint8_t rotation);
+
+private:
+    struct saved_link
+    {
+        uint16_t entry;
+        uint16_t next;
+        uint8_t quadrant_flags;
+    };
+
+    std::vector<size_t> _indices;
+    session_reset _mode;
+    paint_session* _sessions;
+    size_t _liveStructs = 0;
+    std::vector<std::vector<saved_link>> _links;
+    std::vector<std::vector<uint16_t>> _quadrants;
+};
@@ -0,0 +1,23 @@
+/*
+ * Compiles a whole captured corpus as a single shard. Select the capture with -DSESSION_FILE=\"out\" and, when it
+ * wasn't taken at zoom 0, its zoom level with -DSESSION_ZOOM=N.
+ * For large captures prefer the shards generated by `corpus_tool shard`, which can be compiled in parallel.
+ */
+
+#include "session_corpus.h"
+
+#include <iterator>
+
+#ifndef SESSION_FILE
+#    define SESSION_FILE "out-min"
+#endif
+
+#ifndef SESSION_ZOOM
+#    define SESSION_ZOOM 0
+#endif
+
+static const paint_session s[] = {
+#include SESSION_FILE
+};
+
+static session_shard_registrar s_registrar(s, std::size(s), 0, SESSION_ZOOM);
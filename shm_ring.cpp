@@ -0,0 +1,273 @@
+#include "shm_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+static constexpr uint32_t RING_MAGIC = 0x52505350; // "PSPR"
+static constexpr uint32_t WRAP = UINT32_MAX;       // length of a record telling the reader to continue at the start
+static constexpr size_t RECORD_ALIGN = 8;
+
+struct shm_ring_header
+{
+    std::atomic<uint32_t> magic;
+    uint32_t reserved;
+    uint64_t capacity;
+    // Bytes written and read since creation, positions in the data are taken modulo the capacity
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> closed;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+    "The ring is shared between processes");
+
+static size_t record_size(size_t size)
+{
+    return (sizeof(uint32_t) + size + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN;
+}
+
+// Polls condition, yielding at first and sleeping once the wait gets longer. Returns false on timeout.
+template<typename TCondition> static bool wait_for(TCondition condition, double timeoutSeconds, double& blockedSeconds)
+{
+    if (condition())
+    {
+        return true;
+    }
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    bool met = false;
+    for (int spin = 0; !met; spin++)
+    {
+        if (spin < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        met = condition();
+        if (!met && timeoutSeconds >= 0 && std::chrono::duration<double>(clock::now() - start).count() > timeoutSeconds)
+        {
+            break;
+        }
+    }
+    blockedSeconds += std::chrono::duration<double>(clock::now() - start).count();
+    return met;
+}
+
+shm_ring::~shm_ring()
+{
+#ifdef __linux__
+    if (_header != nullptr)
+    {
+        munmap(_header, _mappedSize);
+    }
+    if (_owner)
+    {
+        shm_unlink(_name.c_str());
+    }
+#endif
+}
+
+bool shm_ring::map(int fd, size_t size)
+{
+#ifdef __linux__
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED)
+    {
+        std::perror("mmap");
+        return false;
+    }
+    _header = (shm_ring_header*)memory;
+    _data = (uint8_t*)memory + sizeof(shm_ring_header);
+    _mappedSize = size;
+    return true;
+#else
+    (void)fd;
+    (void)size;
+    return false;
+#endif
+}
+
+bool shm_ring::create(const char* name, size_t capacity)
+{
+#ifdef __linux__
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t size = (sizeof(shm_ring_header) + capacity + page - 1) / page * page;
+    shm_unlink(name);
+    const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        std::fprintf(stderr, "Failed to create shared memory %s: %s\n", name, std::strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, (off_t)size) != 0)
+    {
+        std::fprintf(stderr, "Failed to size shared memory %s: %s\n", name, std::strerror(errno));
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    _name = name;
+    _owner = true;
+    if (!map(fd, size))
+    {
+        return false;
+    }
+    new (_header) shm_ring_header{ {}, 0, (size - sizeof(shm_ring_header)) / RECORD_ALIGN * RECORD_ALIGN, {}, {}, {} };
+    // Written last, the consumer doesn't look at the ring before it sees the magic
+    _header->magic.store(RING_MAGIC, std::memory_order_release);
+    return true;
+#else
+    std::fprintf(stderr, "Shared memory rings need Linux, can't create %s (capacity %zu)\n", name, capacity);
+    return false;
+#endif
+}
+
+bool shm_ring::attach(const char* name, double timeoutSeconds)
+{
+#ifdef __linux__
+    int fd = -1;
+    struct stat status = {};
+    auto created = [&]() {
+        if (fd < 0)
+        {
+            fd = shm_open(name, O_RDWR, 0);
+        }
+        return fd >= 0 && fstat(fd, &status) == 0 && (size_t)status.st_size > sizeof(shm_ring_header);
+    };
+    double waited = 0;
+    if (!wait_for(created, timeoutSeconds, waited))
+    {
+        std::fprintf(stderr, "No shared memory ring %s appeared within %g s\n", name, timeoutSeconds);
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return false;
+    }
+    _name = name;
+    if (!map(fd, (size_t)status.st_size))
+    {
+        return false;
+    }
+    auto valid = [this]() { return _header->magic.load(std::memory_order_acquire) == RING_MAGIC; };
+    if (!wait_for(valid, timeoutSeconds, waited))
+    {
+        std::fprintf(stderr, "%s is not a paint session ring\n", name);
+        return false;
+    }
+    // The capacity comes from the other process, records are only read within the mapping
+    const uint64_t capacity = _header->capacity;
+    if (capacity == 0 || capacity % RECORD_ALIGN != 0 || capacity > _mappedSize - sizeof(shm_ring_header))
+    {
+        std::fprintf(stderr, "%s claims a capacity of %llu bytes in a mapping of %zu\n", name,
+            (unsigned long long)capacity, _mappedSize);
+        return false;
+    }
+    return true;
+#else
+    (void)timeoutSeconds;
+    std::fprintf(stderr, "Shared memory rings need Linux, can't attach to %s\n", name);
+    return false;
+#endif
+}
+
+bool shm_ring::write(const void* data, size_t size)
+{
+    const uint64_t capacity = _header->capacity;
+    const size_t record = record_size(size);
+    if (record > capacity / 2)
+    {
+        std::fprintf(stderr, "Message of %zu bytes doesn't fit a ring of %llu\n", size, (unsigned long long)capacity);
+        return false;
+    }
+
+    uint64_t head = _header->head.load(std::memory_order_relaxed);
+    // A record never wraps, the space left at the end is skipped when it doesn't fit
+    const uint64_t offset = head % capacity;
+    const uint64_t skip = offset + record > capacity ? capacity - offset : 0;
+    auto space = [&]() { return capacity - (head - _header->tail.load(std::memory_order_acquire)) >= skip + record; };
+    wait_for(space, -1, _blockedSeconds);
+
+    if (skip != 0)
+    {
+        const uint32_t wrap = WRAP;
+        std::memcpy(_data + offset, &wrap, sizeof(wrap));
+        head += skip;
+    }
+    const uint32_t length = (uint32_t)size;
+    std::memcpy(_data + head % capacity, &length, sizeof(length));
+    std::memcpy(_data + head % capacity + sizeof(length), data, size);
+    _header->head.store(head + record, std::memory_order_release);
+    return true;
+}
+
+void shm_ring::close()
+{
+    _header->closed.store(1, std::memory_order_release);
+}
+
+bool shm_ring::drain(double timeoutSeconds)
+{
+    auto empty = [this]() {
+        return _header->tail.load(std::memory_order_acquire) == _header->head.load(std::memory_order_relaxed);
+    };
+    double waited = 0;
+    return wait_for(empty, timeoutSeconds, waited);
+}
+
+bool shm_ring::read(std::vector<uint8_t>& message)
+{
+    const uint64_t capacity = _header->capacity;
+    uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+        uint64_t head = 0;
+        auto available = [&]() {
+            // Closed is checked first, so that a message written just before closing isn't missed
+            const bool closed = _header->closed.load(std::memory_order_acquire) != 0;
+            head = _header->head.load(std::memory_order_acquire);
+            return head != tail || closed;
+        };
+        wait_for(available, -1, _blockedSeconds);
+        if (head == tail)
+        {
+            return false;
+        }
+
+        // Positions and lengths come from the other process, a record has to lie within what was written and within
+        // the data
+        const uint64_t left = capacity - tail % capacity;
+        uint32_t length;
+        std::memcpy(&length, _data + tail % capacity, sizeof(length));
+        const uint64_t taken = length == WRAP ? left : record_size(length);
+        if (tail % RECORD_ALIGN != 0 || head - tail > capacity || taken > left || taken > head - tail)
+        {
+            std::fprintf(stderr, "Malformed record of %u bytes at %llu on %s, %llu bytes written\n", length,
+                (unsigned long long)tail, _name.c_str(), (unsigned long long)head);
+            _malformed = true;
+            return false;
+        }
+        if (length == WRAP)
+        {
+            tail += left;
+            _header->tail.store(tail, std::memory_order_release);
+            continue;
+        }
+        message.assign(_data + tail % capacity + sizeof(length), _data + tail % capacity + sizeof(length) + length);
+        _header->tail.store(tail + record_size(length), std::memory_order_release);
+        return true;
+    }
+}
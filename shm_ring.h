@@ -0,0 +1,65 @@
+/*
+ * Single producer, single consumer ring buffer of variable sized messages in POSIX shared memory, for streaming
+ * sessions from a capturing process into the benchmark without going through files.
+ *
+ * The producer creates the ring under a name (e.g. "/openrct2-paint"), the consumer attaches to it by that name. Both
+ * sides only block by polling the other's position, so neither has to be started first as long as the consumer
+ * attaches before the producer gives up waiting for it to drain the ring. The producer removes the name when it's
+ * done, or when creating it again over a stale one.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct shm_ring_header;
+
+class shm_ring
+{
+public:
+    shm_ring() = default;
+    ~shm_ring();
+    shm_ring(const shm_ring&) = delete;
+    shm_ring& operator=(const shm_ring&) = delete;
+
+    // Producer side, capacity is rounded up to whole pages
+    bool create(const char* name, size_t capacity);
+    // Consumer side, waits up to timeoutSeconds for the producer to create the ring
+    bool attach(const char* name, double timeoutSeconds);
+
+    // Blocks while the ring is full. Messages may take up to half the capacity.
+    bool write(const void* data, size_t size);
+    // No more messages will be written
+    void close();
+    // Waits up to timeoutSeconds for the consumer to read everything written, then removes the ring's name
+    bool drain(double timeoutSeconds);
+
+    // Blocks until a message is available, returns false once the producer closed the ring and it is empty, or on a
+    // record that doesn't fit what was written (see malformed())
+    bool read(std::vector<uint8_t>& message);
+    // Whether read() stopped at a malformed record rather than the end of the messages
+    bool malformed() const
+    {
+        return _malformed;
+    }
+
+    // Seconds spent blocked in write() or read()
+    double blocked_seconds() const
+    {
+        return _blockedSeconds;
+    }
+
+private:
+    bool map(int fd, size_t size);
+
+    std::string _name;
+    shm_ring_header* _header = nullptr;
+    uint8_t* _data = nullptr;
+    size_t _mappedSize = 0;
+    bool _owner = false;
+    bool _malformed = false;
+    double _blockedSeconds = 0;
+};
@@ -0,0 +1,75 @@
+#include "sprite_cache.h"
+
+sprite_cache::sprite_cache(const sprite_set& sprites, size_t capacityBytes, size_t shards)
+    : _sprites(sprites)
+    , _shardCapacity(capacityBytes / shards)
+    , _shards(shards)
+{
+}
+
+static std::shared_ptr<const decoded_sprite> decode(const sprite_set& sprites, uint32_t imageId)
+{
+    const compressed_sprite* sprite = sprites.find(imageId);
+    auto decoded = std::make_shared<decoded_sprite>();
+    if (sprite == nullptr || !sprite_decode(*sprite, *decoded))
+    {
+        return nullptr;
+    }
+    return decoded;
+}
+
+std::shared_ptr<const decoded_sprite> sprite_cache::get(uint32_t imageId)
+{
+    // Neighbouring ids are often drawn together, spread them over the shards
+    shard& owner = _shards[(imageId * 0x9E3779B1u >> 16) % _shards.size()];
+    {
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        const auto it = owner.entries.find(imageId);
+        if (it != owner.entries.end())
+        {
+            owner.recent.splice(owner.recent.begin(), owner.recent, it->second);
+            owner.stats.hits++;
+            return it->second->second;
+        }
+        owner.stats.misses++;
+    }
+
+    auto decoded = decode(_sprites, imageId);
+    const size_t bytes = decoded == nullptr ? 0 : decoded->pixels.size();
+    if (decoded == nullptr || bytes > _shardCapacity)
+    {
+        return decoded;
+    }
+    std::lock_guard<std::mutex> lock(owner.mutex);
+    const auto it = owner.entries.find(imageId);
+    if (it != owner.entries.end())
+    {
+        // Another thread decoded it meanwhile
+        return it->second->second;
+    }
+    while (owner.bytes + bytes > _shardCapacity)
+    {
+        owner.bytes -= owner.recent.back().second->pixels.size();
+        owner.entries.erase(owner.recent.back().first);
+        owner.recent.pop_back();
+        owner.stats.evictions++;
+    }
+    owner.recent.emplace_front(imageId, decoded);
+    owner.entries.emplace(imageId, owner.recent.begin());
+    owner.bytes += bytes;
+    return decoded;
+}
+
+sprite_cache_stats sprite_cache::stats_take()
+{
+    sprite_cache_stats total;
+    for (shard& owner : _shards)
+    {
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        total.hits += owner.stats.hits;
+        total.misses += owner.stats.misses;
+        total.evictions += owner.stats.evictions;
+        owner.stats = {};
+    }
+    return total;
+}
@@ -0,0 +1,62 @@
+/*
+ * Bounded cache of decoded sprites for the draw stage, least recently used ones going first.
+ *
+ * Terrain and path sprites repeat thousands of times a frame, decoding them on every draw is wasted work. The cache is
+ * split into shards by image id, each with its own lock, list and share of the capacity, so that threads drawing
+ * different parts of the screen rarely wait on each other. Sprites are decoded outside the lock and handed out by
+ * shared pointer, so an eviction never pulls one from under a thread still drawing it. A capacity of 0 decodes on
+ * every lookup.
+ */
+
+#pragma once
+
+#include "sprite_set.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct sprite_cache_stats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+
+    double hit_rate() const
+    {
+        return hits + misses == 0 ? 0.0 : (double)hits / (hits + misses);
+    }
+};
+
+class sprite_cache
+{
+public:
+    sprite_cache(const sprite_set& sprites, size_t capacityBytes, size_t shards = 16);
+    sprite_cache(const sprite_cache&) = delete;
+    sprite_cache& operator=(const sprite_cache&) = delete;
+
+    // Null for an image id the set doesn't have or whose data is malformed
+    std::shared_ptr<const decoded_sprite> get(uint32_t imageId);
+
+    // Summed over the shards, since construction or the last take
+    sprite_cache_stats stats_take();
+
+private:
+    struct shard
+    {
+        std::mutex mutex;
+        std::list<std::pair<uint32_t, std::shared_ptr<const decoded_sprite>>> recent; // most recently used first
+        std::unordered_map<uint32_t, decltype(recent)::iterator> entries;
+        size_t bytes = 0;
+        sprite_cache_stats stats;
+    };
+
+    const sprite_set& _sprites;
+    size_t _shardCapacity;
+    std::vector<shard> _shards;
+};
@@ -0,0 +1,140 @@
+#include "sprite_set.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static constexpr uint32_t IMAGE_ID_MASK = 0x7FFFF; // g1 and csg images fit in 19 bits
+static constexpr uint8_t LAST_RUN = 0x80;
+static constexpr uint8_t MAX_RUN = 0x7F;
+
+static uint32_t mix(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x7FEB352Du;
+    value ^= value >> 15;
+    value *= 0x846CA68Bu;
+    value ^= value >> 16;
+    return value;
+}
+
+uint32_t paint_struct_image_id(const paint_struct& ps)
+{
+    if (ps.image_id != 0)
+    {
+        return ps.image_id;
+    }
+    const uint32_t shape = mix((uint16_t)(ps.bounds.x_end - ps.bounds.x) * 73856093u
+                               ^ (uint16_t)(ps.bounds.y_end - ps.bounds.y) * 19349663u
+                               ^ (uint16_t)(ps.bounds.z_end - ps.bounds.z) * 83492791u ^ (uint32_t)ps.sprite_type << 24);
+    // One of four variants per shape, chosen by map tile
+    const uint32_t variant = mix((ps.bounds.x >> 5) | (uint32_t)(ps.bounds.y >> 5) << 16) & 3;
+    return std::max<uint32_t>(1, ((shape << 2) | variant) & IMAGE_ID_MASK);
+}
+
+uint32_t attached_paint_struct_image_id(const attached_paint_struct& attached, uint32_t parentImageId, size_t index)
+{
+    if (attached.image_id != 0)
+    {
+        return attached.image_id;
+    }
+    return std::max<uint32_t>(1, mix(parentImageId * 31 + (uint32_t)index + 1) & IMAGE_ID_MASK);
+}
+
+void sprite_set::generate(uint32_t imageId, int32_t width, int32_t height)
+{
+    if (_sprites.count(imageId) != 0)
+    {
+        return;
+    }
+    compressed_sprite& sprite = _sprites[imageId];
+    sprite.width = (uint16_t)std::clamp(width, 1, 255);
+    sprite.height = (uint16_t)std::clamp(height, 1, 255);
+    const uint32_t seed = mix(imageId);
+    const uint8_t base = (uint8_t)(1 + seed % 224);
+
+    // Opaque within a diamond widened to the sides, like terrain and path tiles, with holes as in fences and foliage
+    sprite.data.resize(sprite.height * sizeof(uint32_t));
+    for (int32_t row = 0; row < sprite.height; row++)
+    {
+        const uint32_t offset = (uint32_t)sprite.data.size();
+        std::memcpy(&sprite.data[row * sizeof(uint32_t)], &offset, sizeof(offset));
+        const double slope = sprite.height == 1 ? 0 : std::abs(2.0 * row / (sprite.height - 1) - 1);
+        const double halfWidth = sprite.width / 2.0 * (1.25 - slope);
+        size_t runStart = SIZE_MAX;
+        auto opaque = [&](int32_t column) {
+            return std::abs(column + 0.5 - sprite.width / 2.0) <= halfWidth
+                && mix(seed ^ (uint32_t)row * 977u ^ (uint32_t)column * 131u) % 13 != 0;
+        };
+        for (int32_t column = 0; column <= sprite.width; column++)
+        {
+            const bool inRun = runStart != SIZE_MAX;
+            if (inRun && (column == sprite.width || !opaque(column) || sprite.data[runStart] == MAX_RUN))
+            {
+                runStart = SIZE_MAX;
+            }
+            if (column < sprite.width && runStart == SIZE_MAX && opaque(column))
+            {
+                runStart = sprite.data.size();
+                sprite.data.push_back(0);
+                sprite.data.push_back((uint8_t)column);
+            }
+            if (runStart != SIZE_MAX)
+            {
+                sprite.data[runStart]++;
+                sprite.data.push_back((uint8_t)(base + (row + column) / 4 % 16));
+            }
+        }
+        // The last run of a row carries the flag, rows without any get an empty one
+        size_t last = offset;
+        if (last == sprite.data.size())
+        {
+            sprite.data.push_back(0);
+            sprite.data.push_back(0);
+        }
+        for (size_t run = offset; run < sprite.data.size(); run += 2 + sprite.data[run])
+        {
+            last = run;
+        }
+        sprite.data[last] |= LAST_RUN;
+    }
+    _compressedBytes += sprite.data.size();
+    _decodedBytes += (size_t)sprite.width * sprite.height;
+}
+
+bool sprite_decode(const compressed_sprite& sprite, decoded_sprite& decoded)
+{
+    decoded.width = sprite.width;
+    decoded.height = sprite.height;
+    decoded.pixels.assign((size_t)sprite.width * sprite.height, 0);
+    const uint8_t* data = sprite.data.data();
+    const size_t size = sprite.data.size();
+    if (size < sprite.height * sizeof(uint32_t))
+    {
+        return false;
+    }
+    for (size_t row = 0; row < sprite.height; row++)
+    {
+        uint32_t pos;
+        std::memcpy(&pos, data + row * sizeof(uint32_t), sizeof(pos));
+        uint8_t* out = &decoded.pixels[row * sprite.width];
+        uint8_t flags;
+        do
+        {
+            if (pos + 2 > size)
+            {
+                return false;
+            }
+            flags = data[pos];
+            const size_t length = flags & MAX_RUN;
+            const size_t x = data[pos + 1];
+            if (x + length > sprite.width || pos + 2 + length > size)
+            {
+                return false;
+            }
+            std::memcpy(out + x, data + pos + 2, length);
+            pos += 2 + (uint32_t)length;
+        } while ((flags & LAST_RUN) == 0);
+    }
+    return true;
+}
@@ -0,0 +1,71 @@
+/*
+ * Locally generated sprites standing in for the game's g1 image data, which the benchmark doesn't ship.
+ *
+ * Sprites are stored compressed the way g1 stores most of its images: row by row as runs of opaque pixels, each run
+ * a byte of length (with bit 7 set on the last run of a row), a byte of x offset and the pixels, with a table of the
+ * offsets of the rows in front. Drawing one means decoding it first, see sprite_cache.h.
+ *
+ * Captures carry no image ids either. paint_struct_image_id() derives one from what the game picks sprites by: the
+ * shape of the bounding box and the kind of entity, with a few variants per shape as with terrain and path styles.
+ */
+
+#pragma once
+
+#include "paint.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct compressed_sprite
+{
+    uint16_t width = 0;
+    uint16_t height = 0;
+    std::vector<uint8_t> data;
+};
+
+struct decoded_sprite
+{
+    uint16_t width = 0;
+    uint16_t height = 0;
+    std::vector<uint8_t> pixels; // palette indices, 0 is transparent
+};
+
+// The struct's own image id where it has one
+uint32_t paint_struct_image_id(const paint_struct& ps);
+uint32_t attached_paint_struct_image_id(const attached_paint_struct& attached, uint32_t parentImageId, size_t index);
+
+class sprite_set
+{
+public:
+    // Generates a sprite of the given size for the image id, if there is none yet. Sizes are capped at 255.
+    void generate(uint32_t imageId, int32_t width, int32_t height);
+
+    const compressed_sprite* find(uint32_t imageId) const
+    {
+        const auto it = _sprites.find(imageId);
+        return it == _sprites.end() ? nullptr : &it->second;
+    }
+
+    size_t size() const
+    {
+        return _sprites.size();
+    }
+    size_t compressed_bytes() const
+    {
+        return _compressedBytes;
+    }
+    size_t decoded_bytes() const
+    {
+        return _decodedBytes;
+    }
+
+private:
+    std::unordered_map<uint32_t, compressed_sprite> _sprites;
+    size_t _compressedBytes = 0;
+    size_t _decodedBytes = 0;
+};
+
+// Returns false on malformed data
+bool sprite_decode(const compressed_sprite& sprite, decoded_sprite& decoded);
@@ -0,0 +1,54 @@
+#include "viewport_arrange.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+const char* viewport_schedule_name(viewport_schedule schedule)
+{
+    switch (schedule)
+    {
+        case viewport_schedule::serial:
+            return "serial";
+        case viewport_schedule::in_order:
+            return "in-order";
+        case viewport_schedule::size_aware:
+            return "size-aware";
+    }
+    return "";
+}
+
+void paint_viewports_arrange(
+    std::vector<paint_viewport>& viewports, const paint_arranger& arranger, job_pool& pool, viewport_schedule schedule)
+{
+    std::vector<size_t> order(viewports.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (schedule == viewport_schedule::size_aware)
+    {
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            if (viewports[a].main != viewports[b].main)
+            {
+                return viewports[a].main;
+            }
+            return viewports[a].structs > viewports[b].structs;
+        });
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto arrange = [&](size_t job) {
+        paint_viewport& viewport = viewports[order[job]];
+        arranger.arrange(viewport.session);
+        viewport.finished = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+    if (schedule == viewport_schedule::serial)
+    {
+        for (size_t job = 0; job < order.size(); job++)
+        {
+            arrange(job);
+        }
+    }
+    else
+    {
+        pool.run(order.size(), arrange);
+    }
+}
@@ -0,0 +1,35 @@
+/*
+ * Arrangement of all the viewports on screen at once. Besides the main view the game paints ride, guest and other
+ * windows with viewports of their own, each with its own paint_session, and arranges them one after the other.
+ *
+ * Here they are spread over a job_pool. How they are ordered matters as much as the thread count: the pool hands out
+ * jobs in order, so with the size aware schedule the main viewport, whose latency the player notices, goes first and
+ * the others follow largest first, which keeps one big session from being left for last.
+ */
+
+#pragma once
+
+#include "arrangers.h"
+#include "job_pool.h"
+
+#include <vector>
+
+struct paint_viewport
+{
+    paint_session* session;
+    size_t structs; // paint structs in the session, known to the game from filling it in
+    bool main;
+    double finished = 0; // nanoseconds from the start of the batch until this viewport was arranged
+};
+
+enum class viewport_schedule
+{
+    serial,     // one after the other on the calling thread, as the game does
+    in_order,   // concurrently, in the order given
+    size_aware, // concurrently, main viewport first then by decreasing size
+};
+
+const char* viewport_schedule_name(viewport_schedule schedule);
+
+void paint_viewports_arrange(
+    std::vector<paint_viewport>& viewports, const paint_arranger& arranger, job_pool& pool, viewport_schedule schedule);